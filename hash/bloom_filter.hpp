@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+
+#include "hash/hash_set.hpp"
+
+namespace algorithms {
+
+// Bloom filter blocked by cache lines: all bits of a key lie in one block of BLOCK_BITS
+// bits, so an insertion or a query touches a single cache line. Blocks get unequal
+// numbers of keys, which makes the false positive rate higher than the one of a classic
+// Bloom filter of the same size; the constructor accounts for it when it chooses the size.
+// There are no false negatives. Keys cannot be erased, see CuckooFilter for that.
+// TBaseHash maps keys to 64-bit values, as in MinimalPerfectHash
+template<typename TKey, typename TBaseHash = std::hash<TKey> >
+class BlockedBloomFilter {
+    public:
+        // Sizes the filter so that after 'expected_count' insertions a key which was not
+        // inserted passes Contains with probability at most 'false_positive_rate'.
+        // Throws std::invalid_argument unless the rate is in (0, 1)
+        BlockedBloomFilter(size_t expected_count, double false_positive_rate, unsigned seed = 237);
+
+        BlockedBloomFilter(const BlockedBloomFilter &other) = delete;
+        BlockedBloomFilter &operator = (const BlockedBloomFilter &other) = delete;
+        BlockedBloomFilter(BlockedBloomFilter &&other) = default;
+        BlockedBloomFilter &operator = (BlockedBloomFilter &&other) = default;
+
+        void Insert(const TKey &key);
+        // False if 'key' was surely not inserted
+        bool Contains(const TKey &key) const;
+        // Same as Insert or Contains for every key, with memory accesses of groups
+        // of keys overlapped. 'out[i]' is set to Contains(keys[i])
+        void InsertBatch(const TKey *keys, size_t count);
+        void ContainsBatch(const TKey *keys, size_t count, uint8_t *out) const;
+
+        // False positive rate predicted after 'expected_count' insertions
+        double GetExpectedFalsePositiveRate() const { return expected_rate_; }
+        // Number of bits set by a key
+        int GetHashesCount() const { return hashes_count_; }
+        // Bytes occupied by the filter, including its blocks
+        size_t GetMemoryUsage() const;
+
+    private:
+        static const size_t BLOCK_BITS = 512;
+        static const size_t BLOCK_WORDS = BLOCK_BITS / 64;
+        static const int MAX_HASHES_COUNT = 16;
+        // Number of keys whose memory accesses are overlapped by batch methods
+        static const size_t BATCH_GROUP_SIZE = 16;
+
+        // Probability of a false positive when a block holds 'bits_per_key' bits
+        // per inserted key and every key sets 'hashes_count' bits
+        static double CountFalsePositiveRate(double bits_per_key, int hashes_count);
+
+        uint64_t GetHash(const TKey &key) const {
+            return MixBits(static_cast<uint64_t>(TBaseHash()(key)) ^ seed_);
+        }
+        uint64_t *GetBlock(uint64_t hash) const {
+            uint64_t index = ((hash >> 32) * blocks_count_) >> 32;
+            return blocks_ + index * BLOCK_WORDS;
+        }
+        // Bits of the key with 'hash' inside word 'index' of its block
+        uint64_t GetWordMask(uint64_t hash, uint32_t index) const;
+        void InsertHash(uint64_t hash);
+        bool ContainsHash(uint64_t hash) const;
+
+        uint64_t seed_;
+        int hashes_count_;
+        double expected_rate_;
+        uint64_t blocks_count_;
+        // 'blocks_' points to the first cache line boundary inside 'storage_'
+        std::unique_ptr<uint64_t[]> storage_;
+        uint64_t *blocks_;
+};
+
+template<typename TKey, typename TBaseHash>
+BlockedBloomFilter<TKey, TBaseHash>::BlockedBloomFilter(size_t expected_count,
+                                                        double false_positive_rate,
+                                                        unsigned seed) :
+    seed_(MixBits(seed)),
+    hashes_count_(1),
+    expected_rate_(1.0),
+    blocks_count_(0),
+    blocks_(nullptr) {
+    if (!(false_positive_rate > 0.0 && false_positive_rate < 1.0)) {
+        throw std::invalid_argument("False positive rate of BlockedBloomFilter is not in (0, 1)\n");
+    }
+
+    // the smallest size on a grid of half bits per key which gives the rate
+    double bits_per_key = 1.0;
+    while (expected_rate_ > false_positive_rate && bits_per_key < 64.0) {
+        bits_per_key += 0.5;
+        for (int hashes_count = 1; hashes_count <= MAX_HASHES_COUNT; ++hashes_count) {
+            double rate = CountFalsePositiveRate(bits_per_key, hashes_count);
+            if (rate < expected_rate_) {
+                expected_rate_ = rate;
+                hashes_count_ = hashes_count;
+            }
+        }
+    }
+
+    blocks_count_ = static_cast<uint64_t>(std::ceil(expected_count * bits_per_key / BLOCK_BITS));
+    if (blocks_count_ == 0) {
+        blocks_count_ = 1;
+    }
+    size_t words_count = blocks_count_ * BLOCK_WORDS + BLOCK_WORDS;
+    storage_.reset(new uint64_t[words_count]());
+    uintptr_t address = reinterpret_cast<uintptr_t>(storage_.get());
+    blocks_ = storage_.get() + (BLOCK_WORDS - address / 8 % BLOCK_WORDS) % BLOCK_WORDS;
+}
+
+template<typename TKey, typename TBaseHash>
+double BlockedBloomFilter<TKey, TBaseHash>::CountFalsePositiveRate(double bits_per_key,
+                                                                   int hashes_count) {
+    // the number of keys in a block is close to Poisson distributed
+    double mean = BLOCK_BITS / bits_per_key;
+    double max_keys_count = mean + 10 * std::sqrt(mean) + 10;
+    double probability = std::exp(-mean);
+    double rate = 0.0;
+    for (int keys_count = 0; keys_count < max_keys_count; ++keys_count) {
+        double bit_set = 1.0 - std::pow(1.0 - 1.0 / BLOCK_BITS, keys_count * hashes_count);
+        rate += probability * std::pow(bit_set, hashes_count);
+        probability *= mean / (keys_count + 1);
+    }
+    return rate;
+}
+
+template<typename TKey, typename TBaseHash>
+uint64_t BlockedBloomFilter<TKey, TBaseHash>::GetWordMask(uint64_t hash, uint32_t index) const {
+    // bits are taken from products of the lower half of the hash by odd constants
+    static const uint32_t SALTS[2 * BLOCK_WORDS] = {
+        0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d, 0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31,
+        0x7b1dcdaf, 0xa1b965f5, 0x8009454f, 0x724c81ed, 0x51a8749b, 0x747ea2eb, 0x1f4532e1, 0xc916ab3d
+    };
+    uint32_t lower = static_cast<uint32_t>(hash);
+    uint32_t first_word = static_cast<uint32_t>(hash >> 32) % BLOCK_WORDS;
+    uint32_t hashes_count = static_cast<uint32_t>(hashes_count_);
+    // bits of the key go to consecutive words cyclically starting from 'first_word',
+    // one or two to a word. Conditions are turned into numbers instead of branches, which
+    // would be mispredicted; loops over the words of a block are then vectorized
+    // by the compiler when AVX2 is enabled (SSE2 has no shifts by a count per lane)
+    uint32_t rank = (index + BLOCK_WORDS - first_word) % BLOCK_WORDS;
+    uint64_t bit = static_cast<uint64_t>(rank < hashes_count) <<
+                   ((lower * SALTS[index]) >> 26);
+    uint64_t second_bit = static_cast<uint64_t>(rank + BLOCK_WORDS < hashes_count) <<
+                          ((lower * SALTS[index + BLOCK_WORDS]) >> 26);
+    return bit | second_bit;
+}
+
+template<typename TKey, typename TBaseHash>
+void BlockedBloomFilter<TKey, TBaseHash>::InsertHash(uint64_t hash) {
+    uint64_t *block = GetBlock(hash);
+    for (uint32_t index = 0; index != BLOCK_WORDS; ++index) {
+        block[index] |= GetWordMask(hash, index);
+    }
+}
+
+template<typename TKey, typename TBaseHash>
+bool BlockedBloomFilter<TKey, TBaseHash>::ContainsHash(uint64_t hash) const {
+    const uint64_t *block = GetBlock(hash);
+    // bits of the key missing from the block
+    uint64_t missing = 0;
+    for (uint32_t index = 0; index != BLOCK_WORDS; ++index) {
+        missing |= GetWordMask(hash, index) & ~block[index];
+    }
+    return missing == 0;
+}
+
+template<typename TKey, typename TBaseHash>
+void BlockedBloomFilter<TKey, TBaseHash>::Insert(const TKey &key) {
+    InsertHash(GetHash(key));
+}
+
+template<typename TKey, typename TBaseHash>
+bool BlockedBloomFilter<TKey, TBaseHash>::Contains(const TKey &key) const {
+    return ContainsHash(GetHash(key));
+}
+
+template<typename TKey, typename TBaseHash>
+void BlockedBloomFilter<TKey, TBaseHash>::InsertBatch(const TKey *keys, size_t count) {
+    uint64_t hashes[BATCH_GROUP_SIZE];
+    for (size_t group_begin = 0; group_begin < count; group_begin += BATCH_GROUP_SIZE) {
+        size_t group_size = count - group_begin;
+        if (group_size > BATCH_GROUP_SIZE) {
+            group_size = BATCH_GROUP_SIZE;
+        }
+        for (size_t index = 0; index != group_size; ++index) {
+            hashes[index] = GetHash(keys[group_begin + index]);
+            Prefetch(GetBlock(hashes[index]));
+        }
+        for (size_t index = 0; index != group_size; ++index) {
+            InsertHash(hashes[index]);
+        }
+    }
+}
+
+template<typename TKey, typename TBaseHash>
+void BlockedBloomFilter<TKey, TBaseHash>::ContainsBatch(const TKey *keys, size_t count, uint8_t *out) const {
+    uint64_t hashes[BATCH_GROUP_SIZE];
+    for (size_t group_begin = 0; group_begin < count; group_begin += BATCH_GROUP_SIZE) {
+        size_t group_size = count - group_begin;
+        if (group_size > BATCH_GROUP_SIZE) {
+            group_size = BATCH_GROUP_SIZE;
+        }
+        for (size_t index = 0; index != group_size; ++index) {
+            hashes[index] = GetHash(keys[group_begin + index]);
+            Prefetch(GetBlock(hashes[index]));
+        }
+        for (size_t index = 0; index != group_size; ++index) {
+            out[group_begin + index] = ContainsHash(hashes[index]) ? 1 : 0;
+        }
+    }
+}
+
+template<typename TKey, typename TBaseHash>
+size_t BlockedBloomFilter<TKey, TBaseHash>::GetMemoryUsage() const {
+    return sizeof(*this) + (blocks_count_ + 1) * BLOCK_WORDS * sizeof(uint64_t);
+}
+
+} // namespace algorithms
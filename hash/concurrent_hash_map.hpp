@@ -0,0 +1,551 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+#include "hash/hash_set.hpp"
+
+namespace algorithms {
+
+// Hash map for integral keys and values shared by many threads.
+// Find is lock-free and writes only a counter of active operations; Insert and Erase
+// update a slot with a single CAS. The table is an array of (key, value) slots with linear probing;
+// a key once written to a slot stays there, erasure only clears the value.
+//
+// When a table is half full, a table twice as large (or of the same size, if most keys
+// are erased) is attached to it, and every modification of the map migrates a chunk
+// of slots. A migrated slot gets the value MOVED, operations which meet it continue
+// in the next table. A writer waits only when the chunk it needs is being migrated
+// by another thread.
+//
+// A table whose migration is finished is released by a later modification once no operation
+// started before the migration ended is running. Operations are counted in two epochs:
+// the releasing thread switches the epoch and frees the tables when the counters
+// of the previous epoch drop to zero, so it never waits for other threads.
+//
+// Key std::numeric_limits<TKey>::max() and two greatest values of TValue are reserved,
+// Insert throws std::invalid_argument on them
+template<typename TKey, typename TValue>
+class ConcurrentHashMap {
+    public:
+        static_assert(std::is_integral<TKey>::value && std::is_integral<TValue>::value,
+                      "ConcurrentHashMap keeps only integral keys and values");
+
+        // Sized so that 'expected_size' keys fit without resizing
+        explicit ConcurrentHashMap(size_t expected_size = 0);
+        ~ConcurrentHashMap();
+
+        ConcurrentHashMap(const ConcurrentHashMap &other) = delete;
+        ConcurrentHashMap &operator = (const ConcurrentHashMap &other) = delete;
+
+        // Returns false if 'key' is absent
+        bool Find(TKey key, TValue *value) const;
+        // Inserts the pair or replaces the value of a present key.
+        // Returns true if the key was absent
+        bool Insert(TKey key, TValue value);
+        // Returns false if the key was absent
+        bool Erase(TKey key);
+
+        // Exact when no modification runs concurrently
+        size_t GetSize() const {
+            long long size = size_.load();
+            return size > 0 ? static_cast<size_t>(size) : 0;
+        }
+        // Bytes occupied by the map, including tables not released yet
+        size_t GetMemoryUsage() const {
+            return sizeof(*this) + memory_usage_.load();
+        }
+
+    private:
+        static const TKey EMPTY_KEY = std::numeric_limits<TKey>::max();
+        static const TValue NULL_VALUE = std::numeric_limits<TValue>::max();
+        static const TValue MOVED = std::numeric_limits<TValue>::max() - 1;
+        static const size_t MIN_CAPACITY = 1 << 10;
+        // Number of slots migrated by a thread at once
+        static const size_t MIGRATION_CHUNK_SIZE = 1 << 8;
+        // Threads are spread over this many counters of active operations
+        static const size_t OPERATION_COUNTERS_COUNT = 32;
+        static const size_t CACHE_LINE_SIZE = 64;
+
+        struct Slot {
+            std::atomic<TKey> key;
+            std::atomic<TValue> value;
+        };
+
+        enum ChunkState {
+            CHUNK_WAITING,
+            CHUNK_MIGRATING,
+            CHUNK_MIGRATED
+        };
+
+        struct Table {
+            explicit Table(size_t capacity);
+
+            size_t GetChunksCount() const {
+                return (capacity + MIGRATION_CHUNK_SIZE - 1) / MIGRATION_CHUNK_SIZE;
+            }
+
+            // Power of two
+            const size_t capacity;
+            std::unique_ptr<Slot[]> slots;
+            // Number of slots with keys, including erased ones
+            std::atomic<size_t> used_count;
+            // Table to which this one is migrated, allocated by the thread which set 'has_next'
+            std::atomic<Table *> next;
+            std::atomic<bool> has_next;
+            // Chunks are claimed by helpers in order starting from this one,
+            // by writers at the chunk they need
+            std::atomic<size_t> next_chunk;
+            std::unique_ptr<std::atomic<int>[]> chunk_states;
+            std::atomic<size_t> migrated_chunks;
+        };
+
+        // Counter of a group of threads, alone in its cache line
+        struct OperationCounter {
+            std::atomic<long long> count;
+            char padding[CACHE_LINE_SIZE - sizeof(std::atomic<long long>)];
+        };
+
+        // Counts an operation in the current epoch while it may hold pointers to tables
+        class OperationGuard {
+            public:
+                explicit OperationGuard(const ConcurrentHashMap *map);
+                ~OperationGuard() {
+                    counter_->fetch_sub(1, std::memory_order_release);
+                }
+
+                OperationGuard(const OperationGuard &other) = delete;
+                OperationGuard &operator = (const OperationGuard &other) = delete;
+
+            private:
+                std::atomic<long long> *counter_;
+        };
+
+        static size_t GetStart(const Table &table, TKey key) {
+            return static_cast<size_t>(MixBits(static_cast<uint64_t>(key))) & (table.capacity - 1);
+        }
+        static size_t CountCapacity(size_t size);
+        static size_t CountTableMemory(size_t capacity) {
+            return sizeof(Table) + capacity * sizeof(Slot) +
+                   (capacity + MIGRATION_CHUNK_SIZE - 1) / MIGRATION_CHUNK_SIZE * sizeof(std::atomic<int>);
+        }
+        // Index of the operation counter of the calling thread
+        static size_t GetCounterIndex();
+        long long CountOperations(size_t epoch) const;
+
+        // Slot holding 'key' in 'table', the key is written to an empty slot if absent.
+        // Returns nullptr if 'table' has to be resized first, then 'index'
+        // is the position of the empty slot at which the probe stopped
+        static Slot *AcquireSlot(Table *table, TKey key, bool check_load, size_t *index);
+
+        // Attaches the next table to 'table' unless it is already attached
+        void StartMigration(Table *table);
+        // Migrates up to 'max_chunks' chunks of 'table' not taken by other threads
+        void HelpMigration(Table *table, size_t max_chunks);
+        // Returns when the slot at 'index' is migrated
+        void WaitSlotMigration(Table *table, size_t index);
+        // Returns when all slots of 'table' are migrated
+        void WaitMigration(Table *table);
+        bool ClaimChunk(Table *table, size_t chunk);
+        void MigrateChunk(Table *table, size_t chunk);
+        static void MigrateSlot(Slot *slot, Table *next);
+
+        // Frees the tables before the root which no running operation can reach;
+        // does nothing if another thread is releasing tables
+        void ReleaseOldTables();
+
+        // The oldest table not released, owns the newer tables through their 'next' links
+        std::atomic<Table *> head_;
+        // The newest table which is completely filled, lookups start from it
+        std::atomic<Table *> root_;
+        // Erasure may be counted before the insertion of the same key, so the counter is signed
+        std::atomic<long long> size_;
+        std::atomic<size_t> memory_usage_;
+
+        // Operations are counted in operation_counters_[epoch_ % 2]
+        std::atomic<size_t> epoch_;
+        mutable OperationCounter operation_counters_[2][OPERATION_COUNTERS_COUNT];
+        // Set by the thread which releases tables
+        std::atomic<bool> releasing_;
+        // Tables before this one are freed when the operations of the previous epoch end,
+        // nullptr if the epoch was not switched for release. Changed only by the releasing thread
+        Table *release_end_;
+};
+
+template<typename TKey, typename TValue>
+ConcurrentHashMap<TKey, TValue>::Table::Table(size_t capacity) :
+    capacity(capacity),
+    slots(new Slot[capacity]),
+    used_count(0),
+    next(nullptr),
+    has_next(false),
+    next_chunk(0),
+    chunk_states(new std::atomic<int>[GetChunksCount()]),
+    migrated_chunks(0) {
+    for (size_t index = 0; index != capacity; ++index) {
+        slots[index].key.store(EMPTY_KEY, std::memory_order_relaxed);
+        slots[index].value.store(NULL_VALUE, std::memory_order_relaxed);
+    }
+    for (size_t chunk = 0; chunk != GetChunksCount(); ++chunk) {
+        chunk_states[chunk].store(CHUNK_WAITING, std::memory_order_relaxed);
+    }
+}
+
+template<typename TKey, typename TValue>
+ConcurrentHashMap<TKey, TValue>::OperationGuard::OperationGuard(const ConcurrentHashMap *map) {
+    size_t counter_index = GetCounterIndex();
+    while (true) {
+        size_t epoch = map->epoch_.load();
+        counter_ = &map->operation_counters_[epoch % 2][counter_index].count;
+        counter_->fetch_add(1);
+        // Counted in the epoch which is still current, so the tables loaded
+        // from now on are not released before the counter drops
+        if (map->epoch_.load() == epoch) {
+            return;
+        }
+        counter_->fetch_sub(1);
+    }
+}
+
+template<typename TKey, typename TValue>
+ConcurrentHashMap<TKey, TValue>::ConcurrentHashMap(size_t expected_size) :
+    head_(new Table(CountCapacity(expected_size))),
+    root_(head_.load()),
+    size_(0),
+    memory_usage_(CountTableMemory(head_.load()->capacity)),
+    epoch_(0),
+    releasing_(false),
+    release_end_(nullptr) {
+    for (size_t epoch = 0; epoch != 2; ++epoch) {
+        for (size_t index = 0; index != OPERATION_COUNTERS_COUNT; ++index) {
+            operation_counters_[epoch][index].count.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+template<typename TKey, typename TValue>
+ConcurrentHashMap<TKey, TValue>::~ConcurrentHashMap() {
+    Table *table = head_.load();
+    while (table != nullptr) {
+        Table *next = table->next.load();
+        delete table;
+        table = next;
+    }
+}
+
+template<typename TKey, typename TValue>
+size_t ConcurrentHashMap<TKey, TValue>::CountCapacity(size_t size) {
+    // tables are migrated when half full
+    size_t capacity = MIN_CAPACITY;
+    while (capacity / 2 < size) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+template<typename TKey, typename TValue>
+size_t ConcurrentHashMap<TKey, TValue>::GetCounterIndex() {
+    static thread_local const size_t index =
+        std::hash<std::thread::id>()(std::this_thread::get_id()) % OPERATION_COUNTERS_COUNT;
+    return index;
+}
+
+template<typename TKey, typename TValue>
+long long ConcurrentHashMap<TKey, TValue>::CountOperations(size_t epoch) const {
+    long long count = 0;
+    for (size_t index = 0; index != OPERATION_COUNTERS_COUNT; ++index) {
+        count += operation_counters_[epoch % 2][index].count.load();
+    }
+    return count;
+}
+
+template<typename TKey, typename TValue>
+bool ConcurrentHashMap<TKey, TValue>::Find(TKey key, TValue *value) const {
+    OperationGuard guard(this);
+    // loaded after the operation is counted
+    const Table *table = root_.load();
+    size_t index = GetStart(*table, key);
+    for (size_t probe = 0; probe != table->capacity; ++probe) {
+        const Slot &slot = table->slots[index];
+        TKey slot_key = slot.key.load(std::memory_order_acquire);
+        if (slot_key == key || slot_key == EMPTY_KEY) {
+            TValue slot_value = slot.value.load(std::memory_order_acquire);
+            if (slot_value == MOVED) {
+                // the key may have been written to the next table after this slot was migrated
+                table = table->next.load(std::memory_order_acquire);
+                index = GetStart(*table, key);
+                probe = static_cast<size_t>(-1);
+                continue;
+            }
+            if (slot_key == EMPTY_KEY || slot_value == NULL_VALUE) {
+                return false;
+            }
+            *value = slot_value;
+            return true;
+        }
+        index = (index + 1) & (table->capacity - 1);
+    }
+    return false;
+}
+
+template<typename TKey, typename TValue>
+typename ConcurrentHashMap<TKey, TValue>::Slot *ConcurrentHashMap<TKey, TValue>::AcquireSlot
+        (Table *table, TKey key, bool check_load, size_t *index_result) {
+    size_t index = GetStart(*table, key);
+    for (size_t probe = 0; probe != table->capacity; ++probe) {
+        Slot &slot = table->slots[index];
+        TKey slot_key = slot.key.load(std::memory_order_acquire);
+        if (slot_key == EMPTY_KEY) {
+            if (check_load && table->used_count.load(std::memory_order_relaxed) >= table->capacity / 2) {
+                *index_result = index;
+                return nullptr;
+            }
+            if (slot.key.compare_exchange_strong(slot_key, key)) {
+                table->used_count.fetch_add(1, std::memory_order_relaxed);
+                return &slot;
+            }
+            // on failure 'slot_key' is the key written by another thread
+        }
+        if (slot_key == key) {
+            return &slot;
+        }
+        index = (index + 1) & (table->capacity - 1);
+    }
+    *index_result = table->capacity;
+    return nullptr;
+}
+
+template<typename TKey, typename TValue>
+bool ConcurrentHashMap<TKey, TValue>::Insert(TKey key, TValue value) {
+    if (key == EMPTY_KEY || value == NULL_VALUE || value == MOVED) {
+        throw std::invalid_argument("The greatest key and two greatest values are reserved by ConcurrentHashMap\n");
+    }
+    ReleaseOldTables();
+    OperationGuard guard(this);
+    Table *table = root_.load();
+    while (true) {
+        if (table->next.load() != nullptr) {
+            HelpMigration(table, 1);
+        }
+        size_t index;
+        Slot *slot = AcquireSlot(table, key, true, &index);
+        if (slot == nullptr) {
+            // The key is absent and no thread can write a key to this table any more.
+            // Once the empty slot ending the probe is migrated, lookups of the key
+            // in this table lead to the next one, where it is inserted
+            StartMigration(table);
+            if (index != table->capacity) {
+                WaitSlotMigration(table, index);
+            } else {
+                WaitMigration(table);
+            }
+            table = table->next.load();
+            continue;
+        }
+        // Absent keys are inserted only to the newest table once the migration is started,
+        // so the keys moved to the next table are at most those present at the start
+        bool is_migrating = (table->next.load() != nullptr);
+        TValue slot_value = slot->value.load();
+        while (slot_value != MOVED) {
+            if (slot_value == NULL_VALUE && is_migrating) {
+                WaitSlotMigration(table, slot - table->slots.get());
+                break;
+            }
+            if (slot->value.compare_exchange_weak(slot_value, value)) {
+                if (slot_value == NULL_VALUE) {
+                    size_.fetch_add(1);
+                    return true;
+                }
+                return false;
+            }
+        }
+        // the slot is migrated, the table has a successor
+        table = table->next.load();
+    }
+}
+
+template<typename TKey, typename TValue>
+bool ConcurrentHashMap<TKey, TValue>::Erase(TKey key) {
+    ReleaseOldTables();
+    OperationGuard guard(this);
+    Table *table = root_.load();
+    while (true) {
+        if (table->next.load() != nullptr) {
+            HelpMigration(table, 1);
+        }
+        size_t index = GetStart(*table, key);
+        Slot *slot = nullptr;
+        for (size_t probe = 0; probe != table->capacity; ++probe) {
+            Slot &current = table->slots[index];
+            TKey slot_key = current.key.load();
+            if (slot_key == key || slot_key == EMPTY_KEY) {
+                slot = &current;
+                break;
+            }
+            index = (index + 1) & (table->capacity - 1);
+        }
+        if (slot == nullptr) {
+            return false;
+        }
+
+        TValue slot_value = slot->value.load();
+        while (slot_value != MOVED) {
+            if (slot_value == NULL_VALUE) {
+                // an empty slot which is not migrated yet: the key is absent
+                return false;
+            }
+            if (slot->value.compare_exchange_weak(slot_value, NULL_VALUE)) {
+                size_.fetch_sub(1);
+                return true;
+            }
+        }
+        table = table->next.load();
+    }
+}
+
+template<typename TKey, typename TValue>
+void ConcurrentHashMap<TKey, TValue>::StartMigration(Table *table) {
+    if (table->next.load() != nullptr) {
+        return;
+    }
+    // a table is migrated only after all its predecessors, so that it never
+    // receives migrated keys and keys written directly at the same time
+    Table *root;
+    while ((root = root_.load()) != table) {
+        if (root->next.load() == nullptr) {
+            // the root is the newest table, so 'table' has been migrated by other threads
+            return;
+        }
+        WaitMigration(root);
+    }
+    if (!table->has_next.exchange(true)) {
+        size_t capacity = CountCapacity(GetSize() * 2);
+        memory_usage_.fetch_add(CountTableMemory(capacity));
+        table->next.store(new Table(capacity));
+    }
+    while (table->next.load() == nullptr) {
+        std::this_thread::yield();
+    }
+}
+
+template<typename TKey, typename TValue>
+bool ConcurrentHashMap<TKey, TValue>::ClaimChunk(Table *table, size_t chunk) {
+    int state = CHUNK_WAITING;
+    return table->chunk_states[chunk].compare_exchange_strong(state, CHUNK_MIGRATING);
+}
+
+template<typename TKey, typename TValue>
+void ConcurrentHashMap<TKey, TValue>::MigrateChunk(Table *table, size_t chunk) {
+    Table *next = table->next.load();
+    size_t end = std::min((chunk + 1) * MIGRATION_CHUNK_SIZE, table->capacity);
+    for (size_t index = chunk * MIGRATION_CHUNK_SIZE; index != end; ++index) {
+        MigrateSlot(&table->slots[index], next);
+    }
+    table->chunk_states[chunk].store(CHUNK_MIGRATED);
+    if (table->migrated_chunks.fetch_add(1) + 1 == table->GetChunksCount()) {
+        Table *expected = table;
+        root_.compare_exchange_strong(expected, next);
+    }
+}
+
+template<typename TKey, typename TValue>
+void ConcurrentHashMap<TKey, TValue>::HelpMigration(Table *table, size_t max_chunks) {
+    size_t chunks_count = table->GetChunksCount();
+    size_t migrated_count = 0;
+    size_t chunk;
+    while (migrated_count < max_chunks && (chunk = table->next_chunk.fetch_add(1)) < chunks_count) {
+        if (ClaimChunk(table, chunk)) {
+            MigrateChunk(table, chunk);
+            ++migrated_count;
+        }
+    }
+}
+
+template<typename TKey, typename TValue>
+void ConcurrentHashMap<TKey, TValue>::WaitSlotMigration(Table *table, size_t index) {
+    size_t chunk = index / MIGRATION_CHUNK_SIZE;
+    if (ClaimChunk(table, chunk)) {
+        MigrateChunk(table, chunk);
+        return;
+    }
+    while (table->chunk_states[chunk].load() != CHUNK_MIGRATED) {
+        std::this_thread::yield();
+    }
+}
+
+template<typename TKey, typename TValue>
+void ConcurrentHashMap<TKey, TValue>::WaitMigration(Table *table) {
+    size_t chunks_count = table->GetChunksCount();
+    HelpMigration(table, chunks_count);
+    // the remaining chunks are being migrated by other threads
+    while (table->migrated_chunks.load() != chunks_count) {
+        std::this_thread::yield();
+    }
+}
+
+template<typename TKey, typename TValue>
+void ConcurrentHashMap<TKey, TValue>::ReleaseOldTables() {
+    if (head_.load(std::memory_order_relaxed) == root_.load(std::memory_order_relaxed) ||
+            releasing_.exchange(true, std::memory_order_acquire)) {
+        return;
+    }
+    if (release_end_ == nullptr) {
+        // New operations start from the root or a newer table, only operations
+        // counted in the current epoch may hold the tables before it
+        Table *root = root_.load();
+        if (root != head_.load(std::memory_order_relaxed)) {
+            release_end_ = root;
+            epoch_.fetch_add(1);
+        }
+    }
+    // The epoch is switched again only after this check succeeds, so an operation
+    // which saw an older epoch has ended or counts itself in the current one
+    if (release_end_ != nullptr && CountOperations(epoch_.load() - 1) == 0) {
+        Table *table = head_.load(std::memory_order_relaxed);
+        while (table != release_end_) {
+            Table *next = table->next.load();
+            memory_usage_.fetch_sub(CountTableMemory(table->capacity));
+            delete table;
+            table = next;
+        }
+        head_.store(release_end_, std::memory_order_relaxed);
+        release_end_ = nullptr;
+    }
+    releasing_.store(false, std::memory_order_release);
+}
+
+template<typename TKey, typename TValue>
+void ConcurrentHashMap<TKey, TValue>::MigrateSlot(Slot *slot, Table *next) {
+    // Only the thread which claimed the chunk migrates the slot. Writers of this key keep
+    // using the slot until it gets MOVED, so the copy in the next table is written
+    // only here and can be overwritten by a fresher value
+    Slot *copy = nullptr;
+    TValue value = slot->value.load();
+    while (true) {
+        if (value == NULL_VALUE) {
+            if (copy != nullptr) {
+                copy->value.store(NULL_VALUE);
+            }
+        } else {
+            if (copy == nullptr) {
+                // the key is set before a value can be written to the slot
+                size_t index;
+                copy = AcquireSlot(next, slot->key.load(), false, &index);
+            }
+            copy->value.store(value);
+        }
+        if (slot->value.compare_exchange_weak(value, MOVED)) {
+            return;
+        }
+    }
+}
+
+} // namespace algorithms
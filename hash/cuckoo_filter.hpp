@@ -0,0 +1,345 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#include "hash/hash_set.hpp"
+
+namespace algorithms {
+
+// Cuckoo filter (Fan, Andersen, Kaminsky, Mitzenmacher): an approximate set which,
+// unlike a Bloom filter, supports erasure. It stores a fingerprint of every key in one
+// of two buckets of BUCKET_SIZE slots; the second bucket is found from the first one
+// and the fingerprint alone, so fingerprints can be kicked between buckets
+// as in cuckoo hashing. A fingerprint which is left homeless after MAX_KICKS kicks
+// is kept aside, further insertions fail until an erasure makes room for it.
+//
+// Fingerprints have from 4 to 16 bits and buckets are packed tightly, so a bucket
+// is read with one unaligned 64-bit load and compared with a fingerprint in all slots
+// at once. TBaseHash maps keys to 64-bit values, as in MinimalPerfectHash
+template<typename TKey, typename TBaseHash = std::hash<TKey> >
+class CuckooFilter {
+    public:
+        // Sizes the filter to hold 'capacity' keys, with fingerprints long enough for
+        // a key which was not inserted to pass Contains with probability
+        // at most 'false_positive_rate' when the filter is full.
+        // Throws std::invalid_argument unless the rate is in (0, 1)
+        CuckooFilter(size_t capacity, double false_positive_rate, unsigned seed = 237);
+
+        // Returns false if the filter is full; the filter is unchanged then.
+        // A key may be inserted several times and then has to be erased as many times
+        bool Insert(const TKey &key);
+        // False if 'key' was surely not inserted
+        bool Contains(const TKey &key) const;
+        // Erases one insertion of 'key'. Erasing a key which was not inserted
+        // may erase a key with the same fingerprint instead
+        bool Erase(const TKey &key);
+        // Same as Insert or Contains for every key, with memory accesses of groups
+        // of keys overlapped. Returns the number of keys inserted;
+        // 'out[i]' is set to Contains(keys[i])
+        size_t InsertBatch(const TKey *keys, size_t count);
+        void ContainsBatch(const TKey *keys, size_t count, uint8_t *out) const;
+
+        size_t GetSize() const { return size_; }
+        int GetFingerprintBits() const { return fingerprint_bits_; }
+        // Bytes occupied by the filter, including its buckets
+        size_t GetMemoryUsage() const;
+
+    private:
+        static const size_t BUCKET_SIZE = 4;
+        static const int MIN_FINGERPRINT_BITS = 4;
+        static const int MAX_FINGERPRINT_BITS = 16;
+        static const int MAX_KICKS = 500;
+        // Buckets are allocated for capacity / MAX_LOAD keys,
+        // cuckoo filters with 4 slots in a bucket fill up to about 95%
+        static constexpr double MAX_LOAD = 0.95;
+        // Number of keys whose memory accesses are overlapped by batch methods
+        static const size_t BATCH_GROUP_SIZE = 16;
+
+        // Fingerprint of a key and its first bucket
+        struct Location {
+            uint64_t bucket;
+            uint64_t fingerprint;
+        };
+
+        Location GetLocation(const TKey &key) const;
+        // (offset - bucket) modulo the number of buckets, where the offset depends only on
+        // the fingerprint: the alternate bucket of the alternate bucket is the bucket itself
+        uint64_t GetAlternateBucket(uint64_t bucket, uint64_t fingerprint) const {
+            uint64_t offset = ((MixBits(fingerprint) >> 32) * buckets_count_) >> 32;
+            return offset >= bucket ? offset - bucket : offset + buckets_count_ - bucket;
+        }
+
+        // Slots of a bucket as one number, slot i in bits [i * fingerprint_bits_, ...);
+        // an empty slot is zero
+        uint64_t LoadBucket(uint64_t bucket) const;
+        void StoreBucket(uint64_t bucket, uint64_t slots);
+        const uint8_t *GetBucketAddress(uint64_t bucket) const {
+            return &table_[bucket * BUCKET_SIZE * fingerprint_bits_ / 8];
+        }
+        uint64_t GetSlot(uint64_t slots, size_t index) const {
+            return (slots >> (index * fingerprint_bits_)) & fingerprint_mask_;
+        }
+        uint64_t SetSlot(uint64_t slots, size_t index, uint64_t fingerprint) const {
+            int shift = static_cast<int>(index * fingerprint_bits_);
+            return (slots & ~(fingerprint_mask_ << shift)) | (fingerprint << shift);
+        }
+        // Whether some slot of 'slots' equals 'fingerprint', checking all slots at once
+        bool HasFingerprint(uint64_t slots, uint64_t fingerprint) const;
+
+        bool InsertIntoBucket(uint64_t bucket, uint64_t fingerprint);
+        bool EraseFromBucket(uint64_t bucket, uint64_t fingerprint);
+        bool ContainsLocation(const Location &location) const;
+        bool InsertLocation(const Location &location);
+
+        uint64_t seed_;
+        // State of the generator choosing slots to kick
+        uint64_t kick_state_;
+        int fingerprint_bits_;
+        uint64_t fingerprint_mask_;
+        // Number with 1 in the lowest bit of every slot of a bucket
+        uint64_t lowest_bits_;
+        uint64_t buckets_count_;
+        size_t size_;
+        // Packed buckets, followed by padding for the 64-bit loads of the last buckets
+        std::vector<uint8_t> table_;
+        // Fingerprint which did not find a place
+        bool has_victim_;
+        Location victim_;
+};
+
+template<typename TKey, typename TBaseHash>
+CuckooFilter<TKey, TBaseHash>::CuckooFilter(size_t capacity, double false_positive_rate, unsigned seed) :
+    seed_(MixBits(seed)),
+    kick_state_(seed),
+    buckets_count_(0),
+    size_(0),
+    has_victim_(false),
+    victim_() {
+    if (!(false_positive_rate > 0.0 && false_positive_rate < 1.0)) {
+        throw std::invalid_argument("False positive rate of CuckooFilter is not in (0, 1)\n");
+    }
+
+    // a key is compared with 2 * BUCKET_SIZE fingerprints, each matches with probability 2^-bits
+    double bits = std::ceil(std::log2(2 * BUCKET_SIZE / false_positive_rate));
+    fingerprint_bits_ = bits < MIN_FINGERPRINT_BITS ? MIN_FINGERPRINT_BITS :
+                        bits > MAX_FINGERPRINT_BITS ? MAX_FINGERPRINT_BITS :
+                        static_cast<int>(bits);
+    fingerprint_mask_ = (1ULL << fingerprint_bits_) - 1;
+    lowest_bits_ = 0;
+    for (size_t index = 0; index != BUCKET_SIZE; ++index) {
+        lowest_bits_ |= 1ULL << (index * fingerprint_bits_);
+    }
+
+    buckets_count_ = static_cast<uint64_t>(std::ceil(capacity / (BUCKET_SIZE * MAX_LOAD)));
+    if (buckets_count_ == 0) {
+        buckets_count_ = 1;
+    }
+    // a bucket starts at bit 0 or 4 of a byte, the latter only for odd lengths, which are
+    // at most 15: a 64-bit load at the first byte of a bucket always covers it
+    table_.assign(buckets_count_ * BUCKET_SIZE * fingerprint_bits_ / 8 + sizeof(uint64_t), 0);
+}
+
+template<typename TKey, typename TBaseHash>
+typename CuckooFilter<TKey, TBaseHash>::Location
+CuckooFilter<TKey, TBaseHash>::GetLocation(const TKey &key) const {
+    uint64_t hash = MixBits(static_cast<uint64_t>(TBaseHash()(key)) ^ seed_);
+    Location location;
+    location.bucket = ((hash >> 32) * buckets_count_) >> 32;
+    location.fingerprint = hash & fingerprint_mask_;
+    if (location.fingerprint == 0) {
+        location.fingerprint = 1;
+    }
+    return location;
+}
+
+template<typename TKey, typename TBaseHash>
+uint64_t CuckooFilter<TKey, TBaseHash>::LoadBucket(uint64_t bucket) const {
+    uint64_t word;
+    std::memcpy(&word, GetBucketAddress(bucket), sizeof(word));
+    word >>= bucket * BUCKET_SIZE * fingerprint_bits_ % 8;
+    if (fingerprint_bits_ == MAX_FINGERPRINT_BITS) {
+        return word;
+    }
+    return word & ((1ULL << (BUCKET_SIZE * fingerprint_bits_)) - 1);
+}
+
+template<typename TKey, typename TBaseHash>
+void CuckooFilter<TKey, TBaseHash>::StoreBucket(uint64_t bucket, uint64_t slots) {
+    uint8_t *address = &table_[bucket * BUCKET_SIZE * fingerprint_bits_ / 8];
+    int shift = static_cast<int>(bucket * BUCKET_SIZE * fingerprint_bits_ % 8);
+    uint64_t bucket_mask = fingerprint_bits_ == MAX_FINGERPRINT_BITS ? ~0ULL :
+                           (1ULL << (BUCKET_SIZE * fingerprint_bits_)) - 1;
+    uint64_t word;
+    std::memcpy(&word, address, sizeof(word));
+    word = (word & ~(bucket_mask << shift)) | (slots << shift);
+    std::memcpy(address, &word, sizeof(word));
+}
+
+template<typename TKey, typename TBaseHash>
+bool CuckooFilter<TKey, TBaseHash>::HasFingerprint(uint64_t slots, uint64_t fingerprint) const {
+    // slots equal to the fingerprint become zero; the highest bit of a slot is set
+    // in (x - lowest_bits_) & ~x only if the slot or a lower one is zero
+    uint64_t difference = slots ^ (fingerprint * lowest_bits_);
+    uint64_t highest_bits = lowest_bits_ << (fingerprint_bits_ - 1);
+    return ((difference - lowest_bits_) & ~difference & highest_bits) != 0;
+}
+
+template<typename TKey, typename TBaseHash>
+bool CuckooFilter<TKey, TBaseHash>::InsertIntoBucket(uint64_t bucket, uint64_t fingerprint) {
+    uint64_t slots = LoadBucket(bucket);
+    for (size_t index = 0; index != BUCKET_SIZE; ++index) {
+        if (GetSlot(slots, index) == 0) {
+            StoreBucket(bucket, SetSlot(slots, index, fingerprint));
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename TKey, typename TBaseHash>
+bool CuckooFilter<TKey, TBaseHash>::EraseFromBucket(uint64_t bucket, uint64_t fingerprint) {
+    uint64_t slots = LoadBucket(bucket);
+    for (size_t index = 0; index != BUCKET_SIZE; ++index) {
+        if (GetSlot(slots, index) == fingerprint) {
+            StoreBucket(bucket, SetSlot(slots, index, 0));
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename TKey, typename TBaseHash>
+bool CuckooFilter<TKey, TBaseHash>::ContainsLocation(const Location &location) const {
+    uint64_t alternate = GetAlternateBucket(location.bucket, location.fingerprint);
+    if (HasFingerprint(LoadBucket(location.bucket), location.fingerprint) ||
+        HasFingerprint(LoadBucket(alternate), location.fingerprint)) {
+        return true;
+    }
+    return has_victim_ && victim_.fingerprint == location.fingerprint &&
+           (victim_.bucket == location.bucket || victim_.bucket == alternate);
+}
+
+template<typename TKey, typename TBaseHash>
+bool CuckooFilter<TKey, TBaseHash>::InsertLocation(const Location &location) {
+    if (has_victim_) {
+        return false;
+    }
+    ++size_;
+    uint64_t bucket = location.bucket;
+    uint64_t fingerprint = location.fingerprint;
+    if (InsertIntoBucket(bucket, fingerprint)) {
+        return true;
+    }
+    bucket = GetAlternateBucket(bucket, fingerprint);
+    if (InsertIntoBucket(bucket, fingerprint)) {
+        return true;
+    }
+
+    for (int kick = 0; kick != MAX_KICKS; ++kick) {
+        kick_state_ += 0x9e3779b97f4a7c15ULL;
+        size_t index = MixBits(kick_state_) % BUCKET_SIZE;
+        uint64_t slots = LoadBucket(bucket);
+        uint64_t kicked = GetSlot(slots, index);
+        StoreBucket(bucket, SetSlot(slots, index, fingerprint));
+        fingerprint = kicked;
+        bucket = GetAlternateBucket(bucket, fingerprint);
+        if (InsertIntoBucket(bucket, fingerprint)) {
+            return true;
+        }
+    }
+    // the key itself is in the filter now, so the victim keeps the filter exact
+    has_victim_ = true;
+    victim_.bucket = bucket;
+    victim_.fingerprint = fingerprint;
+    return true;
+}
+
+template<typename TKey, typename TBaseHash>
+bool CuckooFilter<TKey, TBaseHash>::Insert(const TKey &key) {
+    return InsertLocation(GetLocation(key));
+}
+
+template<typename TKey, typename TBaseHash>
+bool CuckooFilter<TKey, TBaseHash>::Contains(const TKey &key) const {
+    return ContainsLocation(GetLocation(key));
+}
+
+template<typename TKey, typename TBaseHash>
+bool CuckooFilter<TKey, TBaseHash>::Erase(const TKey &key) {
+    Location location = GetLocation(key);
+    uint64_t alternate = GetAlternateBucket(location.bucket, location.fingerprint);
+    if (EraseFromBucket(location.bucket, location.fingerprint) ||
+        EraseFromBucket(alternate, location.fingerprint)) {
+        --size_;
+        if (has_victim_) {
+            // there may be room for the victim now
+            uint64_t victim_alternate = GetAlternateBucket(victim_.bucket, victim_.fingerprint);
+            if (InsertIntoBucket(victim_.bucket, victim_.fingerprint) ||
+                InsertIntoBucket(victim_alternate, victim_.fingerprint)) {
+                has_victim_ = false;
+            }
+        }
+        return true;
+    }
+    if (has_victim_ && victim_.fingerprint == location.fingerprint &&
+        (victim_.bucket == location.bucket || victim_.bucket == alternate)) {
+        has_victim_ = false;
+        --size_;
+        return true;
+    }
+    return false;
+}
+
+template<typename TKey, typename TBaseHash>
+size_t CuckooFilter<TKey, TBaseHash>::InsertBatch(const TKey *keys, size_t count) {
+    size_t inserted_count = 0;
+    Location locations[BATCH_GROUP_SIZE];
+    for (size_t group_begin = 0; group_begin < count; group_begin += BATCH_GROUP_SIZE) {
+        size_t group_size = count - group_begin;
+        if (group_size > BATCH_GROUP_SIZE) {
+            group_size = BATCH_GROUP_SIZE;
+        }
+        for (size_t index = 0; index != group_size; ++index) {
+            locations[index] = GetLocation(keys[group_begin + index]);
+            Prefetch(GetBucketAddress(locations[index].bucket));
+        }
+        for (size_t index = 0; index != group_size; ++index) {
+            if (InsertLocation(locations[index])) {
+                ++inserted_count;
+            }
+        }
+    }
+    return inserted_count;
+}
+
+template<typename TKey, typename TBaseHash>
+void CuckooFilter<TKey, TBaseHash>::ContainsBatch(const TKey *keys, size_t count, uint8_t *out) const {
+    Location locations[BATCH_GROUP_SIZE];
+    for (size_t group_begin = 0; group_begin < count; group_begin += BATCH_GROUP_SIZE) {
+        size_t group_size = count - group_begin;
+        if (group_size > BATCH_GROUP_SIZE) {
+            group_size = BATCH_GROUP_SIZE;
+        }
+        for (size_t index = 0; index != group_size; ++index) {
+            const Location &location = locations[index] = GetLocation(keys[group_begin + index]);
+            Prefetch(GetBucketAddress(location.bucket));
+            Prefetch(GetBucketAddress(GetAlternateBucket(location.bucket, location.fingerprint)));
+        }
+        for (size_t index = 0; index != group_size; ++index) {
+            out[group_begin + index] = ContainsLocation(locations[index]) ? 1 : 0;
+        }
+    }
+}
+
+template<typename TKey, typename TBaseHash>
+size_t CuckooFilter<TKey, TBaseHash>::GetMemoryUsage() const {
+    return sizeof(*this) + table_.capacity();
+}
+
+} // namespace algorithms
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "hash/hash_set.hpp"
+
+namespace algorithms {
+
+// Static map on top of FixedSet: keys are placed by perfect hashing,
+// values are kept in a separate array parallel to the table of key slots,
+// so a lookup costs one FixedSet lookup and one access to the value
+template<typename TKey,
+         typename TValue,
+         typename THash = typename TraitsHashFamily<TKey>::Type,
+         typename TRange = FastRange>
+class FixedMap {
+    public:
+        explicit FixedMap(unsigned seed = 237) :
+            keys_(seed) {}
+
+        // If a key is repeated, the last of its values is kept.
+        // Builds the map using 'threads_count' threads, 0 means hardware concurrency
+        void Init(const std::vector<std::pair<TKey, TValue> >& elements, unsigned threads_count = 0);
+
+        // Returns pointer to the value of 'key' inside the map or nullptr if the key is absent.
+        // The pointer stays valid until the next Init
+        const TValue *Find(const TKey &key) const;
+        bool Contains(const TKey &key) const { return keys_.Contains(key); }
+
+        // Bytes occupied by the map, including its tables
+        size_t GetMemoryUsage() const;
+
+    private:
+        FixedSet<TKey, THash, TRange> keys_;
+        // values_[slot] is the value of the key in that slot of 'keys_'
+        std::vector<TValue> values_;
+};
+
+template<typename TKey, typename TValue, typename THash, typename TRange>
+void FixedMap<TKey, TValue, THash, TRange>::Init(const std::vector<std::pair<TKey, TValue> >& elements,
+                                                 unsigned threads_count) {
+    std::vector<TKey> keys;
+    keys.reserve(elements.size());
+    for (const std::pair<TKey, TValue> &element : elements) {
+        keys.push_back(element.first);
+    }
+    keys_.Init(keys, threads_count);
+
+    values_.assign(keys_.GetSlotsCount(), TValue());
+    for (const std::pair<TKey, TValue> &element : elements) {
+        size_t slot;
+        keys_.FindSlot(element.first, &slot);
+        values_[slot] = element.second;
+    }
+}
+
+template<typename TKey, typename TValue, typename THash, typename TRange>
+const TValue *FixedMap<TKey, TValue, THash, TRange>::Find(const TKey &key) const {
+    size_t slot;
+    if (!keys_.FindSlot(key, &slot)) {
+        return nullptr;
+    }
+    return &values_[slot];
+}
+
+template<typename TKey, typename TValue, typename THash, typename TRange>
+size_t FixedMap<TKey, TValue, THash, TRange>::GetMemoryUsage() const {
+    return keys_.GetMemoryUsage() - sizeof(keys_) + sizeof(*this) +
+           values_.capacity() * sizeof(TValue);
+}
+
+} // namespace algorithms
@@ -0,0 +1,398 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <type_traits>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "hash/hash_set.hpp"
+
+namespace algorithms {
+
+// Open addressing hash table in the style of Swiss tables. Slots are split into groups
+// of GROUP_SIZE; every slot has a control byte telling whether it is empty, deleted
+// or full, and for a full slot holding 7 bits of the hash of its key. A lookup
+// compares the control bytes of a whole group at once (with SSE2 when available)
+// and touches slots only for matching bytes, groups are probed quadratically.
+//
+// Erasure does not need tombstones in a group which has an empty slot: a probe
+// passes over a group only when the group is full, so no key can lie behind it.
+// THash is a hash family as in FixedSet, a function is drawn from it on construction.
+// TSlot is either TKey or std::pair<TKey, TValue>
+template<typename TKey, typename TSlot, typename THash>
+class FlatHashTable {
+    public:
+        explicit FlatHashTable(unsigned seed);
+        ~FlatHashTable();
+
+        FlatHashTable(const FlatHashTable &other) = delete;
+        FlatHashTable &operator = (const FlatHashTable &other) = delete;
+
+        FlatHashTable(FlatHashTable &&other);
+        FlatHashTable &operator = (FlatHashTable &&other);
+
+        // Returns slot of 'key' or nullptr if the key is absent
+        TSlot *Find(const TKey &key) const;
+        // Constructs slot from 'arguments' if 'key' is absent.
+        // Returns the slot of the key and whether it was inserted
+        template<typename... TArgs>
+        std::pair<TSlot *, bool> Emplace(const TKey &key, TArgs&&... arguments);
+        bool Erase(const TKey &key);
+
+        void Clear();
+        // Makes room for 'count' elements without further rehashing
+        void Reserve(size_t count);
+
+        size_t GetSize() const { return size_; }
+        // Bytes occupied by the table, including its arrays
+        size_t GetMemoryUsage() const;
+
+    private:
+        static const size_t GROUP_SIZE = 16;
+        static const int8_t EMPTY = -128;
+        static const int8_t DELETED = -2;
+        // At most MAX_LOAD_NUMERATOR / MAX_LOAD_DENOMINATOR of slots are full or deleted
+        static const size_t MAX_LOAD_NUMERATOR = 7;
+        static const size_t MAX_LOAD_DENOMINATOR = 8;
+
+        struct ControlGroup {
+            alignas(GROUP_SIZE) int8_t bytes[GROUP_SIZE];
+        };
+        typedef typename std::aligned_storage<sizeof(TSlot), alignof(TSlot)>::type SlotStorage;
+
+        // Bit i of a mask is set for the matching byte i of the group
+        static uint32_t Match(const ControlGroup &group, int8_t byte);
+        static uint32_t MatchEmptyOrDeleted(const ControlGroup &group);
+
+        static const TKey &GetKey(const TKey &slot) {
+            return slot;
+        }
+        template<typename TValue>
+        static const TKey &GetKey(const std::pair<TKey, TValue> &slot) {
+            return slot.first;
+        }
+
+        size_t GetCapacity() const { return groups_count_ * GROUP_SIZE; }
+        size_t GetMaxLoad() const { return GetCapacity() / MAX_LOAD_DENOMINATOR * MAX_LOAD_NUMERATOR; }
+        TSlot *GetSlot(size_t index) const {
+            return reinterpret_cast<TSlot *>(&slots_[index]);
+        }
+        int8_t &GetControl(size_t index) const {
+            return controls_[index / GROUP_SIZE].bytes[index % GROUP_SIZE];
+        }
+
+        // First group of the probe sequence of 'hash'
+        size_t GetGroup(uint32_t hash) const {
+            return static_cast<size_t>((static_cast<uint64_t>(hash) * groups_count_) >> 32);
+        }
+        static int8_t GetHashByte(uint32_t hash) {
+            return static_cast<int8_t>(hash & 0x7F);
+        }
+
+        // Index of the first empty or deleted slot in the probe sequence of 'hash'
+        size_t FindInsertPosition(uint32_t hash) const;
+        void Rehash(size_t groups_count);
+        void DestroySlots();
+
+        THash function_;
+        std::unique_ptr<ControlGroup[]> controls_;
+        std::unique_ptr<SlotStorage[]> slots_;
+        // Always a power of two, so that the quadratic probing visits every group
+        size_t groups_count_;
+        size_t size_;
+        // Number of empty slots which can still be filled before rehashing
+        size_t growth_left_;
+};
+
+template<typename TKey, typename TSlot, typename THash>
+FlatHashTable<TKey, TSlot, THash>::FlatHashTable(unsigned seed) :
+    groups_count_(0),
+    size_(0),
+    growth_left_(0) {
+    std::minstd_rand0 generator(seed);
+    function_ = THash::Generate(&generator);
+}
+
+template<typename TKey, typename TSlot, typename THash>
+FlatHashTable<TKey, TSlot, THash>::~FlatHashTable() {
+    DestroySlots();
+}
+
+template<typename TKey, typename TSlot, typename THash>
+FlatHashTable<TKey, TSlot, THash>::FlatHashTable(FlatHashTable &&other) :
+    function_(other.function_),
+    controls_(std::move(other.controls_)),
+    slots_(std::move(other.slots_)),
+    groups_count_(other.groups_count_),
+    size_(other.size_),
+    growth_left_(other.growth_left_) {
+    other.groups_count_ = 0;
+    other.size_ = 0;
+    other.growth_left_ = 0;
+}
+
+template<typename TKey, typename TSlot, typename THash>
+FlatHashTable<TKey, TSlot, THash> &FlatHashTable<TKey, TSlot, THash>::operator = (FlatHashTable &&other) {
+    if (&other != this) {
+        DestroySlots();
+        function_ = other.function_;
+        controls_ = std::move(other.controls_);
+        slots_ = std::move(other.slots_);
+        groups_count_ = other.groups_count_;
+        size_ = other.size_;
+        growth_left_ = other.growth_left_;
+
+        other.groups_count_ = 0;
+        other.size_ = 0;
+        other.growth_left_ = 0;
+    }
+    return *this;
+}
+
+template<typename TKey, typename TSlot, typename THash>
+uint32_t FlatHashTable<TKey, TSlot, THash>::Match(const ControlGroup &group, int8_t byte) {
+#ifdef __SSE2__
+    __m128i controls = _mm_load_si128(reinterpret_cast<const __m128i *>(group.bytes));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(controls, _mm_set1_epi8(byte))));
+#else
+    uint32_t mask = 0;
+    for (size_t index = 0; index != GROUP_SIZE; ++index) {
+        mask |= static_cast<uint32_t>(group.bytes[index] == byte) << index;
+    }
+    return mask;
+#endif
+}
+
+template<typename TKey, typename TSlot, typename THash>
+uint32_t FlatHashTable<TKey, TSlot, THash>::MatchEmptyOrDeleted(const ControlGroup &group) {
+    // empty and deleted bytes are the only negative ones
+#ifdef __SSE2__
+    __m128i controls = _mm_load_si128(reinterpret_cast<const __m128i *>(group.bytes));
+    return static_cast<uint32_t>(_mm_movemask_epi8(controls));
+#else
+    uint32_t mask = 0;
+    for (size_t index = 0; index != GROUP_SIZE; ++index) {
+        mask |= static_cast<uint32_t>(group.bytes[index] < 0) << index;
+    }
+    return mask;
+#endif
+}
+
+template<typename TKey, typename TSlot, typename THash>
+TSlot *FlatHashTable<TKey, TSlot, THash>::Find(const TKey &key) const {
+    if (groups_count_ == 0) {
+        return nullptr;
+    }
+    uint32_t hash = function_(key);
+    int8_t hash_byte = GetHashByte(hash);
+    size_t group = GetGroup(hash);
+    for (size_t step = 1; ; ++step) {
+        const ControlGroup &controls = controls_[group];
+        for (uint32_t mask = Match(controls, hash_byte); mask != 0; mask &= mask - 1) {
+            TSlot *slot = GetSlot(group * GROUP_SIZE + __builtin_ctz(mask));
+            if (GetKey(*slot) == key) {
+                return slot;
+            }
+        }
+        if (Match(controls, EMPTY) != 0) {
+            return nullptr;
+        }
+        group = (group + step) & (groups_count_ - 1);
+    }
+}
+
+template<typename TKey, typename TSlot, typename THash>
+size_t FlatHashTable<TKey, TSlot, THash>::FindInsertPosition(uint32_t hash) const {
+    size_t group = GetGroup(hash);
+    for (size_t step = 1; ; ++step) {
+        uint32_t mask = MatchEmptyOrDeleted(controls_[group]);
+        if (mask != 0) {
+            return group * GROUP_SIZE + __builtin_ctz(mask);
+        }
+        group = (group + step) & (groups_count_ - 1);
+    }
+}
+
+template<typename TKey, typename TSlot, typename THash>
+template<typename... TArgs>
+std::pair<TSlot *, bool> FlatHashTable<TKey, TSlot, THash>::Emplace(const TKey &key, TArgs&&... arguments) {
+    TSlot *found = Find(key);
+    if (found != nullptr) {
+        return std::make_pair(found, false);
+    }
+    if (growth_left_ == 0) {
+        // deleted slots are reclaimed in place while they make a large part of the table
+        if (groups_count_ != 0 && (size_ + 1) * 2 <= GetMaxLoad()) {
+            Rehash(groups_count_);
+        } else {
+            Rehash(groups_count_ == 0 ? 1 : groups_count_ * 2);
+        }
+    }
+
+    uint32_t hash = function_(key);
+    size_t position = FindInsertPosition(hash);
+    int8_t &control = GetControl(position);
+    if (control == EMPTY) {
+        --growth_left_;
+    }
+    TSlot *slot = new (GetSlot(position)) TSlot(std::forward<TArgs>(arguments)...);
+    control = GetHashByte(hash);
+    ++size_;
+    return std::make_pair(slot, true);
+}
+
+template<typename TKey, typename TSlot, typename THash>
+bool FlatHashTable<TKey, TSlot, THash>::Erase(const TKey &key) {
+    TSlot *slot = Find(key);
+    if (slot == nullptr) {
+        return false;
+    }
+    size_t position = slot - GetSlot(0);
+    slot->~TSlot();
+    if (Match(controls_[position / GROUP_SIZE], EMPTY) != 0) {
+        GetControl(position) = EMPTY;
+        ++growth_left_;
+    } else {
+        GetControl(position) = DELETED;
+    }
+    --size_;
+    return true;
+}
+
+template<typename TKey, typename TSlot, typename THash>
+void FlatHashTable<TKey, TSlot, THash>::Rehash(size_t groups_count) {
+    std::unique_ptr<ControlGroup[]> old_controls(std::move(controls_));
+    std::unique_ptr<SlotStorage[]> old_slots(std::move(slots_));
+    size_t old_capacity = GetCapacity();
+
+    controls_.reset(new ControlGroup[groups_count]);
+    std::memset(static_cast<void *>(controls_.get()), EMPTY, groups_count * sizeof(ControlGroup));
+    slots_.reset(new SlotStorage[groups_count * GROUP_SIZE]);
+    groups_count_ = groups_count;
+    growth_left_ = GetMaxLoad() - size_;
+
+    for (size_t index = 0; index != old_capacity; ++index) {
+        if (old_controls[index / GROUP_SIZE].bytes[index % GROUP_SIZE] < 0) {
+            continue;
+        }
+        TSlot *old_slot = reinterpret_cast<TSlot *>(&old_slots[index]);
+        uint32_t hash = function_(GetKey(*old_slot));
+        size_t position = FindInsertPosition(hash);
+        new (GetSlot(position)) TSlot(std::move(*old_slot));
+        GetControl(position) = GetHashByte(hash);
+        old_slot->~TSlot();
+    }
+}
+
+template<typename TKey, typename TSlot, typename THash>
+void FlatHashTable<TKey, TSlot, THash>::Reserve(size_t count) {
+    size_t groups_count = groups_count_ == 0 ? 1 : groups_count_;
+    while (groups_count * GROUP_SIZE / MAX_LOAD_DENOMINATOR * MAX_LOAD_NUMERATOR < count) {
+        groups_count *= 2;
+    }
+    if (groups_count != groups_count_) {
+        Rehash(groups_count);
+    }
+}
+
+template<typename TKey, typename TSlot, typename THash>
+void FlatHashTable<TKey, TSlot, THash>::DestroySlots() {
+    if (!std::is_trivially_destructible<TSlot>::value) {
+        for (size_t index = 0; index != GetCapacity(); ++index) {
+            if (GetControl(index) >= 0) {
+                GetSlot(index)->~TSlot();
+            }
+        }
+    }
+}
+
+template<typename TKey, typename TSlot, typename THash>
+void FlatHashTable<TKey, TSlot, THash>::Clear() {
+    DestroySlots();
+    if (groups_count_ != 0) {
+        std::memset(static_cast<void *>(controls_.get()), EMPTY, groups_count_ * sizeof(ControlGroup));
+    }
+    size_ = 0;
+    growth_left_ = GetMaxLoad();
+}
+
+template<typename TKey, typename TSlot, typename THash>
+size_t FlatHashTable<TKey, TSlot, THash>::GetMemoryUsage() const {
+    return sizeof(*this) + groups_count_ * sizeof(ControlGroup) + GetCapacity() * sizeof(SlotStorage);
+}
+
+// Dynamic hash set on FlatHashTable
+template<typename TKey,
+         typename THash = typename TraitsHashFamily<TKey>::Type>
+class FlatHashSet {
+    public:
+        explicit FlatHashSet(unsigned seed = 237) :
+            table_(seed) {}
+
+        // Returns false if the element was already present
+        bool Insert(const TKey &element) {
+            return table_.Emplace(element, element).second;
+        }
+        // Returns false if the element was absent
+        bool Erase(const TKey &element) { return table_.Erase(element); }
+        bool Contains(const TKey &element) const { return table_.Find(element) != nullptr; }
+
+        void Clear() { table_.Clear(); }
+        void Reserve(size_t count) { table_.Reserve(count); }
+        size_t GetSize() const { return table_.GetSize(); }
+        size_t GetMemoryUsage() const { return table_.GetMemoryUsage(); }
+
+    private:
+        FlatHashTable<TKey, TKey, THash> table_;
+};
+
+// Dynamic hash map on FlatHashTable; pointers to values stay valid until the next rehash
+template<typename TKey,
+         typename TValue,
+         typename THash = typename TraitsHashFamily<TKey>::Type>
+class FlatHashMap {
+    public:
+        explicit FlatHashMap(unsigned seed = 237) :
+            table_(seed) {}
+
+        // Inserts the pair or replaces the value of a present key.
+        // Returns true if the key was absent
+        bool Insert(const TKey &key, const TValue &value) {
+            std::pair<std::pair<TKey, TValue> *, bool> result = table_.Emplace(key, key, value);
+            if (!result.second) {
+                result.first->second = value;
+            }
+            return result.second;
+        }
+        // Returns false if the key was absent
+        bool Erase(const TKey &key) { return table_.Erase(key); }
+
+        // Returns pointer to the value of 'key' or nullptr if the key is absent
+        TValue *Find(const TKey &key) {
+            std::pair<TKey, TValue> *slot = table_.Find(key);
+            return slot ? &slot->second : nullptr;
+        }
+        const TValue *Find(const TKey &key) const {
+            const std::pair<TKey, TValue> *slot = table_.Find(key);
+            return slot ? &slot->second : nullptr;
+        }
+        bool Contains(const TKey &key) const { return table_.Find(key) != nullptr; }
+
+        void Clear() { table_.Clear(); }
+        void Reserve(size_t count) { table_.Reserve(count); }
+        size_t GetSize() const { return table_.GetSize(); }
+        size_t GetMemoryUsage() const { return table_.GetMemoryUsage(); }
+
+    private:
+        FlatHashTable<TKey, std::pair<TKey, TValue>, THash> table_;
+};
+
+} // namespace algorithms
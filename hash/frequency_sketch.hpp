@@ -0,0 +1,299 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "hash/hash_set.hpp"
+
+namespace algorithms {
+
+// Sketches of key frequencies in a stream: a table of 'depth' rows of 'width' counters,
+// a key updates one counter in every row, chosen by a hash function of the row.
+// Sketches with equal dimensions and seeds draw equal hash functions, so sketches
+// filled by different threads can be merged by adding the tables.
+// A sketch itself is not thread-safe.
+// THash is a hash family as in FixedSet
+
+// Count-Min sketch (Cormode, Muthukrishnan): a key is estimated by the minimum
+// of its counters, which never undercounts. With width = e / epsilon
+// and depth = ln(1 / delta) an estimate exceeds the true count
+// by more than epsilon * GetTotal() with probability at most delta
+template<typename TKey,
+         typename THash = typename TraitsHashFamily<TKey>::Type>
+class CountMinSketch {
+    public:
+        typedef uint64_t Count;
+
+        // Throws std::invalid_argument if width or depth is zero
+        CountMinSketch(size_t width, size_t depth, unsigned seed = 237);
+
+        void Add(const TKey &key, Count count = 1);
+        Count Estimate(const TKey &key) const;
+        // Throws std::invalid_argument if dimensions or seeds differ
+        void Merge(const CountMinSketch &other);
+
+        // Sum of all counts added
+        Count GetTotal() const { return total_; }
+        size_t GetMemoryUsage() const;
+
+    private:
+        Count &GetCounter(size_t row, const TKey &key) {
+            return counters_[row * width_ + FastRange::Reduce(functions_[row](key), width_)];
+        }
+        const Count &GetCounter(size_t row, const TKey &key) const {
+            return counters_[row * width_ + FastRange::Reduce(functions_[row](key), width_)];
+        }
+
+        size_t width_;
+        size_t depth_;
+        unsigned seed_;
+        std::vector<THash> functions_;
+        std::vector<Count> counters_;
+        Count total_;
+};
+
+// Count-Sketch (Charikar, Chen, Farach-Colton): a key adds its count multiplied by
+// a random sign of the row, and is estimated by the median of its signed counters.
+// The estimate is unbiased and also works with negative counts. With width = 3 / epsilon^2
+// and depth = ln(1 / delta) it is off by more than epsilon times the Euclidean norm
+// of the frequency vector with probability at most delta
+template<typename TKey,
+         typename THash = typename TraitsHashFamily<TKey>::Type>
+class CountSketch {
+    public:
+        typedef int64_t Count;
+
+        // Throws std::invalid_argument if width or depth is zero or depth exceeds MAX_DEPTH
+        CountSketch(size_t width, size_t depth, unsigned seed = 237);
+
+        void Add(const TKey &key, Count count = 1);
+        Count Estimate(const TKey &key) const;
+        // Throws std::invalid_argument if dimensions or seeds differ
+        void Merge(const CountSketch &other);
+
+        size_t GetMemoryUsage() const;
+
+        // Estimates of rows are kept on the stack to find their median
+        static const size_t MAX_DEPTH = 32;
+
+    private:
+        size_t GetIndex(size_t row, const TKey &key) const {
+            return row * width_ + FastRange::Reduce(functions_[row](key), width_);
+        }
+        Count GetSign(size_t row, const TKey &key) const {
+            return (sign_functions_[row](key) >> 31) ? 1 : -1;
+        }
+
+        size_t width_;
+        size_t depth_;
+        unsigned seed_;
+        std::vector<THash> functions_;
+        std::vector<THash> sign_functions_;
+        std::vector<Count> counters_;
+};
+
+// Streaming top-k over a frequency sketch: keeps the 'capacity' keys with the largest
+// estimates seen so far. A key replaces the smallest candidate when its estimate after
+// an update is larger. TSketch is CountMinSketch or CountSketch.
+// Trackers filled by different threads are merged like their sketches
+template<typename TKey,
+         typename TSketch = CountMinSketch<TKey> >
+class HeavyHitters {
+    public:
+        typedef typename TSketch::Count Count;
+
+        HeavyHitters(size_t capacity, const TSketch &sketch);
+
+        void Add(const TKey &key, Count count = 1);
+        // Merges sketches and chooses the candidates among keys of both trackers.
+        // Throws std::invalid_argument if the sketches cannot be merged
+        void Merge(const HeavyHitters &other);
+
+        // Candidates with their current estimates, by decreasing estimate
+        std::vector<std::pair<TKey, Count> > GetTop() const;
+        const TSketch &GetSketch() const { return sketch_; }
+
+    private:
+        void UpdateCandidate(const TKey &key, Count estimate);
+
+        size_t capacity_;
+        TSketch sketch_;
+        std::unordered_map<TKey, Count> candidates_;
+        // Estimates of candidates with their keys, the smallest first
+        std::set<std::pair<Count, TKey> > order_;
+};
+
+template<typename TKey, typename THash>
+CountMinSketch<TKey, THash>::CountMinSketch(size_t width, size_t depth, unsigned seed) :
+    width_(width),
+    depth_(depth),
+    seed_(seed),
+    counters_(width * depth, 0),
+    total_(0) {
+    if (width == 0 || depth == 0) {
+        throw std::invalid_argument("CountMinSketch has no counters\n");
+    }
+    std::minstd_rand0 generator(seed);
+    for (size_t row = 0; row != depth; ++row) {
+        functions_.push_back(THash::Generate(&generator));
+    }
+}
+
+template<typename TKey, typename THash>
+void CountMinSketch<TKey, THash>::Add(const TKey &key, Count count) {
+    for (size_t row = 0; row != depth_; ++row) {
+        GetCounter(row, key) += count;
+    }
+    total_ += count;
+}
+
+template<typename TKey, typename THash>
+typename CountMinSketch<TKey, THash>::Count CountMinSketch<TKey, THash>::Estimate(const TKey &key) const {
+    Count estimate = GetCounter(0, key);
+    for (size_t row = 1; row != depth_; ++row) {
+        estimate = std::min(estimate, GetCounter(row, key));
+    }
+    return estimate;
+}
+
+template<typename TKey, typename THash>
+void CountMinSketch<TKey, THash>::Merge(const CountMinSketch &other) {
+    if (other.width_ != width_ || other.depth_ != depth_ || other.seed_ != seed_) {
+        throw std::invalid_argument("Merged CountMinSketch sketches have different parameters\n");
+    }
+    for (size_t index = 0; index != counters_.size(); ++index) {
+        counters_[index] += other.counters_[index];
+    }
+    total_ += other.total_;
+}
+
+template<typename TKey, typename THash>
+size_t CountMinSketch<TKey, THash>::GetMemoryUsage() const {
+    return sizeof(*this) + functions_.capacity() * sizeof(THash) + counters_.capacity() * sizeof(Count);
+}
+
+template<typename TKey, typename THash>
+CountSketch<TKey, THash>::CountSketch(size_t width, size_t depth, unsigned seed) :
+    width_(width),
+    depth_(depth),
+    seed_(seed),
+    counters_(width * depth, 0) {
+    if (width == 0 || depth == 0 || depth > MAX_DEPTH) {
+        throw std::invalid_argument("Dimensions of CountSketch are out of range\n");
+    }
+    std::minstd_rand0 generator(seed);
+    for (size_t row = 0; row != depth; ++row) {
+        functions_.push_back(THash::Generate(&generator));
+        sign_functions_.push_back(THash::Generate(&generator));
+    }
+}
+
+template<typename TKey, typename THash>
+void CountSketch<TKey, THash>::Add(const TKey &key, Count count) {
+    for (size_t row = 0; row != depth_; ++row) {
+        counters_[GetIndex(row, key)] += GetSign(row, key) * count;
+    }
+}
+
+template<typename TKey, typename THash>
+typename CountSketch<TKey, THash>::Count CountSketch<TKey, THash>::Estimate(const TKey &key) const {
+    Count estimates[MAX_DEPTH] = {};
+    for (size_t row = 0; row != depth_; ++row) {
+        estimates[row] = GetSign(row, key) * counters_[GetIndex(row, key)];
+    }
+    std::nth_element(estimates, estimates + depth_ / 2, estimates + depth_);
+    Count median = estimates[depth_ / 2];
+    if (depth_ % 2 == 0) {
+        // the lower middle element is the largest one before the upper middle
+        Count lower = *std::max_element(estimates, estimates + depth_ / 2);
+        median = lower + (median - lower) / 2;
+    }
+    return median;
+}
+
+template<typename TKey, typename THash>
+void CountSketch<TKey, THash>::Merge(const CountSketch &other) {
+    if (other.width_ != width_ || other.depth_ != depth_ || other.seed_ != seed_) {
+        throw std::invalid_argument("Merged CountSketch sketches have different parameters\n");
+    }
+    for (size_t index = 0; index != counters_.size(); ++index) {
+        counters_[index] += other.counters_[index];
+    }
+}
+
+template<typename TKey, typename THash>
+size_t CountSketch<TKey, THash>::GetMemoryUsage() const {
+    return sizeof(*this) + (functions_.capacity() + sign_functions_.capacity()) * sizeof(THash) +
+           counters_.capacity() * sizeof(Count);
+}
+
+template<typename TKey, typename TSketch>
+HeavyHitters<TKey, TSketch>::HeavyHitters(size_t capacity, const TSketch &sketch) :
+    capacity_(capacity),
+    sketch_(sketch) {}
+
+template<typename TKey, typename TSketch>
+void HeavyHitters<TKey, TSketch>::UpdateCandidate(const TKey &key, Count estimate) {
+    auto found = candidates_.find(key);
+    if (found != candidates_.end()) {
+        order_.erase(std::make_pair(found->second, key));
+        found->second = estimate;
+        order_.insert(std::make_pair(estimate, key));
+        return;
+    }
+    if (candidates_.size() == capacity_) {
+        if (capacity_ == 0 || !(order_.begin()->first < estimate)) {
+            return;
+        }
+        candidates_.erase(order_.begin()->second);
+        order_.erase(order_.begin());
+    }
+    candidates_.insert(std::make_pair(key, estimate));
+    order_.insert(std::make_pair(estimate, key));
+}
+
+template<typename TKey, typename TSketch>
+void HeavyHitters<TKey, TSketch>::Add(const TKey &key, Count count) {
+    sketch_.Add(key, count);
+    UpdateCandidate(key, sketch_.Estimate(key));
+}
+
+template<typename TKey, typename TSketch>
+void HeavyHitters<TKey, TSketch>::Merge(const HeavyHitters &other) {
+    sketch_.Merge(other.sketch_);
+    std::vector<TKey> keys;
+    for (const auto &candidate : candidates_) {
+        keys.push_back(candidate.first);
+    }
+    for (const auto &candidate : other.candidates_) {
+        keys.push_back(candidate.first);
+    }
+    candidates_.clear();
+    order_.clear();
+    for (const TKey &key : keys) {
+        UpdateCandidate(key, sketch_.Estimate(key));
+    }
+}
+
+template<typename TKey, typename TSketch>
+std::vector<std::pair<TKey, typename HeavyHitters<TKey, TSketch>::Count> >
+HeavyHitters<TKey, TSketch>::GetTop() const {
+    std::vector<std::pair<TKey, Count> > top;
+    for (const auto &candidate : candidates_) {
+        top.push_back(std::make_pair(candidate.first, sketch_.Estimate(candidate.first)));
+    }
+    std::sort(top.begin(), top.end(), [] (const std::pair<TKey, Count> &first,
+                                          const std::pair<TKey, Count> &second) {
+        return first.second > second.second;
+    });
+    return top;
+}
+
+} // namespace algorithms
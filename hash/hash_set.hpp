@@ -1,7 +1,20 @@
+#pragma once
+
 #include <vector>
 #include <functional>
 #include <random>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "hash/mapped_file.hpp"
+#include "hash/parallel_for.hpp"
 
 namespace algorithms {
 
@@ -18,48 +31,315 @@ class UniversalHashFunctor {
         unsigned long long prime_;
 };
 
+// Hash families used by FixedSet. A family is a functor type THash with
+//     uint32_t operator () (const TKey &key) const;
+//     static THash Generate(std::minstd_rand0 *generator);
+//     static const uint32_t FILE_TAG;
+// where Generate draws a random member of the family and FILE_TAG,
+// unique among families, marks files written by FixedSet::SaveToFile.
+// Two different keys have to collide with probability O(1 / 2^32).
+
+// Multiply-shift hashing of integers up to 64 bits:
+// result = ( a_parameter_ * number mod 2^64 ) >> 32, a_parameter_ is odd.
+// One multiplication, but only the high bits of the result are universal,
+// so it has to be combined with FastRange reduction
+class MultiplyShiftHash {
+    public:
+        explicit MultiplyShiftHash(uint64_t a_parameter = 1) :
+            a_parameter_(a_parameter | 1) {}
+
+        static const uint32_t FILE_TAG = 1;
+
+        uint32_t operator () (uint64_t number) const {
+            return static_cast<uint32_t>((a_parameter_ * number) >> 32);
+        }
+
+        static MultiplyShiftHash Generate(std::minstd_rand0 *generator) {
+            return MultiplyShiftHash(std::uniform_int_distribution<uint64_t>() (*generator));
+        }
+
+    private:
+        uint64_t a_parameter_;
+};
+
+// Multiply-add-shift hashing of integers up to 32 bits:
+// result = ( ( a_parameter_ * number + b_parameter_ ) mod 2^64 ) >> 32
+class MultiplyAddShiftHash32 {
+    public:
+        MultiplyAddShiftHash32(uint64_t a_parameter = 0, uint64_t b_parameter = 0) :
+            a_parameter_(a_parameter),
+            b_parameter_(b_parameter) {}
+
+        static const uint32_t FILE_TAG = 2;
+
+        uint32_t operator () (uint32_t number) const {
+            return static_cast<uint32_t>((a_parameter_ * number + b_parameter_) >> 32);
+        }
+
+        static MultiplyAddShiftHash32 Generate(std::minstd_rand0 *generator) {
+            std::uniform_int_distribution<uint64_t> distribution;
+            uint64_t a_random = distribution(*generator);
+            uint64_t b_random = distribution(*generator);
+            return MultiplyAddShiftHash32(a_random, b_random);
+        }
+
+    private:
+        uint64_t a_parameter_;
+        uint64_t b_parameter_;
+};
+
+// Multiply-add-shift hashing of integers up to 64 bits, taken as two 32-bit halves:
+// result = ( ( low_parameter_ * low + high_parameter_ * high + b_parameter_ ) mod 2^64 ) >> 32
+class MultiplyAddShiftHash64 {
+    public:
+        MultiplyAddShiftHash64(uint64_t low_parameter = 0,
+                               uint64_t high_parameter = 0,
+                               uint64_t b_parameter = 0) :
+            low_parameter_(low_parameter),
+            high_parameter_(high_parameter),
+            b_parameter_(b_parameter) {}
+
+        static const uint32_t FILE_TAG = 3;
+
+        uint32_t operator () (uint64_t number) const {
+            uint64_t low = number & 0xFFFFFFFFULL;
+            uint64_t high = number >> 32;
+            return static_cast<uint32_t>(
+                (low_parameter_ * low + high_parameter_ * high + b_parameter_) >> 32);
+        }
+
+        static MultiplyAddShiftHash64 Generate(std::minstd_rand0 *generator) {
+            std::uniform_int_distribution<uint64_t> distribution;
+            uint64_t low_random = distribution(*generator);
+            uint64_t high_random = distribution(*generator);
+            uint64_t b_random = distribution(*generator);
+            return MultiplyAddShiftHash64(low_random, high_random, b_random);
+        }
+
+    private:
+        uint64_t low_parameter_;
+        uint64_t high_parameter_;
+        uint64_t b_parameter_;
+};
+
+// Hashing of byte strings: polynomial hash over 32-bit words modulo the prime 2^61 - 1,
+// evaluated eight bytes per step, then reduced to 32 bits by multiply-shift
+class StringHash {
+    public:
+        StringHash(uint64_t a_parameter = 1, uint64_t b_parameter = 1);
+
+        static const uint32_t FILE_TAG = 4;
+
+        uint32_t operator () (const std::string &string) const;
+
+        static StringHash Generate(std::minstd_rand0 *generator);
+
+    private:
+        static const uint64_t PRIME_NUMBER = (1ULL << 61) - 1;
+
+        static uint64_t MultiplyModulo(uint64_t first, uint64_t second);
+        static uint64_t Reduce(uint64_t number);
+
+        // point where the polynomial is evaluated, and its square
+        uint64_t a_parameter_;
+        uint64_t a_square_;
+        // odd multiplier of the final multiply-shift
+        uint64_t b_parameter_;
+};
+
+// Range reductions map a 32-bit hash value to [0, size),
+// FILE_TAG distinguishes them in files as it does hash families
+
+// Remainder of division, relies on all bits of the hash value
+struct ModuloRange {
+    static const uint32_t FILE_TAG = 1;
+
+    static uint32_t Reduce(uint32_t hash, uint32_t size) {
+        return hash % size;
+    }
+};
+
+// Lemire's fast range: ( hash * size ) >> 32, no division, relies on the high bits
+struct FastRange {
+    static const uint32_t FILE_TAG = 2;
+
+    static uint32_t Reduce(uint32_t hash, uint32_t size) {
+        return static_cast<uint32_t>((static_cast<uint64_t>(hash) * size) >> 32);
+    }
+};
+
+template<typename TKey, typename TEnable = void>
+struct TraitsHashFamily;
+
+template<typename TKey>
+struct TraitsHashFamily<TKey, typename std::enable_if<std::is_integral<TKey>::value>::type> {
+    typedef typename std::conditional<(sizeof(TKey) <= 4),
+                                      MultiplyAddShiftHash32,
+                                      MultiplyAddShiftHash64>::type Type;
+};
+
+template<>
+struct TraitsHashFamily<std::string> {
+    typedef StringHash Type;
+};
+
+inline void Prefetch(const void *address) {
+#if defined(__GNUC__)
+    __builtin_prefetch(address);
+#else
+    (void) address;
+#endif
+}
+
+// splitmix64 finalizer: a bijection of 64-bit numbers whose every output bit
+// depends on every input bit
+inline uint64_t MixBits(uint64_t number) {
+    number = (number ^ (number >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    number = (number ^ (number >> 27)) * 0x94d049bb133111ebULL;
+    return number ^ (number >> 31);
+}
+
+// Static set with perfect two-level (FKS) hashing, O(1) worst-case lookup.
+// All second-level tables are packed into one array, a bucket is described
+// by a small header, so a lookup touches one header and one slot.
+// TRange reduces hash values to table indices
+template<typename TKey,
+         typename THash = typename TraitsHashFamily<TKey>::Type,
+         typename TRange = FastRange>
 class FixedSet {
     public:
-        void Init(const std::vector<int>& elements);
-        bool Contains(int element) const;
+        // Hash functions are drawn from generators derived from 'seed' only,
+        // so the built tables do not depend on the number of threads
+        explicit FixedSet(unsigned seed = 237);
+
+        FixedSet(const FixedSet &other);
+        FixedSet &operator = (const FixedSet &other);
+        FixedSet(FixedSet &&other);
+        FixedSet &operator = (FixedSet &&other);
+
+        // Builds the set using 'threads_count' threads, 0 means hardware concurrency.
+        // Repeated keys are kept once; keys have to be comparable by operator <
+        void Init(const std::vector<TKey>& elements, unsigned threads_count = 0);
+        bool Contains(const TKey &element) const;
+        // Finds position of 'element' in the table of slots, which has GetSlotsCount() entries.
+        // Lets other structures keep data for the elements in arrays parallel to the table
+        bool FindSlot(const TKey &element, size_t *slot) const;
+        size_t GetSlotsCount() const { return elements_count_; }
+        // Sets out[i] to 1 if keys[i] is in the set and to 0 otherwise.
+        // Keys are processed in groups: the bucket headers and then the slots of a whole group
+        // are prefetched before they are read, so that cache misses of different keys overlap
+        void ContainsBatch(const TKey *keys, size_t count, uint8_t *out) const;
+        // Bytes occupied by the set, including its tables
+        size_t GetMemoryUsage() const;
+
+        // Writes the built set to a file which can be mapped by MapFile, possibly
+        // by another process. Keys and hash functions have to be trivially copyable.
+        // The format stores offsets instead of pointers; it is specific to the byte order.
+        // The file records the key size and signedness and the tags of THash and TRange
+        // but not the key type itself, so keys of the same size and signedness are not told apart
+        void SaveToFile(const std::string &path) const;
+        // Replaces the content of the set by the tables of a file written by SaveToFile
+        // without copying them: lookups read the mapped pages directly.
+        // Throws std::runtime_error if the file is not a set of the same version, byte order,
+        // key size and signedness, hash family and range reduction;
+        // the tables themselves are trusted
+        void MapFile(const std::string &path);
 
     private:
-        static const int PRIME_NUMBER = 2000000011;
-        static const int adjust = 1000000000;
-
-        class Bucket {
-            public:
-                bool Contains(int element) const;
-                void Init(const std::vector<int> &elements);
-            private:
-                int GetIndex(int element) const;
-
-                UniversalHashFunctor function_;
-                std::vector<int> elements_;
+        // Top-level function is regenerated until the sum of squared bucket sizes
+        // is at most MAX_TABLE_FACTOR * (number of elements)
+        static const int MAX_TABLE_FACTOR = 4;
+        // Number of keys whose memory accesses are overlapped by ContainsBatch
+        static const size_t BATCH_GROUP_SIZE = 16;
+        // Smaller sets are built by one thread
+        static const size_t PARALLEL_THRESHOLD = 1 << 16;
+        // Number of elements or buckets taken by a thread at once;
+        // buckets differ a lot in the cost of their build, so chunks are small
+        static const size_t PARALLEL_CHUNK_SIZE = 1 << 12;
+
+        // Location of the bucket table inside 'elements_' and its hash function
+        struct BucketHeader {
+            uint32_t offset;
+            uint32_t size;
+            THash function;
+        };
+
+        static const uint32_t FILE_VERSION = 2;
+        static const uint32_t FILE_BYTE_ORDER = 0x01020304;
+        // Tables in the file start at offsets which are multiples of FILE_ALIGNMENT
+        static const uint64_t FILE_ALIGNMENT = 64;
+
+        // Beginning of a file written by SaveToFile, followed by buckets and elements tables
+        struct FileHeader {
+            char magic[8];
+            uint32_t version;
+            uint32_t byte_order;
+            uint32_t key_size;
+            uint32_t key_signed;
+            uint32_t hash_tag;
+            uint32_t range_tag;
+            uint32_t bucket_header_size;
+            uint64_t buckets_count;
+            uint64_t elements_count;
+            uint64_t buckets_offset;
+            uint64_t elements_offset;
+            THash function;
         };
 
-        UniversalHashFunctor function_;
-        std::vector<Bucket> buckets_;
-        static int AdjustElement(int element);
+        static uint64_t AlignFileOffset(uint64_t offset) {
+            return (offset + FILE_ALIGNMENT - 1) / FILE_ALIGNMENT * FILE_ALIGNMENT;
+        }
+        FileHeader MakeFileHeader() const;
+
+        // Points lookups to the tables owned by the set
+        void BindOwnTables();
+
+        // Places 'elements' into the table of 'bucket' without collisions;
+        // empty slots hold the first element of the bucket, so they never match other keys
+        void InitBucket(typename std::vector<TKey>::const_iterator begin,
+                        typename std::vector<TKey>::const_iterator end,
+                        BucketHeader *bucket,
+                        std::minstd_rand0 *generator,
+                        std::vector<bool> *occupied);
+
+        // Seed of the generator of the bucket with given index
+        uint32_t CountBucketSeed(size_t bucket_index) const;
 
-        int GetIndex(int element) const;
+        static uint32_t GetIndex(const BucketHeader &bucket, const TKey &element) {
+            return TRange::Reduce(bucket.function(element), bucket.size);
+        }
+        uint32_t GetIndex(const TKey &element) const {
+            return TRange::Reduce(function_(element), buckets_count_);
+        }
+
+        unsigned seed_;
+        THash function_;
+        // Tables of a set built by Init; empty if the set is mapped from a file
+        std::vector<BucketHeader> buckets_;
+        std::vector<TKey> elements_;
+        std::shared_ptr<MappedFile> mapping_;
+        // Tables used by lookups, either owned or mapped
+        const BucketHeader *buckets_data_;
+        uint32_t buckets_count_;
+        const TKey *elements_data_;
+        size_t elements_count_;
 };
 
-UniversalHashFunctor GenerateUniversalHashFunctor(int prime);
+inline UniversalHashFunctor GenerateUniversalHashFunctor(int prime);
 
-UniversalHashFunctor::UniversalHashFunctor(int a_parameter,
-                                           int b_parameter,
-                                           int prime) :
+inline UniversalHashFunctor::UniversalHashFunctor(int a_parameter,
+                                                  int b_parameter,
+                                                  int prime) :
     a_parameter_(a_parameter),
     b_parameter_(b_parameter),
     prime_(prime) {}
 
-UniversalHashFunctor::UniversalHashFunctor() :
+inline UniversalHashFunctor::UniversalHashFunctor() :
     a_parameter_(0),
     b_parameter_(0),
     prime_(1) {}
 
-int UniversalHashFunctor::operator () (int number) const {
+inline int UniversalHashFunctor::operator () (int number) const {
     unsigned long long number_long = number;
     unsigned long long factor = a_parameter_ * number_long + b_parameter_;
 
@@ -68,7 +348,7 @@ int UniversalHashFunctor::operator () (int number) const {
 }
 
 
-UniversalHashFunctor GenerateUniversalHashFunctor(int prime) {
+inline UniversalHashFunctor GenerateUniversalHashFunctor(int prime) {
     unsigned seed = 237;
     static std::minstd_rand0 generator (seed);
 
@@ -79,80 +359,412 @@ UniversalHashFunctor GenerateUniversalHashFunctor(int prime) {
 }
 
 
-void FixedSet::Bucket::Init(const std::vector<int>& elements) {
-    if (elements.size() == 0) {
-        return;
-    } else if (elements.size() == 1) {
-        elements_.resize(1);
-        elements_[0] = elements[0];
+inline StringHash::StringHash(uint64_t a_parameter, uint64_t b_parameter) :
+    a_parameter_(Reduce(a_parameter)),
+    a_square_(MultiplyModulo(a_parameter_, a_parameter_)),
+    b_parameter_(b_parameter | 1) {}
+
+inline uint64_t StringHash::Reduce(uint64_t number) {
+    number = (number & PRIME_NUMBER) + (number >> 61);
+    return number >= PRIME_NUMBER ? number - PRIME_NUMBER : number;
+}
+
+inline uint64_t StringHash::MultiplyModulo(uint64_t first, uint64_t second) {
+    unsigned __int128 product = static_cast<unsigned __int128>(first) * second;
+    uint64_t low = static_cast<uint64_t>(product) & PRIME_NUMBER;
+    uint64_t high = static_cast<uint64_t>(product >> 61);
+    return Reduce(low + high);
+}
+
+inline uint32_t StringHash::operator () (const std::string &string) const {
+    const char *data = string.data();
+    size_t length = string.size();
+    uint64_t result = 0;
+
+    // h = h * a^2 + low * a + high: both multiplications are independent
+    size_t position = 0;
+    for (; position + 8 <= length; position += 8) {
+        uint32_t words[2];
+        std::memcpy(words, data + position, 8);
+        result = Reduce(MultiplyModulo(result, a_square_) +
+                        MultiplyModulo(words[0], a_parameter_) + words[1]);
+    }
+    if (position != length) {
+        uint32_t words[2] = {0, 0};
+        std::memcpy(words, data + position, length - position);
+        result = Reduce(MultiplyModulo(result, a_square_) +
+                        MultiplyModulo(words[0], a_parameter_) + words[1]);
+    }
+    // length tells apart strings which differ only in trailing zero bytes
+    result = Reduce(MultiplyModulo(result, a_parameter_) + length);
+
+    return static_cast<uint32_t>((b_parameter_ * result) >> 32);
+}
+
+inline StringHash StringHash::Generate(std::minstd_rand0 *generator) {
+    uint64_t a_random = std::uniform_int_distribution<uint64_t>(1, PRIME_NUMBER - 1) (*generator);
+    uint64_t b_random = std::uniform_int_distribution<uint64_t>() (*generator);
+    return StringHash(a_random, b_random);
+}
+
+
+template<typename TKey, typename THash, typename TRange>
+FixedSet<TKey, THash, TRange>::FixedSet(unsigned seed) :
+    seed_(seed),
+    buckets_data_(nullptr),
+    buckets_count_(0),
+    elements_data_(nullptr),
+    elements_count_(0) {}
+
+template<typename TKey, typename THash, typename TRange>
+FixedSet<TKey, THash, TRange>::FixedSet(const FixedSet &other) :
+    seed_(other.seed_),
+    function_(other.function_),
+    buckets_(other.buckets_),
+    elements_(other.elements_),
+    mapping_(other.mapping_),
+    buckets_data_(other.buckets_data_),
+    buckets_count_(other.buckets_count_),
+    elements_data_(other.elements_data_),
+    elements_count_(other.elements_count_) {
+    if (!mapping_) {
+        BindOwnTables();
+    }
+}
+
+template<typename TKey, typename THash, typename TRange>
+FixedSet<TKey, THash, TRange>::FixedSet(FixedSet &&other) :
+    FixedSet(other.seed_) {
+    *this = std::move(other);
+}
+
+template<typename TKey, typename THash, typename TRange>
+FixedSet<TKey, THash, TRange> &FixedSet<TKey, THash, TRange>::operator = (const FixedSet &other) {
+    if (&other != this) {
+        FixedSet copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template<typename TKey, typename THash, typename TRange>
+FixedSet<TKey, THash, TRange> &FixedSet<TKey, THash, TRange>::operator = (FixedSet &&other) {
+    if (&other != this) {
+        // moving vectors keeps their buffers, so the table pointers stay valid
+        seed_ = other.seed_;
+        function_ = other.function_;
+        buckets_ = std::move(other.buckets_);
+        elements_ = std::move(other.elements_);
+        mapping_ = std::move(other.mapping_);
+        buckets_data_ = other.buckets_data_;
+        buckets_count_ = other.buckets_count_;
+        elements_data_ = other.elements_data_;
+        elements_count_ = other.elements_count_;
+
+        other.buckets_.clear();
+        other.elements_.clear();
+        other.BindOwnTables();
+    }
+    return *this;
+}
+
+template<typename TKey, typename THash, typename TRange>
+void FixedSet<TKey, THash, TRange>::BindOwnTables() {
+    buckets_data_ = buckets_.data();
+    buckets_count_ = static_cast<uint32_t>(buckets_.size());
+    elements_data_ = elements_.data();
+    elements_count_ = elements_.size();
+}
+
+template<typename TKey, typename THash, typename TRange>
+uint32_t FixedSet<TKey, THash, TRange>::CountBucketSeed(size_t bucket_index) const {
+    // mixed, so that neighbouring buckets get unrelated generators
+    uint64_t result = (static_cast<uint64_t>(seed_) << 32) + bucket_index + 0x9e3779b97f4a7c15ULL;
+    return static_cast<uint32_t>(MixBits(result));
+}
+
+template<typename TKey, typename THash, typename TRange>
+void FixedSet<TKey, THash, TRange>::InitBucket(typename std::vector<TKey>::const_iterator begin,
+                                               typename std::vector<TKey>::const_iterator end,
+                                               BucketHeader *bucket,
+                                               std::minstd_rand0 *generator,
+                                               std::vector<bool> *occupied) {
+    if (bucket->size == 1) {
+        elements_[bucket->offset] = *begin;
         return;
     }
 
     bool ok_function = false;
-    int size = elements.size() * elements.size();
-    std::vector<bool> occupied_elements(size, false);
-
     while (!ok_function) {
-        elements_.assign(size, 0);
-        function_ = GenerateUniversalHashFunctor(PRIME_NUMBER);
+        bucket->function = THash::Generate(generator);
         ok_function = true;
-        occupied_elements.assign(size, false);
-
-        for (auto iterator = elements.begin(); iterator != elements.end(); ++iterator) {
-            int result = GetIndex(*iterator);
-            if (occupied_elements[result]) { // collision detected
+        occupied->assign(bucket->size, false);
+
+        for (auto iterator = begin; iterator != end; ++iterator) {
+            uint32_t index = GetIndex(*bucket, *iterator);
+            if (!(*occupied)[index]) {
+                (*occupied)[index] = true;
+                elements_[bucket->offset + index] = *iterator;
+            } else if (!(elements_[bucket->offset + index] == *iterator)) { // collision detected
                 ok_function = false;
                 break;
-            } else {
-                occupied_elements[result] = true;
-                elements_[result] = *iterator;
             }
         }
     }
-}
 
-bool FixedSet::Bucket::Contains(int element) const {
-    if (elements_.empty()) {
-        return false;
+    for (uint32_t index = 0; index != bucket->size; ++index) {
+        if (!(*occupied)[index]) {
+            elements_[bucket->offset + index] = *begin;
+        }
     }
-    int index = GetIndex(element);
-    return (elements_[index] == element);
 }
 
-int FixedSet::Bucket::GetIndex(int element) const {
-    return function_(element) % elements_.size();
+template<typename TKey, typename THash, typename TRange>
+void FixedSet<TKey, THash, TRange>::Init(const std::vector<TKey>& elements, unsigned threads_count) {
+    size_t size = elements.size();
+    threads_count = size < PARALLEL_THRESHOLD ? 1 : CountThreads(threads_count);
+    if (size > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("Too many elements for FixedSet\n");
+    }
+    mapping_.reset();
+    buckets_.assign(size, BucketHeader());
+    elements_.clear();
+    BindOwnTables();
+    if (size == 0) {
+        return;
+    }
+
+    std::vector<uint32_t> indices(size);
+    std::vector<uint32_t> counts(size);
+    std::vector<size_t> starts(size + 1, 0);
+    std::vector<size_t> positions(size);
+    std::vector<TKey> grouped(size);
+
+    std::minstd_rand0 generator(seed_);
+    uint64_t table_size = 0;
+    do {
+        function_ = THash::Generate(&generator);
+        ParallelFor(size, PARALLEL_CHUNK_SIZE, threads_count, [&] (size_t begin, size_t end) {
+            for (size_t element_index = begin; element_index != end; ++element_index) {
+                indices[element_index] = GetIndex(elements[element_index]);
+            }
+        });
+        counts.assign(size, 0);
+        for (uint32_t index : indices) {
+            ++counts[index];
+        }
+
+        // counting sort of elements by buckets
+        for (size_t bucket_index = 0; bucket_index != size; ++bucket_index) {
+            starts[bucket_index + 1] = starts[bucket_index] + counts[bucket_index];
+        }
+        std::copy(starts.begin(), starts.end() - 1, positions.begin());
+        for (size_t element_index = 0; element_index != size; ++element_index) {
+            grouped[positions[indices[element_index]]++] = elements[element_index];
+        }
+        // copies of a key fall into one bucket and are left once there, otherwise
+        // a key repeated many times would exceed the bound with any function
+        ParallelFor(size, PARALLEL_CHUNK_SIZE, threads_count, [&] (size_t begin, size_t end) {
+            for (size_t bucket_index = begin; bucket_index != end; ++bucket_index) {
+                if (counts[bucket_index] > 1) {
+                    auto bucket_begin = grouped.begin() + starts[bucket_index];
+                    auto bucket_end = bucket_begin + counts[bucket_index];
+                    std::sort(bucket_begin, bucket_end);
+                    counts[bucket_index] = static_cast<uint32_t>(std::unique(bucket_begin, bucket_end) - bucket_begin);
+                }
+            }
+        });
+
+        table_size = 0;
+        for (uint32_t count : counts) {
+            table_size += static_cast<uint64_t>(count) * count;
+        }
+    } while (table_size > static_cast<uint64_t>(MAX_TABLE_FACTOR) * size);
+
+    if (table_size > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("Too many elements for FixedSet\n");
+    }
+
+    uint32_t offset = 0;
+    for (size_t bucket_index = 0; bucket_index != size; ++bucket_index) {
+        buckets_[bucket_index].offset = offset;
+        buckets_[bucket_index].size = counts[bucket_index] * counts[bucket_index];
+        offset += buckets_[bucket_index].size;
+    }
+
+    elements_.assign(table_size, TKey());
+    BindOwnTables();
+    // buckets own disjoint ranges of 'elements_' and have their own generators
+    ParallelFor(size, PARALLEL_CHUNK_SIZE, threads_count, [&] (size_t begin, size_t end) {
+        std::vector<bool> occupied;
+        for (size_t bucket_index = begin; bucket_index != end; ++bucket_index) {
+            if (counts[bucket_index] != 0) {
+                std::minstd_rand0 bucket_generator(CountBucketSeed(bucket_index));
+                InitBucket(grouped.begin() + starts[bucket_index],
+                           grouped.begin() + starts[bucket_index] + counts[bucket_index],
+                           &buckets_[bucket_index],
+                           &bucket_generator,
+                           &occupied);
+            }
+        }
+    });
 }
 
-void FixedSet::Init(const std::vector<int>& elements) {
-    int size = elements.size();
-    std::vector<std::vector <int> > collisions(size);
-    buckets_.resize(size);
+template<typename TKey, typename THash, typename TRange>
+bool FixedSet<TKey, THash, TRange>::Contains(const TKey &element) const {
+    size_t slot;
+    return FindSlot(element, &slot);
+}
 
-    function_ = GenerateUniversalHashFunctor(PRIME_NUMBER);
+template<typename TKey, typename THash, typename TRange>
+bool FixedSet<TKey, THash, TRange>::FindSlot(const TKey &element, size_t *slot) const {
+    if (buckets_count_ == 0) {
+        return false;
+    }
+    const BucketHeader &bucket = buckets_data_[GetIndex(element)];
+    if (bucket.size == 0) {
+        return false;
+    }
+    *slot = bucket.offset + GetIndex(bucket, element);
+    return elements_data_[*slot] == element;
+}
 
-    for (auto iterator = elements.begin(); iterator != elements.end(); ++iterator) {
-        int element = AdjustElement(*iterator);
-        int index = GetIndex(element);
-        collisions[index].push_back(element);
+template<typename TKey, typename THash, typename TRange>
+void FixedSet<TKey, THash, TRange>::ContainsBatch(const TKey *keys, size_t count, uint8_t *out) const {
+    if (buckets_count_ == 0) {
+        std::fill(out, out + count, 0);
+        return;
     }
 
-    for (int bucket_index = 0; bucket_index != size; ++bucket_index) {
-        buckets_[bucket_index].Init(collisions[bucket_index]);
+    const BucketHeader *buckets[BATCH_GROUP_SIZE];
+    const TKey *slots[BATCH_GROUP_SIZE];
+    for (size_t group_begin = 0; group_begin < count; group_begin += BATCH_GROUP_SIZE) {
+        size_t group_size = count - group_begin;
+        if (group_size > BATCH_GROUP_SIZE) {
+            group_size = BATCH_GROUP_SIZE;
+        }
+        const TKey *group_keys = keys + group_begin;
+
+        for (size_t index = 0; index != group_size; ++index) {
+            buckets[index] = &buckets_data_[GetIndex(group_keys[index])];
+            Prefetch(buckets[index]);
+        }
+        for (size_t index = 0; index != group_size; ++index) {
+            const BucketHeader &bucket = *buckets[index];
+            if (bucket.size == 0) {
+                slots[index] = nullptr;
+            } else {
+                slots[index] = &elements_data_[bucket.offset + GetIndex(bucket, group_keys[index])];
+                Prefetch(slots[index]);
+            }
+        }
+        for (size_t index = 0; index != group_size; ++index) {
+            out[group_begin + index] = (slots[index] != nullptr && *slots[index] == group_keys[index]);
+        }
     }
 }
 
-int FixedSet::AdjustElement(int element) {
-    return element + adjust;
+template<typename TKey, typename THash, typename TRange>
+size_t FixedSet<TKey, THash, TRange>::GetMemoryUsage() const {
+    return sizeof(*this) +
+           buckets_count_ * sizeof(BucketHeader) +
+           elements_count_ * sizeof(TKey);
 }
 
-bool FixedSet::Contains(int element) const {
-    element = AdjustElement(element);
-    int index = GetIndex(element);
-    return buckets_[index].Contains(element);
+template<typename TKey, typename THash, typename TRange>
+typename FixedSet<TKey, THash, TRange>::FileHeader FixedSet<TKey, THash, TRange>::MakeFileHeader() const {
+    FileHeader header;
+    // padding bytes are cleared as well, so equal sets produce equal files
+    std::memset(static_cast<void *>(&header), 0, sizeof(header));
+    std::memcpy(header.magic, "FIXEDSET", sizeof(header.magic));
+    header.version = FILE_VERSION;
+    header.byte_order = FILE_BYTE_ORDER;
+    header.key_size = sizeof(TKey);
+    header.key_signed = std::is_signed<TKey>::value ? 1 : 0;
+    header.hash_tag = THash::FILE_TAG;
+    header.range_tag = TRange::FILE_TAG;
+    header.bucket_header_size = sizeof(BucketHeader);
+    return header;
 }
 
-int FixedSet::GetIndex(int element) const {
-    return function_(element) % buckets_.size();
+template<typename TKey, typename THash, typename TRange>
+void FixedSet<TKey, THash, TRange>::SaveToFile(const std::string &path) const {
+    static_assert(std::is_trivially_copyable<TKey>::value &&
+                      std::is_trivially_copyable<THash>::value,
+                  "Only sets of trivially copyable keys and hash functions can be saved");
+
+    FileHeader header = MakeFileHeader();
+    header.buckets_count = buckets_count_;
+    header.elements_count = elements_count_;
+    header.buckets_offset = AlignFileOffset(sizeof(FileHeader));
+    header.elements_offset = AlignFileOffset(header.buckets_offset +
+                                             buckets_count_ * sizeof(BucketHeader));
+    header.function = function_;
+
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    const std::vector<char> padding(FILE_ALIGNMENT, 0);
+    uint64_t position = 0;
+    // writes 'size' bytes of 'data' at 'offset', filling the gap before it with zeros
+    auto write_at = [&] (uint64_t offset, const void *data, uint64_t size) {
+        file.write(padding.data(), offset - position);
+        file.write(static_cast<const char *>(data), size);
+        position = offset + size;
+    };
+    write_at(0, &header, sizeof(header));
+    write_at(header.buckets_offset, buckets_data_, buckets_count_ * sizeof(BucketHeader));
+    write_at(header.elements_offset, elements_data_, elements_count_ * sizeof(TKey));
+
+    file.close();
+    if (!file) {
+        throw std::runtime_error("Cannot write FixedSet to file " + path + "\n");
+    }
+}
+
+template<typename TKey, typename THash, typename TRange>
+void FixedSet<TKey, THash, TRange>::MapFile(const std::string &path) {
+    static_assert(std::is_trivially_copyable<TKey>::value &&
+                      std::is_trivially_copyable<THash>::value,
+                  "Only sets of trivially copyable keys and hash functions can be mapped");
+
+    std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>(path);
+    if (mapping->GetSize() < sizeof(FileHeader)) {
+        throw std::runtime_error("File " + path + " is too short for FixedSet\n");
+    }
+    FileHeader header;
+    std::memcpy(static_cast<void *>(&header), mapping->GetData(), sizeof(header));
+
+    FileHeader expected = MakeFileHeader();
+    if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+            header.version != expected.version ||
+            header.byte_order != expected.byte_order ||
+            header.key_size != expected.key_size ||
+            header.key_signed != expected.key_signed ||
+            header.hash_tag != expected.hash_tag ||
+            header.range_tag != expected.range_tag ||
+            header.bucket_header_size != expected.bucket_header_size) {
+        throw std::runtime_error("File " + path + " is not a FixedSet of this type and version\n");
+    }
+    uint64_t file_size = mapping->GetSize();
+    if (header.buckets_count > std::numeric_limits<uint32_t>::max() ||
+            header.buckets_offset % FILE_ALIGNMENT != 0 ||
+            header.elements_offset % FILE_ALIGNMENT != 0 ||
+            header.buckets_offset > file_size ||
+            header.elements_offset > file_size ||
+            header.buckets_count > (file_size - header.buckets_offset) / sizeof(BucketHeader) ||
+            header.elements_count > (file_size - header.elements_offset) / sizeof(TKey)) {
+        throw std::runtime_error("File " + path + " has broken FixedSet tables\n");
+    }
+
+    buckets_.clear();
+    buckets_.shrink_to_fit();
+    elements_.clear();
+    elements_.shrink_to_fit();
+    function_ = header.function;
+    buckets_data_ = reinterpret_cast<const BucketHeader *>(mapping->GetData() + header.buckets_offset);
+    buckets_count_ = static_cast<uint32_t>(header.buckets_count);
+    elements_data_ = reinterpret_cast<const TKey *>(mapping->GetData() + header.elements_offset);
+    elements_count_ = header.elements_count;
+    mapping_ = mapping;
 }
 
 } // namespace algorithms
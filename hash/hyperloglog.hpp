@@ -0,0 +1,299 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "hash/hash_set.hpp"
+
+namespace algorithms {
+
+// HyperLogLog estimate of the number of distinct keys in a stream, with a relative
+// standard error of about 1.04 / sqrt(2^precision). A key is hashed to 64 bits, the first
+// 'precision' bits choose a register, which keeps the maximum rank (position of the first
+// set bit) of the remaining bits. The estimate is the improved estimator of Ertl,
+// which has no bias over the whole range and needs no empirical correction tables.
+//
+// A sketch of few keys is sparse: it keeps a sorted list of (index, rank) pairs with
+// SPARSE_PRECISION bits of index, counted by linear counting, and becomes dense once the
+// list outgrows the registers. Sketches with equal precisions and seeds draw equal hash
+// functions, so sketches filled by different threads can be merged into one.
+// A sketch itself is not thread-safe.
+// THash is a hash family as in FixedSet; a 64-bit hash is made of two members of it
+// and mixed
+template<typename TKey,
+         typename THash = typename TraitsHashFamily<TKey>::Type>
+class HyperLogLog {
+    public:
+        // Throws std::invalid_argument unless precision is in [MIN_PRECISION, MAX_PRECISION]
+        explicit HyperLogLog(int precision = 14, unsigned seed = 237);
+
+        void Add(const TKey &key);
+        // Number of distinct keys added to this sketch and to the merged ones
+        double Estimate() const;
+        // Makes the sketch count keys of 'other' too.
+        // Throws std::invalid_argument if precisions or seeds differ
+        void Merge(const HyperLogLog &other);
+
+        bool IsSparse() const { return registers_.empty(); }
+        // Bytes occupied by the sketch, including its registers or list
+        size_t GetMemoryUsage() const;
+
+        static const int MIN_PRECISION = 4;
+        static const int MAX_PRECISION = 18;
+
+    private:
+        static const int SPARSE_PRECISION = 25;
+        // An entry of the sparse list is index << RANK_BITS | rank
+        static const int RANK_BITS = 6;
+
+        // Universal families such as multiply-shift are linear in the key, and ranks of
+        // regular keys like an arithmetic progression would be far from random;
+        // the bijective mix keeps the collision probability of the family
+        uint64_t GetHash(const TKey &key) const {
+            return MixBits((static_cast<uint64_t>(high_function_(key)) << 32) | low_function_(key));
+        }
+        // Rank of the bits of 'hash' after the first 'index_bits' ones
+        static uint8_t GetRank(uint64_t hash, int index_bits);
+        static uint32_t MakeSparseEntry(uint64_t hash);
+        // Register and rank of the dense sketch which 'entry' stands for
+        void DecodeSparseEntry(uint32_t entry, size_t *index, uint8_t *rank) const;
+
+        void UpdateRegister(size_t index, uint8_t rank) {
+            if (registers_[index] < rank) {
+                registers_[index] = rank;
+            }
+        }
+        // Merges the unsorted buffer into the sorted list, turning the sketch dense
+        // if the list grows too long
+        void FlushBuffer();
+        void AddSparseEntry(uint32_t entry);
+        void MakeDense();
+
+        double EstimateSparse() const;
+        double EstimateDense() const;
+
+        int precision_;
+        unsigned seed_;
+        THash low_function_;
+        THash high_function_;
+        // 2^precision registers, empty while the sketch is sparse
+        std::vector<uint8_t> registers_;
+        // Sorted entries with distinct indices, at most one per index
+        std::vector<uint32_t> sparse_;
+        // Entries added since the last flush
+        std::vector<uint32_t> buffer_;
+};
+
+template<typename TKey, typename THash>
+HyperLogLog<TKey, THash>::HyperLogLog(int precision, unsigned seed) :
+    precision_(precision),
+    seed_(seed) {
+    if (precision < MIN_PRECISION || precision > MAX_PRECISION) {
+        throw std::invalid_argument("Precision of HyperLogLog is out of range\n");
+    }
+    std::minstd_rand0 generator(seed);
+    low_function_ = THash::Generate(&generator);
+    high_function_ = THash::Generate(&generator);
+}
+
+template<typename TKey, typename THash>
+uint8_t HyperLogLog<TKey, THash>::GetRank(uint64_t hash, int index_bits) {
+    uint64_t rest = hash << index_bits;
+    if (rest == 0) {
+        return static_cast<uint8_t>(64 - index_bits + 1);
+    }
+    return static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+}
+
+template<typename TKey, typename THash>
+uint32_t HyperLogLog<TKey, THash>::MakeSparseEntry(uint64_t hash) {
+    uint32_t index = static_cast<uint32_t>(hash >> (64 - SPARSE_PRECISION));
+    return (index << RANK_BITS) | GetRank(hash, SPARSE_PRECISION);
+}
+
+template<typename TKey, typename THash>
+void HyperLogLog<TKey, THash>::DecodeSparseEntry(uint32_t entry, size_t *index, uint8_t *rank) const {
+    uint32_t sparse_index = entry >> RANK_BITS;
+    int extra_bits = SPARSE_PRECISION - precision_;
+    *index = sparse_index >> extra_bits;
+    // the extra index bits are the first bits counted by the dense rank
+    uint32_t extra = sparse_index & ((1u << extra_bits) - 1);
+    if (extra != 0) {
+        *rank = static_cast<uint8_t>(__builtin_clz(extra) - (32 - extra_bits) + 1);
+    } else {
+        *rank = static_cast<uint8_t>(extra_bits + (entry & ((1u << RANK_BITS) - 1)));
+    }
+}
+
+template<typename TKey, typename THash>
+void HyperLogLog<TKey, THash>::Add(const TKey &key) {
+    uint64_t hash = GetHash(key);
+    if (IsSparse()) {
+        AddSparseEntry(MakeSparseEntry(hash));
+    } else {
+        UpdateRegister(hash >> (64 - precision_), GetRank(hash, precision_));
+    }
+}
+
+template<typename TKey, typename THash>
+void HyperLogLog<TKey, THash>::AddSparseEntry(uint32_t entry) {
+    buffer_.push_back(entry);
+    // the buffer takes at most an eighth of the memory of the registers
+    if (buffer_.size() * sizeof(uint32_t) * 8 >= (static_cast<size_t>(1) << precision_)) {
+        FlushBuffer();
+    }
+}
+
+template<typename TKey, typename THash>
+void HyperLogLog<TKey, THash>::FlushBuffer() {
+    if (buffer_.empty()) {
+        return;
+    }
+    std::sort(buffer_.begin(), buffer_.end());
+    std::vector<uint32_t> merged;
+    merged.reserve(sparse_.size() + buffer_.size());
+    std::merge(sparse_.begin(), sparse_.end(), buffer_.begin(), buffer_.end(), std::back_inserter(merged));
+    buffer_.clear();
+
+    // entries with equal indices are adjacent and ordered by rank, the last one is kept
+    sparse_.clear();
+    for (size_t position = 0; position != merged.size(); ++position) {
+        if (position + 1 == merged.size() ||
+            (merged[position] >> RANK_BITS) != (merged[position + 1] >> RANK_BITS)) {
+            sparse_.push_back(merged[position]);
+        }
+    }
+    if (sparse_.size() * sizeof(uint32_t) > (static_cast<size_t>(1) << precision_)) {
+        MakeDense();
+    }
+}
+
+template<typename TKey, typename THash>
+void HyperLogLog<TKey, THash>::MakeDense() {
+    registers_.assign(static_cast<size_t>(1) << precision_, 0);
+    size_t index;
+    uint8_t rank;
+    for (uint32_t entry : sparse_) {
+        DecodeSparseEntry(entry, &index, &rank);
+        UpdateRegister(index, rank);
+    }
+    for (uint32_t entry : buffer_) {
+        DecodeSparseEntry(entry, &index, &rank);
+        UpdateRegister(index, rank);
+    }
+    std::vector<uint32_t>().swap(sparse_);
+    std::vector<uint32_t>().swap(buffer_);
+}
+
+template<typename TKey, typename THash>
+void HyperLogLog<TKey, THash>::Merge(const HyperLogLog &other) {
+    if (other.precision_ != precision_ || other.seed_ != seed_) {
+        throw std::invalid_argument("Merged HyperLogLog sketches have different parameters\n");
+    }
+    if (&other == this) {
+        return;
+    }
+    if (other.IsSparse()) {
+        for (const std::vector<uint32_t> *entries : {&other.sparse_, &other.buffer_}) {
+            for (uint32_t entry : *entries) {
+                if (IsSparse()) {
+                    AddSparseEntry(entry);
+                } else {
+                    size_t index;
+                    uint8_t rank;
+                    DecodeSparseEntry(entry, &index, &rank);
+                    UpdateRegister(index, rank);
+                }
+            }
+        }
+        return;
+    }
+    if (IsSparse()) {
+        MakeDense();
+    }
+    for (size_t index = 0; index != registers_.size(); ++index) {
+        UpdateRegister(index, other.registers_[index]);
+    }
+}
+
+template<typename TKey, typename THash>
+double HyperLogLog<TKey, THash>::Estimate() const {
+    return IsSparse() ? EstimateSparse() : EstimateDense();
+}
+
+template<typename TKey, typename THash>
+double HyperLogLog<TKey, THash>::EstimateSparse() const {
+    // linear counting over 2^SPARSE_PRECISION registers, of which entries fill some
+    std::vector<uint32_t> indices;
+    indices.reserve(sparse_.size() + buffer_.size());
+    for (const std::vector<uint32_t> *entries : {&sparse_, &buffer_}) {
+        for (uint32_t entry : *entries) {
+            indices.push_back(entry >> RANK_BITS);
+        }
+    }
+    std::sort(indices.begin(), indices.end());
+    double filled_count = static_cast<double>(std::unique(indices.begin(), indices.end()) - indices.begin());
+    double registers_count = static_cast<double>(1u << SPARSE_PRECISION);
+    return registers_count * std::log(registers_count / (registers_count - filled_count));
+}
+
+template<typename TKey, typename THash>
+double HyperLogLog<TKey, THash>::EstimateDense() const {
+    // Ertl, "New cardinality estimation algorithms for HyperLogLog sketches", 2017
+    int max_rank = 64 - precision_;
+    std::vector<double> rank_counts(max_rank + 2, 0.0);
+    for (uint8_t rank : registers_) {
+        rank_counts[rank] += 1.0;
+    }
+    double registers_count = static_cast<double>(registers_.size());
+
+    // tau and sigma correct for registers which are full and empty
+    double full_part = 1.0 - rank_counts[max_rank + 1] / registers_count;
+    double tau = 0.0;
+    if (full_part > 0.0 && full_part < 1.0) {
+        double power = 1.0;
+        double previous;
+        tau = 1.0 - full_part;
+        do {
+            full_part = std::sqrt(full_part);
+            previous = tau;
+            power *= 0.5;
+            tau -= (1.0 - full_part) * (1.0 - full_part) * power;
+        } while (tau != previous);
+        tau /= 3.0;
+    }
+    double empty_part = rank_counts[0] / registers_count;
+    if (empty_part == 1.0) {
+        return 0.0;
+    }
+    double sigma = empty_part;
+    double power = 1.0;
+    double previous;
+    do {
+        empty_part *= empty_part;
+        previous = sigma;
+        sigma += empty_part * power;
+        power += power;
+    } while (sigma != previous);
+
+    double sum = registers_count * tau;
+    for (int rank = max_rank; rank >= 1; --rank) {
+        sum = 0.5 * (sum + rank_counts[rank]);
+    }
+    sum += registers_count * sigma;
+    return registers_count * registers_count / (2.0 * std::log(2.0) * sum);
+}
+
+template<typename TKey, typename THash>
+size_t HyperLogLog<TKey, THash>::GetMemoryUsage() const {
+    return sizeof(*this) + registers_.capacity() +
+           (sparse_.capacity() + buffer_.capacity()) * sizeof(uint32_t);
+}
+
+} // namespace algorithms
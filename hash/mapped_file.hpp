@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace algorithms {
+
+// Read-only memory mapping of a whole file (POSIX).
+// Pages are shared with the page cache and with other processes mapping the same file
+class MappedFile {
+    public:
+        // Throws std::runtime_error if the file cannot be opened or mapped
+        explicit MappedFile(const std::string &path) :
+            data_(nullptr),
+            size_(0) {
+            int descriptor = open(path.c_str(), O_RDONLY);
+            if (descriptor < 0) {
+                throw std::runtime_error("Cannot open file " + path + "\n");
+            }
+            struct stat status;
+            if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+                close(descriptor);
+                throw std::runtime_error("Cannot map empty or unreadable file " + path + "\n");
+            }
+            size_ = static_cast<size_t>(status.st_size);
+            void *data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, descriptor, 0);
+            // the mapping stays valid after the descriptor is closed
+            close(descriptor);
+            if (data == MAP_FAILED) {
+                throw std::runtime_error("Cannot map file " + path + "\n");
+            }
+            data_ = static_cast<const char *>(data);
+        }
+
+        ~MappedFile() {
+            munmap(const_cast<char *>(data_), size_);
+        }
+
+        MappedFile(const MappedFile &other) = delete;
+        MappedFile &operator = (const MappedFile &other) = delete;
+
+        // Page-aligned start of the file content
+        const char *GetData() const { return data_; }
+        size_t GetSize() const { return size_; }
+
+    private:
+        const char *data_;
+        size_t size_;
+};
+
+} // namespace algorithms
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "hash/hash_set.hpp"
+#include "hash/parallel_for.hpp"
+
+namespace algorithms {
+
+// Minimal perfect hash function in the BBHash style: maps n distinct keys
+// to distinct indices in [0, n) using about 3.5 bits per key with the default gamma.
+// Keys are not stored, so the index of a key outside the set is arbitrary.
+//
+// Level i is a bit array of gamma * (number of keys left) bits. Every key left is hashed
+// into it; keys which got a bit alone set it, keys which collided pass to the next level.
+// The index of a key is the number of set bits before its bit in all levels, found
+// with a table of ranks. Keys left after MAX_LEVELS levels are kept in a small hash map.
+// TBaseHash maps keys to 64-bit values, keys with equal base hashes cannot be separated
+template<typename TKey, typename TBaseHash = std::hash<TKey> >
+class MinimalPerfectHash {
+    public:
+        // Larger gamma makes levels sparser: the build is faster
+        // and lookups visit fewer levels, at the cost of more bits per key
+        explicit MinimalPerfectHash(double gamma = 1.0, unsigned seed = 237);
+
+        // Builds the function using 'threads_count' threads, 0 means hardware concurrency.
+        // Throws std::invalid_argument if two keys have equal base hashes, e.g. are repeated
+        void Init(const std::vector<TKey> &keys, unsigned threads_count = 0);
+
+        // Index of 'key' in [0, GetSize()) if the key was given to Init
+        uint64_t GetIndex(const TKey &key) const;
+
+        size_t GetSize() const { return size_; }
+        // Bytes occupied by the function
+        size_t GetMemoryUsage() const;
+
+    private:
+        static const int MAX_LEVELS = 32;
+        // One rank is kept for each RANK_BLOCK_WORDS words of bits
+        static const size_t RANK_BLOCK_WORDS = 8;
+        // Smaller levels are built by one thread
+        static const size_t PARALLEL_THRESHOLD = 1 << 16;
+        static const size_t PARALLEL_CHUNK_SIZE = 1 << 14;
+
+        struct Level {
+            // Position of the first bit of the level in 'words_'
+            uint64_t offset;
+            uint64_t size;
+            uint64_t seed;
+        };
+
+        // Position of the bit of a key with base hash 'hash' inside 'level'
+        static uint64_t GetPosition(const Level &level, uint64_t hash) {
+            uint64_t mixed = MixBits(hash ^ level.seed);
+            return static_cast<uint64_t>((static_cast<unsigned __int128>(mixed) * level.size) >> 64);
+        }
+
+        // Number of set bits in 'words_' before 'position'
+        uint64_t GetRank(uint64_t position) const;
+
+        // Builds level over 'hashes', replacing them by hashes of the keys which collided
+        void InitLevel(std::vector<uint64_t> *hashes, unsigned threads_count);
+        void InitRanks();
+
+        double gamma_;
+        uint64_t seed_;
+        size_t size_;
+        std::vector<Level> levels_;
+        std::vector<uint64_t> words_;
+        std::vector<uint64_t> ranks_;
+        // Base hashes of keys which were left after all levels, with their indices
+        std::unordered_map<uint64_t, uint64_t> fallback_;
+};
+
+template<typename TKey, typename TBaseHash>
+MinimalPerfectHash<TKey, TBaseHash>::MinimalPerfectHash(double gamma, unsigned seed) :
+    gamma_(std::max(gamma, 0.5)),
+    seed_(seed),
+    size_(0) {}
+
+template<typename TKey, typename TBaseHash>
+void MinimalPerfectHash<TKey, TBaseHash>::Init(const std::vector<TKey> &keys, unsigned threads_count) {
+    threads_count = CountThreads(threads_count);
+    size_ = keys.size();
+    levels_.clear();
+    words_.clear();
+    ranks_.clear();
+    fallback_.clear();
+
+    std::vector<uint64_t> hashes(size_);
+    ParallelFor(size_, PARALLEL_CHUNK_SIZE, size_ < PARALLEL_THRESHOLD ? 1 : threads_count,
+                [&] (size_t begin, size_t end) {
+        TBaseHash base_hash;
+        for (size_t index = begin; index != end; ++index) {
+            hashes[index] = static_cast<uint64_t>(base_hash(keys[index]));
+        }
+    });
+
+    while (!hashes.empty() && levels_.size() < static_cast<size_t>(MAX_LEVELS)) {
+        InitLevel(&hashes, threads_count);
+    }
+    InitRanks();
+
+    uint64_t next_index = size_ - hashes.size();
+    for (uint64_t hash : hashes) {
+        if (!fallback_.insert(std::make_pair(hash, next_index++)).second) {
+            throw std::invalid_argument("Keys of MinimalPerfectHash have equal base hashes\n");
+        }
+    }
+}
+
+template<typename TKey, typename TBaseHash>
+void MinimalPerfectHash<TKey, TBaseHash>::InitLevel(std::vector<uint64_t> *hashes, unsigned threads_count) {
+    Level level;
+    level.offset = words_.size() * 64;
+    // levels are padded to whole words
+    level.size = (static_cast<uint64_t>(gamma_ * hashes->size()) + 64) / 64 * 64;
+    level.seed = MixBits(seed_ + levels_.size() * 0x9e3779b97f4a7c15ULL);
+    if (hashes->size() < PARALLEL_THRESHOLD) {
+        threads_count = 1;
+    }
+
+    size_t words_count = level.size / 64;
+    std::unique_ptr<std::atomic<uint64_t>[]> taken(new std::atomic<uint64_t>[words_count]);
+    std::unique_ptr<std::atomic<uint64_t>[]> collided(new std::atomic<uint64_t>[words_count]);
+    for (size_t index = 0; index != words_count; ++index) {
+        taken[index].store(0, std::memory_order_relaxed);
+        collided[index].store(0, std::memory_order_relaxed);
+    }
+
+    ParallelFor(hashes->size(), PARALLEL_CHUNK_SIZE, threads_count, [&] (size_t begin, size_t end) {
+        for (size_t index = begin; index != end; ++index) {
+            uint64_t position = GetPosition(level, (*hashes)[index]);
+            uint64_t bit = 1ULL << (position % 64);
+            if (taken[position / 64].fetch_or(bit, std::memory_order_relaxed) & bit) {
+                collided[position / 64].fetch_or(bit, std::memory_order_relaxed);
+            }
+        }
+    });
+    // the join of threads in ParallelFor orders all updates before the reads below
+
+    words_.resize(words_.size() + words_count);
+    uint64_t *level_words = &words_[level.offset / 64];
+    for (size_t index = 0; index != words_count; ++index) {
+        level_words[index] = taken[index].load(std::memory_order_relaxed) &
+                             ~collided[index].load(std::memory_order_relaxed);
+    }
+
+    // keys which collided are compacted in place, keeping their order
+    size_t left_count = 0;
+    for (uint64_t hash : *hashes) {
+        uint64_t position = GetPosition(level, hash);
+        if (collided[position / 64].load(std::memory_order_relaxed) & (1ULL << (position % 64))) {
+            (*hashes)[left_count++] = hash;
+        }
+    }
+    hashes->resize(left_count);
+    levels_.push_back(level);
+}
+
+template<typename TKey, typename TBaseHash>
+void MinimalPerfectHash<TKey, TBaseHash>::InitRanks() {
+    ranks_.assign(words_.size() / RANK_BLOCK_WORDS + 1, 0);
+    uint64_t rank = 0;
+    for (size_t index = 0; index != words_.size(); ++index) {
+        if (index % RANK_BLOCK_WORDS == 0) {
+            ranks_[index / RANK_BLOCK_WORDS] = rank;
+        }
+        rank += __builtin_popcountll(words_[index]);
+    }
+}
+
+template<typename TKey, typename TBaseHash>
+uint64_t MinimalPerfectHash<TKey, TBaseHash>::GetRank(uint64_t position) const {
+    size_t word_index = position / 64;
+    size_t block_begin = word_index / RANK_BLOCK_WORDS * RANK_BLOCK_WORDS;
+    uint64_t rank = ranks_[word_index / RANK_BLOCK_WORDS];
+    for (size_t index = block_begin; index != word_index; ++index) {
+        rank += __builtin_popcountll(words_[index]);
+    }
+    uint64_t lower_bits = (1ULL << (position % 64)) - 1;
+    return rank + __builtin_popcountll(words_[word_index] & lower_bits);
+}
+
+template<typename TKey, typename TBaseHash>
+uint64_t MinimalPerfectHash<TKey, TBaseHash>::GetIndex(const TKey &key) const {
+    uint64_t hash = static_cast<uint64_t>(TBaseHash()(key));
+    for (const Level &level : levels_) {
+        uint64_t position = level.offset + GetPosition(level, hash);
+        if (words_[position / 64] & (1ULL << (position % 64))) {
+            return GetRank(position);
+        }
+    }
+    auto found = fallback_.find(hash);
+    return found != fallback_.end() ? found->second : 0;
+}
+
+template<typename TKey, typename TBaseHash>
+size_t MinimalPerfectHash<TKey, TBaseHash>::GetMemoryUsage() const {
+    // a node of the fallback map holds the pair and a pointer, the table holds a pointer
+    return sizeof(*this) +
+           levels_.capacity() * sizeof(Level) +
+           words_.capacity() * sizeof(uint64_t) +
+           ranks_.capacity() * sizeof(uint64_t) +
+           fallback_.size() * (sizeof(std::pair<uint64_t, uint64_t>) + sizeof(void *)) +
+           fallback_.bucket_count() * sizeof(void *);
+}
+
+} // namespace algorithms
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace algorithms {
+
+// Number of threads to use when 'threads_count' threads are requested, 0 means hardware concurrency
+inline unsigned CountThreads(unsigned threads_count) {
+    if (threads_count == 0) {
+        threads_count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    return threads_count;
+}
+
+// Calls function(begin, end) for consecutive chunks of [0, count) of 'chunk_size' indices
+// on 'threads_count' threads, including the calling one. Chunks are handed out dynamically,
+// so chunks of different cost are balanced between threads
+template<typename TFunction>
+void ParallelFor(size_t count, size_t chunk_size, unsigned threads_count, TFunction function) {
+    if (threads_count <= 1 || count <= chunk_size) {
+        function(0, count);
+        return;
+    }
+    std::atomic<size_t> next_chunk(0);
+    auto worker = [&] () {
+        size_t begin;
+        while ((begin = next_chunk.fetch_add(chunk_size)) < count) {
+            function(begin, std::min(begin + chunk_size, count));
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned thread_index = 1; thread_index < threads_count; ++thread_index) {
+        threads.push_back(std::thread(worker));
+    }
+    worker();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+} // namespace algorithms
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "heap/node_pool.hpp"
+
+namespace algorithms {
+
+// Treap with implicit keys: an element is addressed by its position in the sequence.
+// Works as a rope: insertion and removal at a position, Split, Concatenate
+// and reversal of a range take O(log n) expected time.
+// Treaps produced by Split share one node pool, so they can be concatenated back in O(log n)
+template<typename TValue, typename TPriority = int>
+class ImplicitTreap {
+private:
+    struct TreapNode;
+
+    typedef TreapNode *TreapNodePointer;
+
+    struct TreapNode {
+        TreapNode(const TValue &value, TPriority priority) :
+            left_(nullptr),
+            right_(nullptr),
+            value_(value),
+            priority_(priority),
+            size_(1),
+            reversed_(false) {}
+
+        TreapNodePointer left_;
+        TreapNodePointer right_;
+        TValue value_;
+        TPriority priority_;
+        // Number of nodes in the subtree
+        size_t size_;
+        // Children of every node in the subtree have to be swapped, not yet applied
+        bool reversed_;
+    };
+
+    typedef NodePool<TreapNode> Pool;
+
+    static size_t GetSize(TreapNodePointer node) {
+        return node ? node->size_ : 0;
+    }
+    static void Update(TreapNodePointer node) {
+        node->size_ = GetSize(node->left_) + GetSize(node->right_) + 1;
+    }
+    static void Push(TreapNodePointer node);
+
+    // Left part gets first 'position' elements of the subtree
+    static void Split(TreapNodePointer node,
+                      size_t position,
+                      TreapNodePointer &result_left,
+                      TreapNodePointer &result_right);
+    static TreapNodePointer Merge(TreapNodePointer left, TreapNodePointer right);
+
+    void Clear();
+    // Creates the pool of a moved-from treap
+    Pool *GetPool() {
+        if (!pool_) {
+            pool_ = std::make_shared<Pool>();
+        }
+        return pool_.get();
+    }
+
+    TPriority CountRandomPriority() const;
+
+    std::shared_ptr<Pool> pool_;
+    TreapNodePointer root_;
+public:
+    ImplicitTreap() :
+        pool_(std::make_shared<Pool>()),
+        root_(nullptr) {}
+
+    ~ImplicitTreap() {
+        Clear();
+    }
+
+    ImplicitTreap(const ImplicitTreap &other) = delete;
+    ImplicitTreap &operator = (const ImplicitTreap &other) = delete;
+
+    // The pool is moved as well, so that the treap stays its only user.
+    // A moved-from treap is empty and gets a new pool when it is filled again
+    ImplicitTreap(ImplicitTreap &&other) :
+        pool_(std::move(other.pool_)),
+        root_(other.root_) {
+        other.root_ = nullptr;
+    }
+
+    ImplicitTreap &operator = (ImplicitTreap &&other) {
+        if (&other != this) {
+            Clear();
+            pool_ = std::move(other.pool_);
+            root_ = other.root_;
+            other.root_ = nullptr;
+        }
+        return *this;
+    }
+
+    size_t GetSize() const { return GetSize(root_); }
+
+    const TValue &At(size_t position) const;
+
+    void InsertAt(size_t position, const TValue &value);
+    void PushBack(const TValue &value) { InsertAt(GetSize(), value); }
+    void EraseAt(size_t position);
+
+    // Keeps first 'position' elements in this treap, moves the rest to 'right'
+    // replacing its previous content
+    void Split(size_t position, ImplicitTreap *right);
+    // Appends all elements of 'other' to the end of this treap, leaving 'other' empty.
+    // O(log n) if both treaps share the node pool or 'other' is the only user of its pool,
+    // otherwise elements of 'other' are copied
+    void Concatenate(ImplicitTreap &&other);
+    // Reverses elements in range [begin, end)
+    void Reverse(size_t begin, size_t end);
+
+    std::vector<TValue> OutputInorder() const;
+};
+
+template<typename TValue, typename TPriority>
+void ImplicitTreap<TValue, TPriority>::Push(TreapNodePointer node) {
+    if (node != nullptr && node->reversed_) {
+        std::swap(node->left_, node->right_);
+        if (node->left_) {
+            node->left_->reversed_ = !node->left_->reversed_;
+        }
+        if (node->right_) {
+            node->right_->reversed_ = !node->right_->reversed_;
+        }
+        node->reversed_ = false;
+    }
+}
+
+template<typename TValue, typename TPriority>
+void ImplicitTreap<TValue, TPriority>::Split(TreapNodePointer node,
+                                             size_t position,
+                                             TreapNodePointer &result_left,
+                                             TreapNodePointer &result_right) {
+    if (node == nullptr) {
+        result_left = nullptr;
+        result_right = nullptr;
+        return;
+    }
+    Push(node);
+    size_t left_size = GetSize(node->left_);
+    if (left_size < position) {
+        Split(node->right_, position - left_size - 1, node->right_, result_right);
+        Update(node);
+        result_left = node;
+    } else {
+        Split(node->left_, position, result_left, node->left_);
+        Update(node);
+        result_right = node;
+    }
+}
+
+template<typename TValue, typename TPriority>
+typename ImplicitTreap<TValue, TPriority>::TreapNodePointer ImplicitTreap<TValue, TPriority>::Merge
+        (TreapNodePointer left, TreapNodePointer right) {
+    if (left == nullptr) {
+        return right;
+
+    } else if (right == nullptr) {
+        return left;
+
+    } else if (left->priority_ < right->priority_) {
+        Push(right);
+        right->left_ = Merge(left, right->left_);
+        Update(right);
+        return right;
+
+    } else {
+        Push(left);
+        left->right_ = Merge(left->right_, right);
+        Update(left);
+        return left;
+
+    }
+}
+
+template<typename TValue, typename TPriority>
+const TValue &ImplicitTreap<TValue, TPriority>::At(size_t position) const {
+    if (position >= GetSize()) {
+        throw std::out_of_range("Position is out of implicit treap range\n");
+    }
+    // Pending reversals are accounted for without pushing them down
+    TreapNodePointer node = root_;
+    bool reversed = false;
+    while (true) {
+        reversed = (reversed != node->reversed_);
+        TreapNodePointer left = reversed ? node->right_ : node->left_;
+        TreapNodePointer right = reversed ? node->left_ : node->right_;
+
+        size_t left_size = GetSize(left);
+        if (position < left_size) {
+            node = left;
+        } else if (position == left_size) {
+            return node->value_;
+        } else {
+            position -= left_size + 1;
+            node = right;
+        }
+    }
+}
+
+template<typename TValue, typename TPriority>
+void ImplicitTreap<TValue, TPriority>::InsertAt(size_t position, const TValue &value) {
+    if (position > GetSize()) {
+        throw std::out_of_range("Position is out of implicit treap range\n");
+    }
+    TreapNodePointer new_node = GetPool()->Allocate(value, CountRandomPriority());
+
+    TreapNodePointer left, right;
+    Split(root_, position, left, right);
+    root_ = Merge(Merge(left, new_node), right);
+}
+
+template<typename TValue, typename TPriority>
+void ImplicitTreap<TValue, TPriority>::EraseAt(size_t position) {
+    if (position >= GetSize()) {
+        throw std::out_of_range("Position is out of implicit treap range\n");
+    }
+    TreapNodePointer left, middle, right;
+    Split(root_, position, left, right);
+    Split(right, 1, middle, right);
+    pool_->Free(middle);
+    root_ = Merge(left, right);
+}
+
+template<typename TValue, typename TPriority>
+void ImplicitTreap<TValue, TPriority>::Split(size_t position, ImplicitTreap *right) {
+    right->Clear();
+    right->pool_ = pool_;
+    Split(root_, position, root_, right->root_);
+}
+
+template<typename TValue, typename TPriority>
+void ImplicitTreap<TValue, TPriority>::Concatenate(ImplicitTreap &&other) {
+    if (&other == this) {
+        return;
+    }
+    if (other.root_ == nullptr) {
+        return;
+    }
+    if (other.pool_ != pool_) {
+        if (other.pool_.use_count() == 1) {
+            GetPool()->Splice(other.pool_.get());
+        } else {
+            std::vector<TValue> values = other.OutputInorder();
+            other.Clear();
+            for (const TValue &value : values) {
+                root_ = Merge(root_, GetPool()->Allocate(value, CountRandomPriority()));
+            }
+            return;
+        }
+    }
+    root_ = Merge(root_, other.root_);
+    other.root_ = nullptr;
+}
+
+template<typename TValue, typename TPriority>
+void ImplicitTreap<TValue, TPriority>::Reverse(size_t begin, size_t end) {
+    if (begin >= end) {
+        return;
+    }
+    if (end > GetSize()) {
+        throw std::out_of_range("Range is out of implicit treap range\n");
+    }
+    TreapNodePointer left, middle, right;
+    Split(root_, begin, left, right);
+    Split(right, end - begin, middle, right);
+    middle->reversed_ = !middle->reversed_;
+    root_ = Merge(Merge(left, middle), right);
+}
+
+template<typename TValue, typename TPriority>
+std::vector<TValue> ImplicitTreap<TValue, TPriority>::OutputInorder() const {
+    std::vector<TValue> output;
+    output.reserve(GetSize());
+
+    // Node together with the parity of reversals applied to it
+    std::vector<std::pair<TreapNodePointer, bool> > stack;
+    TreapNodePointer node = root_;
+    bool reversed = false;
+    while (node != nullptr || !stack.empty()) {
+        while (node != nullptr) {
+            reversed = (reversed != node->reversed_);
+            stack.push_back(std::make_pair(node, reversed));
+            node = reversed ? node->right_ : node->left_;
+        }
+        node = stack.back().first;
+        reversed = stack.back().second;
+        stack.pop_back();
+
+        output.push_back(node->value_);
+        node = reversed ? node->left_ : node->right_;
+    }
+    return output;
+}
+
+template<typename TValue, typename TPriority>
+void ImplicitTreap<TValue, TPriority>::Clear() {
+    if (root_ == nullptr) {
+        return;
+    }
+    std::vector<TreapNodePointer> stack(1, root_);
+    while (!stack.empty()) {
+        TreapNodePointer node = stack.back();
+        stack.pop_back();
+        if (node->left_) {
+            stack.push_back(node->left_);
+        }
+        if (node->right_) {
+            stack.push_back(node->right_);
+        }
+        pool_->Free(node);
+    }
+    root_ = nullptr;
+}
+
+template<typename TValue, typename TPriority>
+TPriority ImplicitTreap<TValue, TPriority>::CountRandomPriority() const {
+    unsigned seed = 237;
+    static std::minstd_rand0 generator (seed);
+
+    TPriority max_priority = std::numeric_limits<TPriority>::max();
+    return std::uniform_int_distribution<TPriority>(0, max_priority) (generator);
+}
+
+} // namespace algorithms
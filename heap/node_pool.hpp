@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace algorithms {
+
+// Allocates objects of type TNode from contiguous blocks
+// and recycles freed slots through an intrusive free list.
+// Memory goes back to the system only when the pool is destroyed;
+// objects still alive at that moment are not destroyed,
+// so owners of non-trivially destructible nodes have to Free them first.
+template<typename TNode>
+class NodePool {
+public:
+    NodePool() :
+        free_head_(nullptr),
+        free_tail_(nullptr),
+        next_block_size_(MIN_BLOCK_SIZE),
+        allocated_count_(0),
+        capacity_(0) {}
+
+    NodePool(const NodePool &other) = delete;
+    NodePool &operator = (const NodePool &other) = delete;
+
+    NodePool(NodePool &&other) :
+        NodePool() {
+        Splice(&other);
+    }
+
+    NodePool &operator = (NodePool &&other) {
+        if (&other != this) {
+            blocks_.clear();
+            free_head_ = nullptr;
+            free_tail_ = nullptr;
+            next_block_size_ = MIN_BLOCK_SIZE;
+            allocated_count_ = 0;
+            capacity_ = 0;
+            Splice(&other);
+        }
+        return *this;
+    }
+
+    // Destruction of the pool returns the memory of all its objects
+    static const bool RELEASES_MEMORY = true;
+
+    template<typename... TArgs>
+    TNode *Allocate(TArgs&&... args) {
+        if (free_head_ == nullptr) {
+            AddBlock();
+        }
+        Slot *slot = free_head_;
+        free_head_ = slot->next_free_;
+        if (free_head_ == nullptr) {
+            free_tail_ = nullptr;
+        }
+        ++allocated_count_;
+        return new (&slot->storage_) TNode(std::forward<TArgs>(args)...);
+    }
+
+    void Free(TNode *node) {
+        node->~TNode();
+        Slot *slot = reinterpret_cast<Slot *>(node);
+        slot->next_free_ = free_head_;
+        free_head_ = slot;
+        if (free_tail_ == nullptr) {
+            free_tail_ = slot;
+        }
+        --allocated_count_;
+    }
+
+    // Takes over all blocks and free slots of 'other', leaving it empty. O(1)
+    void Splice(NodePool *other) {
+        if (other == this) {
+            return;
+        }
+        blocks_.splice(blocks_.end(), other->blocks_);
+        if (other->free_head_ != nullptr) {
+            other->free_tail_->next_free_ = free_head_;
+            if (free_head_ == nullptr) {
+                free_tail_ = other->free_tail_;
+            }
+            free_head_ = other->free_head_;
+        }
+        allocated_count_ += other->allocated_count_;
+        capacity_ += other->capacity_;
+        if (next_block_size_ < other->next_block_size_) {
+            next_block_size_ = other->next_block_size_;
+        }
+
+        other->free_head_ = nullptr;
+        other->free_tail_ = nullptr;
+        other->next_block_size_ = MIN_BLOCK_SIZE;
+        other->allocated_count_ = 0;
+        other->capacity_ = 0;
+    }
+
+    // Number of live objects
+    size_t GetAllocatedCount() const { return allocated_count_; }
+    // Number of slots obtained from the system
+    size_t GetCapacity() const { return capacity_; }
+
+private:
+    static const size_t MIN_BLOCK_SIZE = 64;
+    static const size_t MAX_BLOCK_SIZE = 1 << 16;
+
+    union Slot {
+        Slot *next_free_;
+        typename std::aligned_storage<sizeof(TNode), alignof(TNode)>::type storage_;
+    };
+
+    // Allocates a new block and threads its slots into the free list in address order
+    void AddBlock() {
+        size_t block_size = next_block_size_;
+        std::unique_ptr<Slot[]> block(new Slot[block_size]);
+
+        for (size_t index = 0; index + 1 < block_size; ++index) {
+            block[index].next_free_ = &block[index + 1];
+        }
+        block[block_size - 1].next_free_ = nullptr;
+
+        free_head_ = &block[0];
+        free_tail_ = &block[block_size - 1];
+        blocks_.push_back(std::move(block));
+
+        capacity_ += block_size;
+        if (next_block_size_ < MAX_BLOCK_SIZE) {
+            next_block_size_ <<= 1;
+        }
+    }
+
+    std::list<std::unique_ptr<Slot[]> > blocks_;
+    Slot *free_head_;
+    Slot *free_tail_;
+    size_t next_block_size_;
+    size_t allocated_count_;
+    size_t capacity_;
+};
+
+// NodePool with several owners: copies of an allocator take objects from the same pool,
+// which lives while any of them does, so containers split from one container can
+// keep their nodes where they are. Splice merges the pool of the other allocator
+// into this one; the other owners of that pool are forwarded to the merged pool
+template<typename TNode>
+class SharedNodePool {
+public:
+    SharedNodePool() :
+        shared_(std::make_shared<Shared>()) {}
+
+    SharedNodePool(const SharedNodePool &other) :
+        shared_(other.GetShared()) {}
+
+    SharedNodePool &operator = (const SharedNodePool &other) {
+        shared_ = other.GetShared();
+        return *this;
+    }
+
+    // Other owners may keep using the pool, so objects have to be freed one by one
+    static const bool RELEASES_MEMORY = false;
+
+    template<typename... TArgs>
+    TNode *Allocate(TArgs&&... args) {
+        return GetShared()->pool_.Allocate(std::forward<TArgs>(args)...);
+    }
+
+    void Free(TNode *node) {
+        GetShared()->pool_.Free(node);
+    }
+
+    // Merges the pools in O(1) unless they are the same one
+    void Splice(SharedNodePool *other) {
+        const std::shared_ptr<Shared> &shared = GetShared();
+        const std::shared_ptr<Shared> &other_shared = other->GetShared();
+        if (shared == other_shared) {
+            return;
+        }
+        shared->pool_.Splice(&other_shared->pool_);
+        other_shared->merged_to_ = shared;
+        other->shared_ = shared;
+    }
+
+    bool SharesPool(const SharedNodePool &other) const {
+        return GetShared() == other.GetShared();
+    }
+
+    // Number of live objects of all owners
+    size_t GetAllocatedCount() const { return GetShared()->pool_.GetAllocatedCount(); }
+    size_t GetCapacity() const { return GetShared()->pool_.GetCapacity(); }
+
+private:
+    struct Shared {
+        NodePool<TNode> pool_;
+        // Pool which took over the blocks of this one, it is kept alive by the forwarding
+        std::shared_ptr<Shared> merged_to_;
+    };
+
+    // Follows forwarding of merged pools, shortening the way for the next call
+    const std::shared_ptr<Shared> &GetShared() const {
+        while (shared_->merged_to_) {
+            shared_ = shared_->merged_to_;
+        }
+        return shared_;
+    }
+
+    mutable std::shared_ptr<Shared> shared_;
+};
+
+// Allocator with the interface of NodePool which takes every object
+// from operator new; objects are not tied to the allocator, so it has no state
+template<typename TNode>
+class NewDeleteAllocator {
+public:
+    static const bool RELEASES_MEMORY = false;
+
+    template<typename... TArgs>
+    TNode *Allocate(TArgs&&... args) {
+        return new TNode(std::forward<TArgs>(args)...);
+    }
+
+    void Free(TNode *node) {
+        delete node;
+    }
+
+    void Splice(NewDeleteAllocator *) {}
+};
+
+} // namespace algorithms
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <vector>
+#include <assert.h>
+#include <functional>
+#include <utility>
+
+#include "heap/node_pool.hpp"
+
+namespace algorithms {
+
+// Mergeable heap: O(1) Insert and Meld, amortized O(log n) Pop, DecreaseKey and Remove.
+// As in BinaryHeap, the top is the greatest element according to TComparator.
+template <typename TElement,
+          typename TComparator = std::less<TElement> >
+class PairingHeap {
+private:
+    struct Node {
+        Node(const TElement &element) :
+            element_(element),
+            child_(nullptr),
+            sibling_(nullptr),
+            prev_(nullptr) {}
+
+        TElement element_;
+        Node *child_;
+        Node *sibling_;
+        // Parent for the first child, left sibling otherwise
+        Node *prev_;
+    };
+
+public:
+    typedef TElement TElementType;
+    // Stays valid until the element is popped or removed, also after Meld
+    typedef Node *Handle;
+
+    PairingHeap() :
+        root_(nullptr),
+        size_(0) {}
+
+    ~PairingHeap() {
+        Clear();
+    }
+
+    PairingHeap(const PairingHeap &other) = delete;
+    PairingHeap &operator = (const PairingHeap &other) = delete;
+
+    PairingHeap(PairingHeap &&other) :
+        PairingHeap() {
+        Meld(std::move(other));
+    }
+
+    const TElement &GetTop() const {
+        return root_->element_;
+    }
+
+    static const TElement &GetElement(Handle handle) {
+        return handle->element_;
+    }
+
+    Handle Insert(const TElement &element) {
+        Node *node = pool_.Allocate(element);
+        root_ = Link(root_, node);
+        ++size_;
+        return node;
+    }
+
+    // Removes element on the top of the heap
+    void Pop() {
+        Node *old_root = root_;
+        root_ = CombineChildren(old_root);
+        pool_.Free(old_root);
+        --size_;
+    }
+
+    // Moves all elements of 'other' into this heap, leaving 'other' empty.
+    // Handles of 'other' stay valid and now refer to this heap
+    void Meld(PairingHeap &&other) {
+        if (&other == this) {
+            return;
+        }
+        pool_.Splice(&other.pool_);
+        root_ = Link(root_, other.root_);
+        size_ += other.size_;
+
+        other.root_ = nullptr;
+        other.size_ = 0;
+    }
+
+    // Replaces the element with 'element' which must not be less than the old one
+    // according to TComparator, i.e. the element can only move towards the top.
+    // With std::greater it is the classic decrease-key of a min-heap
+    void DecreaseKey(Handle handle, const TElement &element) {
+        assert(!CompareElements(element, handle->element_));
+        handle->element_ = element;
+        if (handle != root_) {
+            Cut(handle);
+            root_ = Link(root_, handle);
+        }
+    }
+
+    // Removes element which is located by handle, keeping all heap properties
+    void Remove(Handle handle) {
+        if (handle == root_) {
+            Pop();
+            return;
+        }
+        Cut(handle);
+        root_ = Link(root_, CombineChildren(handle));
+        pool_.Free(handle);
+        --size_;
+    }
+
+    void Clear() {
+        if (root_ == nullptr) {
+            return;
+        }
+        std::vector<Node *> stack(1, root_);
+        while (!stack.empty()) {
+            Node *node = stack.back();
+            stack.pop_back();
+            if (node->child_) {
+                stack.push_back(node->child_);
+            }
+            if (node->sibling_) {
+                stack.push_back(node->sibling_);
+            }
+            pool_.Free(node);
+        }
+        root_ = nullptr;
+        size_ = 0;
+    }
+
+    // Number of elements kept in the heap
+    size_t GetSize() const { return size_; }
+
+private:
+    bool CompareElements(const TElement &one, const TElement &other) const {
+        return TComparator() (one, other);
+    }
+
+    // Makes the lower of two roots the first child of the other one, returns the new root
+    Node *Link(Node *first, Node *second) {
+        if (first == nullptr) {
+            return second;
+        } else if (second == nullptr) {
+            return first;
+        }
+        if (CompareElements(first->element_, second->element_)) {
+            std::swap(first, second);
+        }
+        second->sibling_ = first->child_;
+        if (second->sibling_) {
+            second->sibling_->prev_ = second;
+        }
+        second->prev_ = first;
+        first->child_ = second;
+        first->sibling_ = nullptr;
+        first->prev_ = nullptr;
+        return first;
+    }
+
+    // Detaches subtree rooted at 'node' from its parent and siblings
+    void Cut(Node *node) {
+        if (node->prev_->child_ == node) {
+            node->prev_->child_ = node->sibling_;
+        } else {
+            node->prev_->sibling_ = node->sibling_;
+        }
+        if (node->sibling_) {
+            node->sibling_->prev_ = node->prev_;
+        }
+        node->sibling_ = nullptr;
+        node->prev_ = nullptr;
+    }
+
+    // Two-pass pairing of the children of 'node', returns root of the combined heap
+    Node *CombineChildren(Node *node) {
+        Node *current = node->child_;
+        node->child_ = nullptr;
+
+        pairs_.clear();
+        while (current) {
+            Node *first = current;
+            Node *second = current->sibling_;
+            current = second ? second->sibling_ : nullptr;
+
+            first->sibling_ = nullptr;
+            if (second) {
+                second->sibling_ = nullptr;
+            }
+            pairs_.push_back(Link(first, second));
+        }
+
+        Node *result = nullptr;
+        while (!pairs_.empty()) {
+            result = Link(pairs_.back(), result);
+            pairs_.pop_back();
+        }
+        return result;
+    }
+
+    NodePool<Node> pool_;
+    Node *root_;
+    size_t size_;
+    // Scratch buffer reused by CombineChildren to avoid allocations on Pop
+    std::vector<Node *> pairs_;
+};
+
+} // namespace algorithms
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace algorithms {
+
+// Persistent treap: a value of this class is an immutable version of the set.
+// Insert and Erase copy only the nodes on the search path and return a new version,
+// sharing all other nodes with the old one, so an update costs O(log n) new nodes.
+// Nodes are never modified after construction and are owned through
+// reference-counted pointers, so a version can be read from any thread while
+// new versions are being built; versions are handed over with AtomicLoad / AtomicStore.
+// Updates themselves are meant to be performed by a single writer.
+template<typename TKey, typename TPriority = int>
+class PersistentTreap {
+private:
+    struct TreapNode;
+
+    typedef std::shared_ptr<const TreapNode> TreapNodePointer;
+
+    struct TreapNode {
+        TreapNode(const TKey &key,
+                  TPriority priority,
+                  const TreapNodePointer &left,
+                  const TreapNodePointer &right) :
+            left_(left),
+            right_(right),
+            key_(key),
+            priority_(priority),
+            size_(GetSize(left) + GetSize(right) + 1) {}
+
+        const TreapNodePointer left_;
+        const TreapNodePointer right_;
+        const TKey key_;
+        const TPriority priority_;
+        // Number of nodes in the subtree
+        const size_t size_;
+    };
+
+    explicit PersistentTreap(const TreapNodePointer &root) :
+        root_(root) {}
+
+    static size_t GetSize(const TreapNodePointer &node) {
+        return node ? node->size_ : 0;
+    }
+    static TreapNodePointer MakeNode(const TreapNode &pattern,
+                                     const TreapNodePointer &left,
+                                     const TreapNodePointer &right) {
+        return std::make_shared<const TreapNode>(pattern.key_, pattern.priority_, left, right);
+    }
+
+    static void Split(const TreapNodePointer &node,
+                      const TKey &key,
+                      TreapNodePointer *result_left,
+                      TreapNodePointer *result_right);
+    static TreapNodePointer Merge(const TreapNodePointer &left, const TreapNodePointer &right);
+
+    static TreapNodePointer Insert(const TreapNodePointer &node,
+                                   const TKey &key,
+                                   TPriority priority);
+    static TreapNodePointer Erase(const TreapNodePointer &node, const TKey &key);
+    const TreapNode *FindThisOrNext(const TKey &key) const;
+
+    static TPriority CountRandomPriority();
+
+    void CheckStructure(const TreapNode *node) const;
+
+    TreapNodePointer root_;
+public:
+    PersistentTreap() {}
+
+    // Return the new version; if the key is already present (for Insert)
+    // or absent (for Erase) the same version is returned
+    PersistentTreap Insert(const TKey &key) const;
+    PersistentTreap Erase(const TKey &key) const;
+
+    bool Find(const TKey &key) const;
+    bool FindThisOrNext(const TKey &key, TKey *result) const;
+    size_t GetSize() const { return GetSize(root_); }
+
+    // Thread-safe replacement of a version shared between threads
+    PersistentTreap AtomicLoad() const;
+    void AtomicStore(const PersistentTreap &version);
+
+    // Number of nodes used by all given versions together
+    static size_t CountDistinctNodes(const std::vector<PersistentTreap> &versions);
+
+    // Throws std::exception if some property of binary search tree
+    // or of the heap of priorities is unsatisfied
+    void CheckStructure() const;
+};
+
+template<typename TKey, typename TPriority>
+void PersistentTreap<TKey, TPriority>::Split(const TreapNodePointer &node,
+                                             const TKey &key,
+                                             TreapNodePointer *result_left,
+                                             TreapNodePointer *result_right) {
+    if (node == nullptr) {
+        *result_left = nullptr;
+        *result_right = nullptr;
+    } else if (node->key_ < key) {
+        TreapNodePointer right_left;
+        Split(node->right_, key, &right_left, result_right);
+        *result_left = MakeNode(*node, node->left_, right_left);
+    } else {
+        TreapNodePointer left_right;
+        Split(node->left_, key, result_left, &left_right);
+        *result_right = MakeNode(*node, left_right, node->right_);
+    }
+}
+
+// All keys of 'left' have to be less than keys of 'right'
+template<typename TKey, typename TPriority>
+typename PersistentTreap<TKey, TPriority>::TreapNodePointer PersistentTreap<TKey, TPriority>::Merge
+        (const TreapNodePointer &left, const TreapNodePointer &right) {
+    if (left == nullptr) {
+        return right;
+    } else if (right == nullptr) {
+        return left;
+    } else if (left->priority_ < right->priority_) {
+        return MakeNode(*right, Merge(left, right->left_), right->right_);
+    } else {
+        return MakeNode(*left, left->left_, Merge(left->right_, right));
+    }
+}
+
+template<typename TKey, typename TPriority>
+PersistentTreap<TKey, TPriority> PersistentTreap<TKey, TPriority>::Insert(const TKey &key) const {
+    if (Find(key)) {
+        return *this;
+    }
+    return PersistentTreap(Insert(root_, key, CountRandomPriority()));
+}
+
+template<typename TKey, typename TPriority>
+typename PersistentTreap<TKey, TPriority>::TreapNodePointer PersistentTreap<TKey, TPriority>::Insert
+        (const TreapNodePointer &node, const TKey &key, TPriority priority) {
+    if (node == nullptr) {
+        return std::make_shared<const TreapNode>(key, priority, nullptr, nullptr);
+
+    } else if (node->priority_ < priority) {
+        TreapNodePointer left, right;
+        Split(node, key, &left, &right);
+        return std::make_shared<const TreapNode>(key, priority, left, right);
+
+    } else if (node->key_ < key) {
+        return MakeNode(*node, node->left_, Insert(node->right_, key, priority));
+
+    } else {
+        return MakeNode(*node, Insert(node->left_, key, priority), node->right_);
+    }
+}
+
+template<typename TKey, typename TPriority>
+PersistentTreap<TKey, TPriority> PersistentTreap<TKey, TPriority>::Erase(const TKey &key) const {
+    if (!Find(key)) {
+        return *this;
+    }
+    return PersistentTreap(Erase(root_, key));
+}
+
+template<typename TKey, typename TPriority>
+typename PersistentTreap<TKey, TPriority>::TreapNodePointer PersistentTreap<TKey, TPriority>::Erase
+        (const TreapNodePointer &node, const TKey &key) {
+    if (node->key_ == key) {
+        return Merge(node->left_, node->right_);
+    } else if (node->key_ < key) {
+        return MakeNode(*node, node->left_, Erase(node->right_, key));
+    } else {
+        return MakeNode(*node, Erase(node->left_, key), node->right_);
+    }
+}
+
+template<typename TKey, typename TPriority>
+bool PersistentTreap<TKey, TPriority>::Find(const TKey &key) const {
+    const TreapNode *found = FindThisOrNext(key);
+    return (found != nullptr && found->key_ == key);
+}
+
+template<typename TKey, typename TPriority>
+bool PersistentTreap<TKey, TPriority>::FindThisOrNext(const TKey &key, TKey *result) const {
+    const TreapNode *found = FindThisOrNext(key);
+    if (found == nullptr) {
+        return false;
+    } else {
+        *result = found->key_;
+        return true;
+    }
+}
+
+template<typename TKey, typename TPriority>
+const typename PersistentTreap<TKey, TPriority>::TreapNode *
+PersistentTreap<TKey, TPriority>::FindThisOrNext(const TKey &key) const {
+    const TreapNode *result = nullptr;
+    const TreapNode *node = root_.get();
+    while (node != nullptr) {
+        if (node->key_ == key) {
+            return node;
+        } else if (node->key_ < key) {
+            node = node->right_.get();
+        } else {
+            result = node;
+            node = node->left_.get();
+        }
+    }
+    return result;
+}
+
+template<typename TKey, typename TPriority>
+PersistentTreap<TKey, TPriority> PersistentTreap<TKey, TPriority>::AtomicLoad() const {
+    return PersistentTreap(std::atomic_load(&root_));
+}
+
+template<typename TKey, typename TPriority>
+void PersistentTreap<TKey, TPriority>::AtomicStore(const PersistentTreap &version) {
+    std::atomic_store(&root_, version.root_);
+}
+
+template<typename TKey, typename TPriority>
+size_t PersistentTreap<TKey, TPriority>::CountDistinctNodes
+        (const std::vector<PersistentTreap> &versions) {
+    std::unordered_set<const TreapNode *> visited;
+    std::vector<const TreapNode *> stack;
+    for (const PersistentTreap &version : versions) {
+        if (version.root_) {
+            stack.push_back(version.root_.get());
+        }
+        while (!stack.empty()) {
+            const TreapNode *node = stack.back();
+            stack.pop_back();
+            // a visited node means the whole subtree is shared with a previous version
+            if (!visited.insert(node).second) {
+                continue;
+            }
+            if (node->left_) {
+                stack.push_back(node->left_.get());
+            }
+            if (node->right_) {
+                stack.push_back(node->right_.get());
+            }
+        }
+    }
+    return visited.size();
+}
+
+template<typename TKey, typename TPriority>
+TPriority PersistentTreap<TKey, TPriority>::CountRandomPriority() {
+    unsigned seed = 237;
+    static std::minstd_rand0 generator (seed);
+
+    TPriority max_priority = std::numeric_limits<TPriority>::max();
+    return std::uniform_int_distribution<TPriority>(0, max_priority) (generator);
+}
+
+template<typename TKey, typename TPriority>
+void PersistentTreap<TKey, TPriority>::CheckStructure() const {
+    CheckStructure(root_.get());
+}
+
+template<typename TKey, typename TPriority>
+void PersistentTreap<TKey, TPriority>::CheckStructure(const TreapNode *node) const {
+    if (node == nullptr) {
+        return;
+    }
+    CheckStructure(node->left_.get());
+    CheckStructure(node->right_.get());
+
+    if (node->left_ && node->left_->key_ >= node->key_) {
+        std::string description = std::string("Key of left ") +
+                                  std::to_string(node->left_->key_) +
+                                  std::string(" is >= than key of root ") +
+                                  std::to_string(node->key_) +
+                                  std::string("\n");
+        throw std::runtime_error(description);
+    }
+    if (node->right_ && node->right_->key_ < node->key_) {
+        std::string description = std::string("Key of right ") +
+                                  std::to_string(node->right_->key_) +
+                                  std::string(" is < than key of root ") +
+                                  std::to_string(node->key_) +
+                                  std::string("\n");
+        throw std::runtime_error(description);
+    }
+    if ((node->left_ && node->left_->priority_ > node->priority_) ||
+            (node->right_ && node->right_->priority_ > node->priority_)) {
+        std::string description = std::string("Priority of child of ") +
+                                  std::to_string(node->key_) +
+                                  std::string(" is > than priority of root\n");
+        throw std::runtime_error(description);
+    }
+}
+
+} // namespace algorithms
@@ -1,7 +1,14 @@
+#include <cstddef>
 #include <functional>
-#include <memory>
+#include <future>
+#include <limits>
 #include <random>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "heap/node_pool.hpp"
 
 namespace algorithms {
 
@@ -10,39 +17,134 @@ class Treap {
 private:
     struct TreapNode;
 
-    typedef std::shared_ptr<TreapNode> TreapNodePointer;
+    typedef TreapNode *TreapNodePointer;
 
     struct TreapNode {
+        TreapNode(const TKey &key, TPriority priority) :
+            left_(nullptr),
+            right_(nullptr),
+            key_(key),
+            priority_(priority),
+            size_(1) {}
+
         TreapNodePointer left_;
         TreapNodePointer right_;
         TKey key_;
         TPriority priority_;
+        // Number of nodes in the subtree
+        size_t size_;
     };
 
-    void Split(TreapNodePointer node,
-               const TKey &key,
-               TreapNodePointer *result_left,
-               TreapNodePointer *result_right);
-    TreapNodePointer Merge(TreapNodePointer left, TreapNodePointer right);
+    static size_t GetSize(TreapNodePointer node) {
+        return node ? node->size_ : 0;
+    }
+    static void Update(TreapNodePointer node) {
+        node->size_ = GetSize(node->left_) + GetSize(node->right_) + 1;
+    }
 
-    void Insert(TreapNodePointer *node, TreapNodePointer new_element);
-    TreapNodePointer Find(TreapNodePointer node, const TKey &key) const;
+    static void Split(TreapNodePointer node,
+                      const TKey &key,
+                      TreapNodePointer &result_left,
+                      TreapNodePointer &result_right);
+    static TreapNodePointer Merge(TreapNodePointer left, TreapNodePointer right);
+    // Like Split, but the node with key equal to 'key' goes to neither part and is returned
+    static TreapNodePointer SplitOut(TreapNodePointer node,
+                                     const TKey &key,
+                                     TreapNodePointer &result_left,
+                                     TreapNodePointer &result_right);
+
+    // Discarded subtrees are collected in 'garbage' instead of being freed,
+    // so that recursive calls can run in parallel.
+    // Fork into a new thread while 'spawn_depth' > 0 and the inputs are large enough
+    static TreapNodePointer Union(TreapNodePointer first,
+                                  TreapNodePointer second,
+                                  int spawn_depth,
+                                  std::vector<TreapNodePointer> *garbage);
+    static TreapNodePointer Intersection(TreapNodePointer first,
+                                         TreapNodePointer second,
+                                         int spawn_depth,
+                                         std::vector<TreapNodePointer> *garbage);
+    static TreapNodePointer Difference(TreapNodePointer first,
+                                       TreapNodePointer second,
+                                       int spawn_depth,
+                                       std::vector<TreapNodePointer> *garbage);
+
+    typedef TreapNodePointer (*SetOperation)(TreapNodePointer first,
+                                             TreapNodePointer second,
+                                             int spawn_depth,
+                                             std::vector<TreapNodePointer> *garbage);
+
+    // Applies 'operation' to the left and to the right pairs of subtrees
+    static void ForkJoin(SetOperation operation,
+                         TreapNodePointer first_left,
+                         TreapNodePointer second_left,
+                         TreapNodePointer first_right,
+                         TreapNodePointer second_right,
+                         int spawn_depth,
+                         std::vector<TreapNodePointer> *garbage,
+                         TreapNodePointer *result_left,
+                         TreapNodePointer *result_right);
+    static int CountSpawnDepth();
+
+    void Insert(TreapNodePointer &node, TreapNodePointer new_element);
     TreapNodePointer FindThisOrNext(TreapNodePointer node, const TKey &key) const;
-    void Erase(TreapNodePointer *node, const TKey &key);
+    bool Erase(TreapNodePointer &node, const TKey &key);
+
+    void FreeSubtree(TreapNodePointer node);
+    void FreeGarbage(const std::vector<TreapNodePointer> &garbage);
+    void Clear();
 
     TPriority CountRandomPriority() const;
 
+    NodePool<TreapNode> pool_;
     TreapNodePointer root_;
 public:
+    Treap() :
+        root_(nullptr) {}
+
+    ~Treap() {
+        Clear();
+    }
+
+    Treap(const Treap &other) = delete;
+    Treap &operator = (const Treap &other) = delete;
+
+    Treap(Treap &&other) :
+        pool_(std::move(other.pool_)),
+        root_(other.root_) {
+        other.root_ = nullptr;
+    }
+
     // return true if insertion is successful and there is no such element in the treap,
     // false otherwise
     bool Insert(const TKey &key);
     bool Erase(const TKey &key);
 
+    // Replaces content of the treap with keys from a sorted range in O(n),
+    // repeated keys are inserted once
+    template<typename TIterator>
+    void InitSorted(TIterator begin, TIterator end);
+
+    // Set operations take all nodes of 'other' leaving it empty, the result is kept in this treap.
+    // O(m log(n / m + 1)) for treaps of sizes m <= n, large inputs are processed in parallel
+    void Union(Treap &&other);
+    void Intersection(Treap &&other);
+    // Removes keys of 'other' from this treap
+    void Difference(Treap &&other);
+
     bool Find(const TKey &key) const;
     bool FindThisOrNext(const TKey &key, TKey *result) const;
 
-    // Throws std::exception if some property of binary search tree is unsatisfied
+    size_t GetSize() const { return GetSize(root_); }
+    // Finds the k-th smallest key (0-based), returns false if k >= GetSize()
+    bool KthElement(size_t k, TKey *result) const;
+    // Number of keys less than 'key'
+    size_t Rank(const TKey &key) const;
+    // Number of keys in range [begin, end)
+    size_t CountRange(const TKey &begin, const TKey &end) const;
+
+    // Throws std::exception if some property of binary search tree
+    // or of the heap of priorities is unsatisfied
     void CheckStructure() const;
     void CheckStructure(TreapNodePointer node) const;
 };
@@ -67,21 +169,263 @@ bool Treap<TKey, TPriority>::FindThisOrNext(const TKey &key, TKey *result) const
 template<typename TKey, typename TPriority>
 typename Treap<TKey, TPriority>::TreapNodePointer Treap<TKey, TPriority>::FindThisOrNext
         (TreapNodePointer node, const TKey &key) const {
-    if (node == nullptr) {
+    TreapNodePointer result = nullptr;
+    while (node != nullptr) {
+        if (node->key_ == key) {
+            return node;
+        } else if (node->key_ < key) {
+            node = node->right_;
+        } else {
+            result = node;
+            node = node->left_;
+        }
+    }
+    return result;
+}
+
+template<typename TKey, typename TPriority>
+template<typename TIterator>
+void Treap<TKey, TPriority>::InitSorted(TIterator begin, TIterator end) {
+    Clear();
+
+    // Right spine of the tree built so far, priorities decrease from bottom to top
+    std::vector<TreapNodePointer> spine;
+    for (TIterator iterator = begin; iterator != end; ++iterator) {
+        if (!spine.empty() && !(spine.back()->key_ < *iterator)) {
+            continue;
+        }
+        TreapNodePointer node = pool_.Allocate(*iterator, CountRandomPriority());
+
+        TreapNodePointer last_popped = nullptr;
+        while (!spine.empty() && spine.back()->priority_ < node->priority_) {
+            last_popped = spine.back();
+            Update(last_popped);
+            spine.pop_back();
+        }
+        node->left_ = last_popped;
+        if (!spine.empty()) {
+            spine.back()->right_ = node;
+        }
+        spine.push_back(node);
+    }
+
+    while (!spine.empty()) {
+        Update(spine.back());
+        root_ = spine.back();
+        spine.pop_back();
+    }
+}
+
+template<typename TKey, typename TPriority>
+void Treap<TKey, TPriority>::Union(Treap &&other) {
+    if (&other == this) {
+        return;
+    }
+    pool_.Splice(&other.pool_);
+    std::vector<TreapNodePointer> garbage;
+    root_ = Union(root_, other.root_, CountSpawnDepth(), &garbage);
+    other.root_ = nullptr;
+    FreeGarbage(garbage);
+}
+
+template<typename TKey, typename TPriority>
+void Treap<TKey, TPriority>::Intersection(Treap &&other) {
+    if (&other == this) {
+        return;
+    }
+    pool_.Splice(&other.pool_);
+    std::vector<TreapNodePointer> garbage;
+    root_ = Intersection(root_, other.root_, CountSpawnDepth(), &garbage);
+    other.root_ = nullptr;
+    FreeGarbage(garbage);
+}
+
+template<typename TKey, typename TPriority>
+void Treap<TKey, TPriority>::Difference(Treap &&other) {
+    if (&other == this) {
+        Clear();
+        return;
+    }
+    pool_.Splice(&other.pool_);
+    std::vector<TreapNodePointer> garbage;
+    root_ = Difference(root_, other.root_, CountSpawnDepth(), &garbage);
+    other.root_ = nullptr;
+    FreeGarbage(garbage);
+}
+
+template<typename TKey, typename TPriority>
+typename Treap<TKey, TPriority>::TreapNodePointer Treap<TKey, TPriority>::Union
+        (TreapNodePointer first,
+         TreapNodePointer second,
+         int spawn_depth,
+         std::vector<TreapNodePointer> *garbage) {
+    if (first == nullptr) {
+        return second;
+    } else if (second == nullptr) {
+        return first;
+    }
+    if (first->priority_ < second->priority_) {
+        std::swap(first, second);
+    }
+
+    TreapNodePointer second_left, second_right;
+    TreapNodePointer duplicate = SplitOut(second, first->key_, second_left, second_right);
+    if (duplicate != nullptr) {
+        garbage->push_back(duplicate);
+    }
+
+    ForkJoin(&Union, first->left_, second_left, first->right_, second_right,
+             spawn_depth, garbage, &first->left_, &first->right_);
+    Update(first);
+    return first;
+}
+
+template<typename TKey, typename TPriority>
+typename Treap<TKey, TPriority>::TreapNodePointer Treap<TKey, TPriority>::Intersection
+        (TreapNodePointer first,
+         TreapNodePointer second,
+         int spawn_depth,
+         std::vector<TreapNodePointer> *garbage) {
+    if (first == nullptr || second == nullptr) {
+        if (first != nullptr) {
+            garbage->push_back(first);
+        }
+        if (second != nullptr) {
+            garbage->push_back(second);
+        }
         return nullptr;
-    } else if (node->key_ == key) {
-        return node;
-    } else if (node->key_ < key) {
-        TreapNodePointer right_result = FindThisOrNext(node->right_, key);
-        return right_result;
+    }
+    if (first->priority_ < second->priority_) {
+        std::swap(first, second);
+    }
+
+    TreapNodePointer second_left, second_right;
+    TreapNodePointer duplicate = SplitOut(second, first->key_, second_left, second_right);
+
+    TreapNodePointer result_left, result_right;
+    ForkJoin(&Intersection, first->left_, second_left, first->right_, second_right,
+             spawn_depth, garbage, &result_left, &result_right);
+
+    if (duplicate != nullptr) {
+        garbage->push_back(duplicate);
+        first->left_ = result_left;
+        first->right_ = result_right;
+        Update(first);
+        return first;
     } else {
-        TreapNodePointer left_result = FindThisOrNext(node->left_, key);
-        if (left_result == nullptr) {
-            return node;
+        first->left_ = nullptr;
+        first->right_ = nullptr;
+        garbage->push_back(first);
+        return Merge(result_left, result_right);
+    }
+}
+
+template<typename TKey, typename TPriority>
+typename Treap<TKey, TPriority>::TreapNodePointer Treap<TKey, TPriority>::Difference
+        (TreapNodePointer first,
+         TreapNodePointer second,
+         int spawn_depth,
+         std::vector<TreapNodePointer> *garbage) {
+    if (first == nullptr || second == nullptr) {
+        if (second != nullptr) {
+            garbage->push_back(second);
+        }
+        return first;
+    }
+
+    TreapNodePointer first_left, first_right;
+    TreapNodePointer removed = SplitOut(first, second->key_, first_left, first_right);
+    if (removed != nullptr) {
+        garbage->push_back(removed);
+    }
+
+    TreapNodePointer result_left, result_right;
+    ForkJoin(&Difference, first_left, second->left_, first_right, second->right_,
+             spawn_depth, garbage, &result_left, &result_right);
+
+    second->left_ = nullptr;
+    second->right_ = nullptr;
+    garbage->push_back(second);
+    return Merge(result_left, result_right);
+}
+
+template<typename TKey, typename TPriority>
+void Treap<TKey, TPriority>::ForkJoin(SetOperation operation,
+                                      TreapNodePointer first_left,
+                                      TreapNodePointer second_left,
+                                      TreapNodePointer first_right,
+                                      TreapNodePointer second_right,
+                                      int spawn_depth,
+                                      std::vector<TreapNodePointer> *garbage,
+                                      TreapNodePointer *result_left,
+                                      TreapNodePointer *result_right) {
+    static const size_t PARALLEL_THRESHOLD = 1 << 14;
+
+    size_t left_size = GetSize(first_left) + GetSize(second_left);
+    size_t right_size = GetSize(first_right) + GetSize(second_right);
+    if (spawn_depth <= 0 || left_size < PARALLEL_THRESHOLD || right_size < PARALLEL_THRESHOLD) {
+        *result_left = operation(first_left, second_left, spawn_depth, garbage);
+        *result_right = operation(first_right, second_right, spawn_depth, garbage);
+        return;
+    }
+
+    std::vector<TreapNodePointer> left_garbage;
+    std::future<TreapNodePointer> left_result = std::async(std::launch::async,
+        operation, first_left, second_left, spawn_depth - 1, &left_garbage);
+    *result_right = operation(first_right, second_right, spawn_depth - 1, garbage);
+    *result_left = left_result.get();
+
+    garbage->insert(garbage->end(), left_garbage.begin(), left_garbage.end());
+}
+
+template<typename TKey, typename TPriority>
+int Treap<TKey, TPriority>::CountSpawnDepth() {
+    int depth = 0;
+    for (unsigned threads = std::thread::hardware_concurrency(); threads > 1; threads >>= 1) {
+        ++depth;
+    }
+    return depth;
+}
+
+template<typename TKey, typename TPriority>
+bool Treap<TKey, TPriority>::KthElement(size_t k, TKey *result) const {
+    TreapNodePointer node = root_;
+    while (node != nullptr) {
+        size_t left_size = GetSize(node->left_);
+        if (k < left_size) {
+            node = node->left_;
+        } else if (k == left_size) {
+            *result = node->key_;
+            return true;
         } else {
-            return left_result;
+            k -= left_size + 1;
+            node = node->right_;
         }
     }
+    return false;
+}
+
+template<typename TKey, typename TPriority>
+size_t Treap<TKey, TPriority>::Rank(const TKey &key) const {
+    size_t rank = 0;
+    TreapNodePointer node = root_;
+    while (node != nullptr) {
+        if (node->key_ < key) {
+            rank += GetSize(node->left_) + 1;
+            node = node->right_;
+        } else {
+            node = node->left_;
+        }
+    }
+    return rank;
+}
+
+template<typename TKey, typename TPriority>
+size_t Treap<TKey, TPriority>::CountRange(const TKey &begin, const TKey &end) const {
+    if (!(begin < end)) {
+        return 0;
+    }
+    return Rank(end) - Rank(begin);
 }
 
 template<typename TKey, typename TPriority>
@@ -90,48 +434,80 @@ bool Treap<TKey, TPriority>::Insert(const TKey &key) {
         return false;
     }
 
-    TPriority new_priority = CountRandomPriority();
-    TreapNode new_node = {nullptr, nullptr, key, new_priority};
-    TreapNodePointer new_node_pointer(new TreapNode(new_node));
-
-    Insert(&root_, new_node_pointer);
+    TreapNodePointer new_node = pool_.Allocate(key, CountRandomPriority());
+    Insert(root_, new_node);
     return true;
 }
 
 template<typename TKey, typename TPriority>
 void Treap<TKey, TPriority>::Split(TreapNodePointer node,
                                    const TKey &key,
-                                   TreapNodePointer *result_left,
-                                   TreapNodePointer *result_right) {
+                                   TreapNodePointer &result_left,
+                                   TreapNodePointer &result_right) {
     if (node == nullptr) {
-        *result_left = nullptr;
-        *result_right = nullptr;
+        result_left = nullptr;
+        result_right = nullptr;
     } else if (node->key_ < key) {
-
-        Split(node->right_, key, &node->right_, result_right);
-        *result_left = node;
+        Split(node->right_, key, node->right_, result_right);
+        Update(node);
+        result_left = node;
     } else {
+        Split(node->left_, key, result_left, node->left_);
+        Update(node);
+        result_right = node;
+    }
+}
 
-        Split(node->left_, key, result_left, &node->left_);
-        *result_right = node;
+template<typename TKey, typename TPriority>
+typename Treap<TKey, TPriority>::TreapNodePointer Treap<TKey, TPriority>::SplitOut
+        (TreapNodePointer node,
+         const TKey &key,
+         TreapNodePointer &result_left,
+         TreapNodePointer &result_right) {
+    if (node == nullptr) {
+        result_left = nullptr;
+        result_right = nullptr;
+        return nullptr;
+    } else if (node->key_ == key) {
+        result_left = node->left_;
+        result_right = node->right_;
+        node->left_ = nullptr;
+        node->right_ = nullptr;
+        Update(node);
+        return node;
+    }
+
+    TreapNodePointer found;
+    if (node->key_ < key) {
+        found = SplitOut(node->right_, key, node->right_, result_right);
+        Update(node);
+        result_left = node;
+    } else {
+        found = SplitOut(node->left_, key, result_left, node->left_);
+        Update(node);
+        result_right = node;
     }
+    return found;
 }
 
+// All keys of 'left' have to be less than keys of 'right'
 template<typename TKey, typename TPriority>
 typename Treap<TKey, TPriority>::TreapNodePointer Treap<TKey, TPriority>::Merge
         (TreapNodePointer left, TreapNodePointer right) {
-    if (left != nullptr && right == nullptr) {
-        return left;
-
-    } else if (left == nullptr) {
+    if (left == nullptr) {
         return right;
 
-    } else if (left->key_ < right->key_) {
+    } else if (right == nullptr) {
+        return left;
+
+    } else if (left->priority_ < right->priority_) {
         right->left_ = Merge(left, right->left_);
+        Update(right);
         return right;
 
     } else {
-        left->right_ = Merge(right, left->right_);
+        left->right_ = Merge(left->right_, right);
+        Update(left);
         return left;
 
     }
@@ -139,25 +515,56 @@ typename Treap<TKey, TPriority>::TreapNodePointer Treap<TKey, TPriority>::Merge
 
 template<typename TKey, typename TPriority>
 bool Treap<TKey, TPriority>::Erase(const TKey &key) {
-    TreapNodePointer node_to_erase = FindThisOrNext(root_, key);
+    return Erase(root_, key);
+}
 
-    if (node_to_erase == nullptr || node_to_erase->key_ != key) {
+template<typename TKey, typename TPriority>
+bool Treap<TKey, TPriority>::Erase(TreapNodePointer &node, const TKey &key) {
+    if (node == nullptr) {
         return false;
-    } else {
-        Erase(&root_, key);
+    } else if (node->key_ == key) {
+        TreapNodePointer node_to_erase = node;
+        node = Merge(node->left_, node->right_);
+        pool_.Free(node_to_erase);
         return true;
     }
+
+    bool erased = (node->key_ < key) ? Erase(node->right_, key) : Erase(node->left_, key);
+    if (erased) {
+        Update(node);
+    }
+    return erased;
 }
 
+template<typename TKey, typename TPriority>
+void Treap<TKey, TPriority>::Clear() {
+    FreeSubtree(root_);
+    root_ = nullptr;
+}
 
 template<typename TKey, typename TPriority>
-void Treap<TKey, TPriority>::Erase(TreapNodePointer *node, const TKey &key) {
-    if ((*node)->key_ == key) {
-        *node = Merge((*node)->left_, (*node)->right_);
-    } else if ((*node)->key_ < key) {
-        Erase(&(*node)->right_, key);
-    } else {
-        Erase(&(*node)->left_, key);
+void Treap<TKey, TPriority>::FreeGarbage(const std::vector<TreapNodePointer> &garbage) {
+    for (TreapNodePointer node : garbage) {
+        FreeSubtree(node);
+    }
+}
+
+template<typename TKey, typename TPriority>
+void Treap<TKey, TPriority>::FreeSubtree(TreapNodePointer node) {
+    if (node == nullptr) {
+        return;
+    }
+    std::vector<TreapNodePointer> stack(1, node);
+    while (!stack.empty()) {
+        TreapNodePointer current = stack.back();
+        stack.pop_back();
+        if (current->left_) {
+            stack.push_back(current->left_);
+        }
+        if (current->right_) {
+            stack.push_back(current->right_);
+        }
+        pool_.Free(current);
     }
 }
 
@@ -171,24 +578,26 @@ TPriority Treap<TKey, TPriority>::CountRandomPriority() const {
 }
 
 template<typename TKey, typename TPriority>
-void Treap<TKey, TPriority>::Insert(TreapNodePointer *node, TreapNodePointer new_element) {
-    if (*node == nullptr) {
-        *node = new_element;
+void Treap<TKey, TPriority>::Insert(TreapNodePointer &node, TreapNodePointer new_element) {
+    if (node == nullptr) {
+        node = new_element;
 
-    } else if ((*node)->key_ == new_element->key_) {
+    } else if (node->key_ == new_element->key_) {
         throw std::runtime_error("Duplicate key in treap\n");
 
-    } else if ((*node)->priority_ < new_element->priority_) {
-        Split(*node, new_element->key_, &new_element->left_, &new_element->right_);
-        *node = new_element;
+    } else if (node->priority_ < new_element->priority_) {
+        Split(node, new_element->key_, new_element->left_, new_element->right_);
+        Update(new_element);
+        node = new_element;
 
     } else {
-        if ((*node)->key_ < new_element->key_) {
-            Insert(&(*node)->right_, new_element);
+        if (node->key_ < new_element->key_) {
+            Insert(node->right_, new_element);
 
         } else {
-            Insert(&(*node)->left_, new_element);
+            Insert(node->left_, new_element);
         }
+        Update(node);
    }
 }
 
@@ -221,6 +630,19 @@ void Treap<TKey, TPriority>::CheckStructure(TreapNodePointer node) const {
                                       std::string("\n");
             throw std::runtime_error(description);
         }
+        if ((node->left_ && node->left_->priority_ > node->priority_) ||
+                (node->right_ && node->right_->priority_ > node->priority_)) {
+            std::string description = std::string("Priority of child of ") +
+                                      std::to_string(node->key_) +
+                                      std::string(" is > than priority of root\n");
+            throw std::runtime_error(description);
+        }
+        if (node->size_ != GetSize(node->left_) + GetSize(node->right_) + 1) {
+            std::string description = std::string("Size of subtree of ") +
+                                      std::to_string(node->key_) +
+                                      std::string(" is inconsistent\n");
+            throw std::runtime_error(description);
+        }
     }
 }
 
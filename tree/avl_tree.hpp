@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+
+#include "tree/binary_search_tree.hpp"
+
+namespace algorithms {
+
+// AVL tree: heights of the subtrees of every node differ by at most one,
+// so the height of a tree of n nodes is below 1.45 log(n + 2)
+// and sorted insertions do not degenerate it into a list
+template<typename Elem, template<typename> class TAllocator = NodePool, typename TAugmentation = NoAugmentation>
+class AvlTree : public BinarySearchTree<Elem, TAllocator, TAugmentation> {
+public:
+    typedef typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node Node;
+
+    using BinarySearchTree<Elem, TAllocator, TAugmentation>::Delete;
+
+    AvlTree() : BinarySearchTree<Elem, TAllocator, TAugmentation>() {}
+
+    virtual Node* Insert(const Elem& elem) {
+        auto found = this->FindElem(elem);
+        if (found.second) {
+            return found.first;
+        }
+        Node* parent = found.first;
+        Node* inserted = this->AddNode(elem);
+        if (!parent) {
+            this->root_ = inserted;
+        } else if (elem < parent->GetData()) {
+            parent->SetLeft(inserted);
+        } else {
+            parent->SetRight(inserted);
+        }
+        Rebalance(parent);
+        return inserted;
+    }
+
+    virtual void Delete(Node* to_delete) {
+        if (!to_delete) {
+            return;
+        }
+        // a node with two children gives its place to the predecessor, which has at most one
+        if (to_delete->GetLeft() && to_delete->GetRight()) {
+            Node* predecessor = this->GetPredecessor(to_delete);
+            to_delete->SwapData(predecessor);
+            to_delete = predecessor;
+        }
+        Node* child = to_delete->GetLeft() ? to_delete->GetLeft() : to_delete->GetRight();
+        Node* parent = to_delete->GetParent();
+        ReplaceChild(parent, to_delete, child);
+
+        to_delete->SetLeft(nullptr);
+        to_delete->SetRight(nullptr);
+        to_delete->SetParent(nullptr);
+        this->FreeNode(to_delete);
+
+        Rebalance(parent);
+    }
+
+    // Checks heights stored in nodes and the balance of every node
+    bool IsBalanced() const {
+        return IsBalanced(this->root_);
+    }
+
+private:
+    static int GetHeight(const Node* node) {
+        return node ? node->GetHeight() : 0;
+    }
+
+    static int GetBalance(const Node* node) {
+        return GetHeight(node->GetLeft()) - GetHeight(node->GetRight());
+    }
+
+    // Recomputes the height and the augmentation of 'node' from its children
+    static void Update(Node* node) {
+        node->SetHeight(std::max(GetHeight(node->GetLeft()), GetHeight(node->GetRight())) + 1);
+        node->UpdateAugmentation();
+    }
+
+    void ReplaceChild(Node* parent, Node* child, Node* replacement) {
+        if (!parent) {
+            this->root_ = replacement;
+            if (replacement) {
+                replacement->SetParent(nullptr);
+            }
+        } else if (parent->GetLeft() == child) {
+            parent->SetLeft(replacement);
+        } else {
+            parent->SetRight(replacement);
+        }
+    }
+
+    // Lifts the right child of 'node' to its place, returns the lifted child
+    Node* RotateLeft(Node* node) {
+        Node* pivot = node->GetRight();
+        ReplaceChild(node->GetParent(), node, pivot);
+        node->SetRight(pivot->GetLeft());
+        pivot->SetLeft(node);
+        Update(node);
+        Update(pivot);
+        return pivot;
+    }
+
+    Node* RotateRight(Node* node) {
+        Node* pivot = node->GetLeft();
+        ReplaceChild(node->GetParent(), node, pivot);
+        node->SetLeft(pivot->GetRight());
+        pivot->SetRight(node);
+        Update(node);
+        Update(pivot);
+        return pivot;
+    }
+
+    // Restores heights and balance on the path from 'node' to the root after a subtree
+    // of 'node' has grown or shrunk by one. Rotations stop as soon as a subtree keeps
+    // its height, only augmentations of the ancestors are updated then
+    void Rebalance(Node* node) {
+        while (node) {
+            int old_height = node->GetHeight();
+            int balance = GetBalance(node);
+            if (balance > 1) {
+                if (GetBalance(node->GetLeft()) < 0) {
+                    RotateLeft(node->GetLeft());
+                }
+                node = RotateRight(node);
+            } else if (balance < -1) {
+                if (GetBalance(node->GetRight()) > 0) {
+                    RotateRight(node->GetRight());
+                }
+                node = RotateLeft(node);
+            } else {
+                Update(node);
+                if (node->GetHeight() == old_height) {
+                    this->UpdatePath(node->GetParent());
+                    return;
+                }
+            }
+            node = node->GetParent();
+        }
+    }
+
+    bool IsBalanced(const Node* node) const {
+        if (!node) {
+            return true;
+        }
+        if (!IsBalanced(node->GetLeft()) || !IsBalanced(node->GetRight())) {
+            return false;
+        }
+        int balance = GetBalance(node);
+        return balance >= -1 && balance <= 1 &&
+               node->GetHeight() == std::max(GetHeight(node->GetLeft()), GetHeight(node->GetRight())) + 1;
+    }
+};
+
+} // namespace algorithms
@@ -0,0 +1,798 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "heap/node_pool.hpp"
+
+namespace algorithms {
+
+// Ordered map for large in-memory indexes. Every node holds many keys in an array
+// of about NODE_SIZE bytes, so a lookup touches a few cache lines per level instead
+// of one per key comparison as in binary trees, and the height is log of the number of keys
+// to the base of the fan-out. Keys are stored apart from values and children,
+// and a node is searched by halving its keys down to a short run which is counted
+// by a loop the compiler turns into vector instructions for arithmetic keys.
+// Values are kept in leaves only; leaves are linked, so a range is scanned
+// by following the links from LowerBound.
+// TKey and TValue must be default constructible and copy assignable
+template<typename TKey, typename TValue, size_t NODE_SIZE = 256>
+class BPlusTree {
+private:
+    struct Node;
+    struct Leaf;
+    struct Inner;
+
+public:
+    // Forward iterator over entries in key order; any insertion
+    // or erasure invalidates all iterators
+    class Iterator {
+    public:
+        Iterator() :
+            leaf_(nullptr),
+            index_(0) {}
+
+        const TKey &GetKey() const { return leaf_->keys_[index_]; }
+        const TValue &GetValue() const { return leaf_->values_[index_]; }
+
+        Iterator &operator ++ () {
+            if (++index_ == leaf_->count_) {
+                leaf_ = leaf_->next_;
+                index_ = 0;
+            }
+            return *this;
+        }
+
+        bool operator == (const Iterator &other) const {
+            return leaf_ == other.leaf_ && index_ == other.index_;
+        }
+        bool operator != (const Iterator &other) const {
+            return !(*this == other);
+        }
+
+    private:
+        friend class BPlusTree;
+
+        Iterator(const Leaf *leaf, size_t index) :
+            leaf_(leaf),
+            index_(index) {}
+
+        const Leaf *leaf_;
+        size_t index_;
+    };
+
+    BPlusTree();
+    ~BPlusTree();
+
+    BPlusTree(const BPlusTree &other) = delete;
+    BPlusTree &operator = (const BPlusTree &other) = delete;
+    BPlusTree(BPlusTree &&other);
+    BPlusTree &operator = (BPlusTree &&other);
+
+    // Adds the entry unless 'key' is present; returns whether it was added
+    bool Insert(const TKey &key, const TValue &value);
+    // Returns whether 'key' was present
+    bool Erase(const TKey &key);
+    const TValue *Find(const TKey &key) const;
+    TValue *Find(const TKey &key);
+
+    // Replaces the contents by entries of [begin, end), pairs of key and value
+    // with strictly increasing keys, in O(n). Leaves are filled up completely.
+    // Throws std::invalid_argument if keys are not increasing, leaving the tree as it was
+    template<typename TIterator>
+    void BulkLoad(TIterator begin, TIterator end);
+    void Clear();
+
+    // First entry with key not less than 'key'
+    Iterator LowerBound(const TKey &key) const;
+    Iterator Begin() const { return Iterator(first_leaf_, 0); }
+    Iterator End() const { return Iterator(); }
+
+    size_t GetSize() const { return size_; }
+    // Number of levels, leaves included
+    size_t GetHeight() const { return height_; }
+    // Bytes occupied by the tree, including free nodes kept for reuse
+    size_t GetMemoryUsage() const;
+
+    // Checks order of keys, separators, occupancy of nodes and links of leaves
+    bool IsValid() const;
+
+    static const size_t LEAF_CAPACITY =
+        (NODE_SIZE - 16) / (sizeof(TKey) + sizeof(TValue)) < 4 ?
+            4 : (NODE_SIZE - 16) / (sizeof(TKey) + sizeof(TValue));
+    static const size_t INNER_CAPACITY =
+        (NODE_SIZE - 8 - sizeof(void *)) / (sizeof(TKey) + sizeof(void *)) < 4 ?
+            4 : (NODE_SIZE - 8 - sizeof(void *)) / (sizeof(TKey) + sizeof(void *));
+
+private:
+    // Nodes other than the root are at least half full
+    static const size_t MIN_LEAF_COUNT = LEAF_CAPACITY / 2;
+    static const size_t MIN_INNER_COUNT = INNER_CAPACITY / 2;
+    // Runs of at most this many keys are counted instead of halved
+    static const size_t LINEAR_SEARCH_SIZE = 16;
+    // Enough for any number of keys which fits in memory
+    static const size_t MAX_HEIGHT = 64;
+
+    struct Node {
+        uint32_t count_;
+        bool is_leaf_;
+
+        explicit Node(bool is_leaf) :
+            count_(0),
+            is_leaf_(is_leaf) {}
+    };
+
+    struct Leaf : public Node {
+        Leaf *next_;
+        TKey keys_[LEAF_CAPACITY];
+        TValue values_[LEAF_CAPACITY];
+
+        Leaf() :
+            Node(true),
+            next_(nullptr) {}
+    };
+
+    // keys_[i] is the least key of the subtree of children_[i + 1]
+    // (or less than all of them but not less than the keys of children_[i])
+    struct Inner : public Node {
+        TKey keys_[INNER_CAPACITY];
+        Node *children_[INNER_CAPACITY + 1];
+
+        Inner() :
+            Node(false) {}
+    };
+
+    // Inner node on the way from the root and the index of the child taken
+    struct PathEntry {
+        Inner *node;
+        size_t index;
+    };
+
+    // Number of the first 'count' keys less than 'key'
+    static size_t CountLess(const TKey *keys, size_t count, const TKey &key);
+    // Index of the child of 'inner' whose subtree may hold 'key'
+    static size_t FindChild(const Inner *inner, const TKey &key);
+    // Goes down to the leaf which may hold 'key', recording inner nodes into 'path'
+    Leaf *FindLeaf(const TKey &key, PathEntry *path) const;
+
+    // Puts 'separator' and 'child' to the right of the child taken by path[depth - 1],
+    // splitting inner nodes up the path as they overflow
+    void InsertIntoParent(PathEntry *path, size_t depth, TKey separator, Node *child);
+    void RebalanceLeaf(Leaf *leaf, PathEntry *path, size_t depth);
+    // Fixes an inner node at 'depth' of 'path' which has lost a key
+    void RebalanceInner(PathEntry *path, size_t depth);
+    void RemoveFromInner(Inner *inner, size_t key_index);
+
+    void FreeSubtree(Node *node);
+    void Reset();
+
+    bool IsValid(const Node *node, size_t depth, const TKey *min_key, const TKey *max_key,
+                 const Leaf **previous_leaf, size_t *count) const;
+
+    NodePool<Leaf> leaf_pool_;
+    NodePool<Inner> inner_pool_;
+    Node *root_;
+    Leaf *first_leaf_;
+    size_t size_;
+    size_t height_;
+};
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+BPlusTree<TKey, TValue, NODE_SIZE>::BPlusTree() :
+    root_(nullptr),
+    first_leaf_(nullptr),
+    size_(0),
+    height_(0) {}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+BPlusTree<TKey, TValue, NODE_SIZE>::~BPlusTree() {
+    // pools return their memory at once, nodes need to be visited only for destructors
+    if (!std::is_trivially_destructible<Leaf>::value || !std::is_trivially_destructible<Inner>::value) {
+        FreeSubtree(root_);
+    }
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+BPlusTree<TKey, TValue, NODE_SIZE>::BPlusTree(BPlusTree &&other) :
+    leaf_pool_(std::move(other.leaf_pool_)),
+    inner_pool_(std::move(other.inner_pool_)),
+    root_(other.root_),
+    first_leaf_(other.first_leaf_),
+    size_(other.size_),
+    height_(other.height_) {
+    other.Reset();
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+BPlusTree<TKey, TValue, NODE_SIZE> &BPlusTree<TKey, TValue, NODE_SIZE>::operator = (BPlusTree &&other) {
+    if (&other != this) {
+        Clear();
+        leaf_pool_ = std::move(other.leaf_pool_);
+        inner_pool_ = std::move(other.inner_pool_);
+        root_ = other.root_;
+        first_leaf_ = other.first_leaf_;
+        size_ = other.size_;
+        height_ = other.height_;
+        other.Reset();
+    }
+    return *this;
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+void BPlusTree<TKey, TValue, NODE_SIZE>::Reset() {
+    root_ = nullptr;
+    first_leaf_ = nullptr;
+    size_ = 0;
+    height_ = 0;
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+void BPlusTree<TKey, TValue, NODE_SIZE>::Clear() {
+    if (!std::is_trivially_destructible<Leaf>::value || !std::is_trivially_destructible<Inner>::value) {
+        FreeSubtree(root_);
+    }
+    leaf_pool_ = NodePool<Leaf>();
+    inner_pool_ = NodePool<Inner>();
+    Reset();
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+void BPlusTree<TKey, TValue, NODE_SIZE>::FreeSubtree(Node *node) {
+    if (!node) {
+        return;
+    }
+    if (node->is_leaf_) {
+        leaf_pool_.Free(static_cast<Leaf *>(node));
+        return;
+    }
+    Inner *inner = static_cast<Inner *>(node);
+    for (size_t index = 0; index <= inner->count_; ++index) {
+        FreeSubtree(inner->children_[index]);
+    }
+    inner_pool_.Free(inner);
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+size_t BPlusTree<TKey, TValue, NODE_SIZE>::CountLess(const TKey *keys, size_t count, const TKey &key) {
+    size_t less_count = 0;
+    if (count < LINEAR_SEARCH_SIZE) {
+        for (size_t index = 0; index != count; ++index) {
+            less_count += keys[index] < key ? 1 : 0;
+        }
+        return less_count;
+    }
+    // halving without branches: keys before 'base' are less than 'key',
+    // keys from base + rest on are not
+    const TKey *base = keys;
+    size_t rest = count;
+    while (rest > LINEAR_SEARCH_SIZE) {
+        size_t half = rest / 2;
+        base = (base[half] < key) ? base + half : base;
+        rest -= half;
+    }
+    // the run is widened to the left to LINEAR_SEARCH_SIZE keys inside the array,
+    // a loop of a constant length is vectorized even without -O3
+    if (base + LINEAR_SEARCH_SIZE > keys + count) {
+        base = keys + count - LINEAR_SEARCH_SIZE;
+    }
+    for (size_t index = 0; index != LINEAR_SEARCH_SIZE; ++index) {
+        less_count += (base[index] < key) ? 1 : 0;
+    }
+    return (base - keys) + less_count;
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+size_t BPlusTree<TKey, TValue, NODE_SIZE>::FindChild(const Inner *inner, const TKey &key) {
+    size_t index = CountLess(inner->keys_, inner->count_, key);
+    // a key equal to a separator lies to the right of it
+    if (index < inner->count_ && !(key < inner->keys_[index])) {
+        ++index;
+    }
+    return index;
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+typename BPlusTree<TKey, TValue, NODE_SIZE>::Leaf *
+BPlusTree<TKey, TValue, NODE_SIZE>::FindLeaf(const TKey &key, PathEntry *path) const {
+    Node *node = root_;
+    size_t depth = 0;
+    while (!node->is_leaf_) {
+        Inner *inner = static_cast<Inner *>(node);
+        size_t index = FindChild(inner, key);
+        if (path) {
+            path[depth].node = inner;
+            path[depth].index = index;
+        }
+        ++depth;
+        node = inner->children_[index];
+    }
+    return static_cast<Leaf *>(node);
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+const TValue *BPlusTree<TKey, TValue, NODE_SIZE>::Find(const TKey &key) const {
+    if (!root_) {
+        return nullptr;
+    }
+    const Leaf *leaf = FindLeaf(key, nullptr);
+    size_t index = CountLess(leaf->keys_, leaf->count_, key);
+    if (index < leaf->count_ && !(key < leaf->keys_[index])) {
+        return &leaf->values_[index];
+    }
+    return nullptr;
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+TValue *BPlusTree<TKey, TValue, NODE_SIZE>::Find(const TKey &key) {
+    return const_cast<TValue *>(static_cast<const BPlusTree *>(this)->Find(key));
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+typename BPlusTree<TKey, TValue, NODE_SIZE>::Iterator
+BPlusTree<TKey, TValue, NODE_SIZE>::LowerBound(const TKey &key) const {
+    if (!root_) {
+        return End();
+    }
+    const Leaf *leaf = FindLeaf(key, nullptr);
+    size_t index = CountLess(leaf->keys_, leaf->count_, key);
+    if (index == leaf->count_) {
+        // all keys of the leaf are less, the bound is the first key of the next one
+        return Iterator(leaf->next_, 0);
+    }
+    return Iterator(leaf, index);
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+bool BPlusTree<TKey, TValue, NODE_SIZE>::Insert(const TKey &key, const TValue &value) {
+    if (!root_) {
+        first_leaf_ = leaf_pool_.Allocate();
+        root_ = first_leaf_;
+        height_ = 1;
+    }
+    PathEntry path[MAX_HEIGHT];
+    Leaf *leaf = FindLeaf(key, path);
+    size_t position = CountLess(leaf->keys_, leaf->count_, key);
+    if (position < leaf->count_ && !(key < leaf->keys_[position])) {
+        return false;
+    }
+    ++size_;
+
+    if (leaf->count_ < LEAF_CAPACITY) {
+        for (size_t index = leaf->count_; index > position; --index) {
+            leaf->keys_[index] = leaf->keys_[index - 1];
+            leaf->values_[index] = leaf->values_[index - 1];
+        }
+        leaf->keys_[position] = key;
+        leaf->values_[position] = value;
+        ++leaf->count_;
+        return true;
+    }
+
+    // the full leaf and the new entry are divided between the leaf and a new right one
+    Leaf *right = leaf_pool_.Allocate();
+    size_t left_count = (LEAF_CAPACITY + 1) / 2;
+    // entries of the right half are read before the left half is shifted
+    for (size_t index = left_count; index != LEAF_CAPACITY + 1; ++index) {
+        size_t target = index - left_count;
+        if (index == position) {
+            right->keys_[target] = key;
+            right->values_[target] = value;
+        } else {
+            size_t source = index < position ? index : index - 1;
+            right->keys_[target] = leaf->keys_[source];
+            right->values_[target] = leaf->values_[source];
+        }
+    }
+    if (position < left_count) {
+        for (size_t index = left_count - 1; index > position; --index) {
+            leaf->keys_[index] = leaf->keys_[index - 1];
+            leaf->values_[index] = leaf->values_[index - 1];
+        }
+        leaf->keys_[position] = key;
+        leaf->values_[position] = value;
+    }
+    leaf->count_ = static_cast<uint32_t>(left_count);
+    right->count_ = static_cast<uint32_t>(LEAF_CAPACITY + 1 - left_count);
+    right->next_ = leaf->next_;
+    leaf->next_ = right;
+
+    InsertIntoParent(path, height_ - 1, right->keys_[0], right);
+    return true;
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+void BPlusTree<TKey, TValue, NODE_SIZE>::InsertIntoParent(PathEntry *path, size_t depth,
+                                                          TKey separator, Node *child) {
+    while (depth > 0) {
+        Inner *inner = path[depth - 1].node;
+        size_t position = path[depth - 1].index;
+        if (inner->count_ < INNER_CAPACITY) {
+            for (size_t index = inner->count_; index > position; --index) {
+                inner->keys_[index] = inner->keys_[index - 1];
+                inner->children_[index + 1] = inner->children_[index];
+            }
+            inner->keys_[position] = separator;
+            inner->children_[position + 1] = child;
+            ++inner->count_;
+            return;
+        }
+
+        // the keys with the new one are INNER_CAPACITY + 1, the middle one goes up
+        TKey keys[INNER_CAPACITY + 1];
+        Node *children[INNER_CAPACITY + 2];
+        children[0] = inner->children_[0];
+        for (size_t index = 0, source = 0; index != INNER_CAPACITY + 1; ++index) {
+            if (index == position) {
+                keys[index] = separator;
+                children[index + 1] = child;
+            } else {
+                keys[index] = inner->keys_[source];
+                children[index + 1] = inner->children_[source + 1];
+                ++source;
+            }
+        }
+
+        Inner *right = inner_pool_.Allocate();
+        size_t left_count = (INNER_CAPACITY + 1) / 2;
+        inner->count_ = static_cast<uint32_t>(left_count);
+        for (size_t index = 0; index != left_count; ++index) {
+            inner->keys_[index] = keys[index];
+            inner->children_[index] = children[index];
+        }
+        inner->children_[left_count] = children[left_count];
+
+        right->count_ = static_cast<uint32_t>(INNER_CAPACITY - left_count);
+        for (size_t index = 0; index != right->count_; ++index) {
+            right->keys_[index] = keys[left_count + 1 + index];
+            right->children_[index] = children[left_count + 1 + index];
+        }
+        right->children_[right->count_] = children[INNER_CAPACITY + 1];
+
+        separator = keys[left_count];
+        child = right;
+        --depth;
+    }
+
+    // the root has been split
+    Inner *root = inner_pool_.Allocate();
+    root->count_ = 1;
+    root->keys_[0] = separator;
+    root->children_[0] = root_;
+    root->children_[1] = child;
+    root_ = root;
+    ++height_;
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+bool BPlusTree<TKey, TValue, NODE_SIZE>::Erase(const TKey &key) {
+    if (!root_) {
+        return false;
+    }
+    PathEntry path[MAX_HEIGHT];
+    Leaf *leaf = FindLeaf(key, path);
+    size_t position = CountLess(leaf->keys_, leaf->count_, key);
+    if (position == leaf->count_ || key < leaf->keys_[position]) {
+        return false;
+    }
+    --size_;
+    for (size_t index = position + 1; index < leaf->count_; ++index) {
+        leaf->keys_[index - 1] = leaf->keys_[index];
+        leaf->values_[index - 1] = leaf->values_[index];
+    }
+    --leaf->count_;
+
+    if (leaf == root_) {
+        if (leaf->count_ == 0) {
+            leaf_pool_.Free(leaf);
+            Reset();
+        }
+    } else if (leaf->count_ < MIN_LEAF_COUNT) {
+        RebalanceLeaf(leaf, path, height_ - 1);
+    }
+    return true;
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+void BPlusTree<TKey, TValue, NODE_SIZE>::RemoveFromInner(Inner *inner, size_t key_index) {
+    // removes the key and the child to the right of it
+    for (size_t index = key_index + 1; index < inner->count_; ++index) {
+        inner->keys_[index - 1] = inner->keys_[index];
+        inner->children_[index] = inner->children_[index + 1];
+    }
+    --inner->count_;
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+void BPlusTree<TKey, TValue, NODE_SIZE>::RebalanceLeaf(Leaf *leaf, PathEntry *path, size_t depth) {
+    Inner *parent = path[depth - 1].node;
+    size_t index = path[depth - 1].index;
+    Leaf *left = index > 0 ? static_cast<Leaf *>(parent->children_[index - 1]) : nullptr;
+    Leaf *right = index < parent->count_ ? static_cast<Leaf *>(parent->children_[index + 1]) : nullptr;
+
+    if (left && left->count_ > MIN_LEAF_COUNT) {
+        for (size_t position = leaf->count_; position > 0; --position) {
+            leaf->keys_[position] = leaf->keys_[position - 1];
+            leaf->values_[position] = leaf->values_[position - 1];
+        }
+        --left->count_;
+        leaf->keys_[0] = left->keys_[left->count_];
+        leaf->values_[0] = left->values_[left->count_];
+        ++leaf->count_;
+        parent->keys_[index - 1] = leaf->keys_[0];
+        return;
+    }
+    if (right && right->count_ > MIN_LEAF_COUNT) {
+        leaf->keys_[leaf->count_] = right->keys_[0];
+        leaf->values_[leaf->count_] = right->values_[0];
+        ++leaf->count_;
+        for (size_t position = 1; position < right->count_; ++position) {
+            right->keys_[position - 1] = right->keys_[position];
+            right->values_[position - 1] = right->values_[position];
+        }
+        --right->count_;
+        parent->keys_[index] = right->keys_[0];
+        return;
+    }
+
+    // both neighbours are half full, the right one of a pair is merged into the left one
+    size_t separator_index = left ? index - 1 : index;
+    if (!left) {
+        left = leaf;
+    } else {
+        right = leaf;
+    }
+    for (size_t position = 0; position != right->count_; ++position) {
+        left->keys_[left->count_ + position] = right->keys_[position];
+        left->values_[left->count_ + position] = right->values_[position];
+    }
+    left->count_ += right->count_;
+    left->next_ = right->next_;
+    leaf_pool_.Free(right);
+
+    RemoveFromInner(parent, separator_index);
+    RebalanceInner(path, depth - 1);
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+void BPlusTree<TKey, TValue, NODE_SIZE>::RebalanceInner(PathEntry *path, size_t depth) {
+    Inner *inner = path[depth].node;
+    if (depth == 0) {
+        if (inner->count_ == 0) {
+            root_ = inner->children_[0];
+            inner_pool_.Free(inner);
+            --height_;
+        }
+        return;
+    }
+    if (inner->count_ >= MIN_INNER_COUNT) {
+        return;
+    }
+
+    Inner *parent = path[depth - 1].node;
+    size_t index = path[depth - 1].index;
+    Inner *left = index > 0 ? static_cast<Inner *>(parent->children_[index - 1]) : nullptr;
+    Inner *right = index < parent->count_ ? static_cast<Inner *>(parent->children_[index + 1]) : nullptr;
+
+    // a key is rotated through the separator in the parent
+    if (left && left->count_ > MIN_INNER_COUNT) {
+        inner->children_[inner->count_ + 1] = inner->children_[inner->count_];
+        for (size_t position = inner->count_; position > 0; --position) {
+            inner->keys_[position] = inner->keys_[position - 1];
+            inner->children_[position] = inner->children_[position - 1];
+        }
+        inner->keys_[0] = parent->keys_[index - 1];
+        inner->children_[0] = left->children_[left->count_];
+        ++inner->count_;
+        parent->keys_[index - 1] = left->keys_[left->count_ - 1];
+        --left->count_;
+        return;
+    }
+    if (right && right->count_ > MIN_INNER_COUNT) {
+        inner->keys_[inner->count_] = parent->keys_[index];
+        inner->children_[inner->count_ + 1] = right->children_[0];
+        ++inner->count_;
+        parent->keys_[index] = right->keys_[0];
+        for (size_t position = 1; position < right->count_; ++position) {
+            right->keys_[position - 1] = right->keys_[position];
+            right->children_[position - 1] = right->children_[position];
+        }
+        right->children_[right->count_ - 1] = right->children_[right->count_];
+        --right->count_;
+        return;
+    }
+
+    // the separator comes down between the keys of the merged pair
+    size_t separator_index = left ? index - 1 : index;
+    if (!left) {
+        left = inner;
+    } else {
+        right = inner;
+    }
+    left->keys_[left->count_] = parent->keys_[separator_index];
+    for (size_t position = 0; position != right->count_; ++position) {
+        left->keys_[left->count_ + 1 + position] = right->keys_[position];
+        left->children_[left->count_ + 1 + position] = right->children_[position];
+    }
+    left->children_[left->count_ + 1 + right->count_] = right->children_[right->count_];
+    left->count_ += right->count_ + 1;
+    inner_pool_.Free(right);
+
+    RemoveFromInner(parent, separator_index);
+    RebalanceInner(path, depth - 1);
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+template<typename TIterator>
+void BPlusTree<TKey, TValue, NODE_SIZE>::BulkLoad(TIterator begin, TIterator end) {
+    if (begin != end) {
+        TIterator previous = begin;
+        for (TIterator current = std::next(begin); current != end; ++previous, ++current) {
+            if (!(previous->first < current->first)) {
+                throw std::invalid_argument("Keys of BPlusTree::BulkLoad are not increasing\n");
+            }
+        }
+    }
+    Clear();
+
+    // nodes of the level being built and the least keys of their subtrees
+    std::vector<Node *> level;
+    std::vector<TKey> least_keys;
+    Leaf *leaf = nullptr;
+    for (TIterator current = begin; current != end; ++current) {
+        if (!leaf || leaf->count_ == LEAF_CAPACITY) {
+            Leaf *next = leaf_pool_.Allocate();
+            if (leaf) {
+                leaf->next_ = next;
+            } else {
+                first_leaf_ = next;
+            }
+            leaf = next;
+            level.push_back(leaf);
+            least_keys.push_back(current->first);
+        }
+        leaf->keys_[leaf->count_] = current->first;
+        leaf->values_[leaf->count_] = current->second;
+        ++leaf->count_;
+        ++size_;
+    }
+    if (!leaf) {
+        return;
+    }
+    height_ = 1;
+
+    // the last leaf takes entries from the full one before it to be half full
+    if (level.size() > 1 && leaf->count_ < MIN_LEAF_COUNT) {
+        Leaf *previous = static_cast<Leaf *>(level[level.size() - 2]);
+        size_t moved_count = MIN_LEAF_COUNT - leaf->count_;
+        for (size_t position = leaf->count_; position-- > 0;) {
+            leaf->keys_[position + moved_count] = leaf->keys_[position];
+            leaf->values_[position + moved_count] = leaf->values_[position];
+        }
+        for (size_t position = 0; position != moved_count; ++position) {
+            leaf->keys_[position] = previous->keys_[previous->count_ - moved_count + position];
+            leaf->values_[position] = previous->values_[previous->count_ - moved_count + position];
+        }
+        previous->count_ -= static_cast<uint32_t>(moved_count);
+        leaf->count_ += static_cast<uint32_t>(moved_count);
+        least_keys.back() = leaf->keys_[0];
+    }
+
+    while (level.size() > 1) {
+        std::vector<Node *> parents;
+        std::vector<TKey> parent_least_keys;
+        for (size_t first = 0; first < level.size(); first += INNER_CAPACITY + 1) {
+            size_t children_count = level.size() - first;
+            if (children_count > INNER_CAPACITY + 1) {
+                children_count = INNER_CAPACITY + 1;
+            }
+            Inner *inner = inner_pool_.Allocate();
+            inner->children_[0] = level[first];
+            for (size_t index = 1; index != children_count; ++index) {
+                inner->keys_[index - 1] = least_keys[first + index];
+                inner->children_[index] = level[first + index];
+            }
+            inner->count_ = static_cast<uint32_t>(children_count - 1);
+            parents.push_back(inner);
+            parent_least_keys.push_back(least_keys[first]);
+        }
+
+        // the last node takes children from the full one before it to be half full
+        Inner *last = static_cast<Inner *>(parents.back());
+        if (parents.size() > 1 && last->count_ < MIN_INNER_COUNT) {
+            Inner *previous = static_cast<Inner *>(parents[parents.size() - 2]);
+            size_t moved_count = MIN_INNER_COUNT - last->count_;
+            size_t last_first = (parents.size() - 1) * (INNER_CAPACITY + 1) - moved_count;
+            size_t children_count = level.size() - last_first;
+            last->children_[0] = level[last_first];
+            for (size_t index = 1; index != children_count; ++index) {
+                last->keys_[index - 1] = least_keys[last_first + index];
+                last->children_[index] = level[last_first + index];
+            }
+            last->count_ = static_cast<uint32_t>(children_count - 1);
+            previous->count_ -= static_cast<uint32_t>(moved_count);
+            parent_least_keys.back() = least_keys[last_first];
+        }
+
+        level.swap(parents);
+        least_keys.swap(parent_least_keys);
+        ++height_;
+    }
+    root_ = level[0];
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+size_t BPlusTree<TKey, TValue, NODE_SIZE>::GetMemoryUsage() const {
+    return sizeof(*this) + leaf_pool_.GetCapacity() * sizeof(Leaf) +
+           inner_pool_.GetCapacity() * sizeof(Inner);
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+bool BPlusTree<TKey, TValue, NODE_SIZE>::IsValid() const {
+    if (!root_) {
+        return size_ == 0 && height_ == 0 && first_leaf_ == nullptr;
+    }
+    const Leaf *previous_leaf = nullptr;
+    size_t count = 0;
+    if (!IsValid(root_, 1, nullptr, nullptr, &previous_leaf, &count)) {
+        return false;
+    }
+    return count == size_ && previous_leaf->next_ == nullptr;
+}
+
+template<typename TKey, typename TValue, size_t NODE_SIZE>
+bool BPlusTree<TKey, TValue, NODE_SIZE>::IsValid(const Node *node, size_t depth,
+                                                 const TKey *min_key, const TKey *max_key,
+                                                 const Leaf **previous_leaf, size_t *count) const {
+    // keys of the subtree are in [min_key, max_key)
+    if (node != root_) {
+        size_t min_count = MIN_INNER_COUNT;
+        if (node->is_leaf_) {
+            min_count = MIN_LEAF_COUNT;
+        }
+        if (node->count_ < min_count) {
+            return false;
+        }
+    }
+    if (node->is_leaf_) {
+        const Leaf *leaf = static_cast<const Leaf *>(node);
+        if (depth != height_ || leaf->count_ == 0) {
+            return false;
+        }
+        // leaves are met in the order of links
+        if ((*previous_leaf ? (*previous_leaf)->next_ : first_leaf_) != leaf) {
+            return false;
+        }
+        *previous_leaf = leaf;
+        *count += leaf->count_;
+        for (size_t index = 0; index != leaf->count_; ++index) {
+            if ((index > 0 && !(leaf->keys_[index - 1] < leaf->keys_[index])) ||
+                (min_key && leaf->keys_[index] < *min_key) ||
+                (max_key && !(leaf->keys_[index] < *max_key))) {
+                return false;
+            }
+        }
+        return true;
+    }
+    const Inner *inner = static_cast<const Inner *>(node);
+    if (inner->count_ == 0) {
+        return false;
+    }
+    for (size_t index = 0; index <= inner->count_; ++index) {
+        if (index > 0 && index < inner->count_ && !(inner->keys_[index - 1] < inner->keys_[index])) {
+            return false;
+        }
+        const TKey *child_min = index > 0 ? &inner->keys_[index - 1] : min_key;
+        const TKey *child_max = index < inner->count_ ? &inner->keys_[index] : max_key;
+        if (!IsValid(inner->children_[index], depth + 1, child_min, child_max, previous_leaf, count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace algorithms
@@ -2,38 +2,52 @@
 
 #include <vector>
 #include <array>
+#include <cstddef>
+#include <iterator>
 #include <stack>
+#include <type_traits>
+
+#include "heap/node_pool.hpp"
+#include "tree/tree_augmentation.hpp"
 
 namespace algorithms {
 
 template<typename Elem>
 struct TraitsSentinel;
 
-template<typename Elem>
+// Nodes are obtained from TAllocator<Node>, which provides Allocate(args...), Free(node),
+// Splice(other) taking over the nodes of another allocator, and RELEASES_MEMORY telling
+// whether its destruction returns the memory of nodes still allocated.
+// The default NodePool keeps nodes in contiguous blocks and reuses freed ones,
+// so a tree of trivially destructible elements is destroyed without visiting its nodes.
+// Trees split from one SplayTree share nodes of a SharedNodePool.
+// Nodes carry data of TAugmentation, see tree_augmentation.hpp; with OrderStatistics
+// the tree answers Select, Rank and RangeAggregate in O(height)
+template<typename Elem, template<typename> class TAllocator = NodePool, typename TAugmentation = NoAugmentation>
 class BinarySearchTree {
 public:
     struct Node;
+    class Iterator;
+    class IteratorRange;
+    typedef typename TAugmentation::template Data<Elem> AugmentationData;
+    typedef typename TAugmentation::Monoid::Value AggregateValue;
 
     BinarySearchTree();
-    BinarySearchTree(Node* root)
-        : root_(root) {
-        if (root) {
-            root->SetParent(nullptr);
-        }
-    }
     virtual ~BinarySearchTree();
 
     BinarySearchTree(const BinarySearchTree& other) = delete;
-    BinarySearchTree(BinarySearchTree&& other) {
+    BinarySearchTree(BinarySearchTree&& other) :
+        allocator_(std::move(other.allocator_)) {
         root_ = other.root_;
         other.root_ = nullptr;
     }
 
-    BinarySearchTree<Elem>& operator = (const BinarySearchTree<Elem>& other) = delete;
-    BinarySearchTree<Elem>& operator = (BinarySearchTree<Elem>&& other) {
+    BinarySearchTree& operator = (const BinarySearchTree& other) = delete;
+    BinarySearchTree& operator = (BinarySearchTree&& other) {
         if (root_) {
             FreeTree(root_);
         }
+        allocator_ = std::move(other.allocator_);
         root_ = other.root_;
         other.root_ = nullptr;
         return *this;
@@ -51,10 +65,34 @@ public:
     virtual Node* Search(const Elem& elem);
 
     Node* GetRoot() const { return root_; }
+    const TAllocator<Node>& GetAllocator() const { return allocator_; }
+
+    Iterator Begin() const;
+    Iterator End() const { return Iterator(nullptr, this); }
+    // for range-based for
+    Iterator begin() const { return Begin(); }
+    Iterator end() const { return End(); }
+
+    // First element not less than 'elem'
+    Iterator LowerBound(const Elem& elem) const;
+    // First element greater than 'elem'
+    Iterator UpperBound(const Elem& elem) const;
+    // Elements in [low, high). Bounds are found in O(height),
+    // then every element of the range takes O(1) amortized
+    IteratorRange Range(const Elem& low, const Elem& high) const;
+
+    // Order statistics, available with the OrderStatistics augmentation
+    size_t GetSize() const { return GetSize(root_); }
+    // Element with 'index' elements less than it, End() if index >= GetSize()
+    Iterator Select(size_t index) const;
+    // Number of elements less than 'elem'
+    size_t Rank(const Elem& elem) const;
+    // Aggregate of elements in [low, high) in order
+    AggregateValue RangeAggregate(const Elem& low, const Elem& high) const;
 
     bool IsValid() const;
 
-    struct Node {
+    struct Node : public AugmentationData {
     public:
         Node(Elem data);
         Node();
@@ -72,15 +110,93 @@ public:
         const Elem &GetData() const;
         void SwapData(Node *other);
 
+        // Height of the subtree, maintained only by balanced subclasses
+        int GetHeight() const { return height_; }
+        void SetHeight(int height) { height_ = height; }
+
+        const AugmentationData& GetAugmentation() const { return *this; }
+        // Recomputes the augmentation from the children, which have to be up to date
+        void UpdateAugmentation() {
+            AugmentationData::Update(data_, left_, right_);
+        }
+
         void DebugPrint() const;
 
     private:
         Node *left_;
         Node *right_;
         Node *parent_;
+        int height_;
         Elem data_;
     };
 
+    // Bidirectional iterator over elements in order. It moves along parent pointers,
+    // so a pass over the tree takes O(n) time and no memory. Insertions and deletions
+    // invalidate iterators, as deletion moves elements between nodes; splaying does not
+    class Iterator {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef Elem value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Elem* pointer;
+        typedef const Elem& reference;
+
+        Iterator() :
+            node_(nullptr),
+            tree_(nullptr) {}
+
+        reference operator * () const { return node_->GetData(); }
+        pointer operator -> () const { return &node_->GetData(); }
+        const Node* GetNode() const { return node_; }
+
+        Iterator& operator ++ () {
+            node_ = GetNextInorder(node_);
+            return *this;
+        }
+        Iterator operator ++ (int) {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+        // decrementing End() gives the last element
+        Iterator& operator -- () {
+            node_ = node_ ? GetPreviousInorder(node_) : GetMax(tree_->root_);
+            return *this;
+        }
+        Iterator operator -- (int) {
+            Iterator next = *this;
+            --*this;
+            return next;
+        }
+
+        bool operator == (const Iterator& other) const { return node_ == other.node_; }
+        bool operator != (const Iterator& other) const { return node_ != other.node_; }
+
+    private:
+        friend class BinarySearchTree;
+
+        Iterator(const Node* node, const BinarySearchTree* tree) :
+            node_(node),
+            tree_(tree) {}
+
+        const Node* node_;
+        const BinarySearchTree* tree_;
+    };
+
+    class IteratorRange {
+    public:
+        IteratorRange(Iterator begin, Iterator end) :
+            begin_(begin),
+            end_(end) {}
+
+        Iterator begin() const { return begin_; }
+        Iterator end() const { return end_; }
+
+    private:
+        Iterator begin_;
+        Iterator end_;
+    };
+
 protected:
     struct NodeTraverse {
     public:
@@ -109,32 +225,52 @@ protected:
     Node *GetPredecessor(Node* current);
     Node *GetSuccessor(Node* current);
 
+    static const Node *GetMin(const Node* root);
+    static const Node *GetMax(const Node* root);
+    // Neighbours of 'current' in the whole tree, nullptr for the last and the first nodes
+    static const Node *GetNextInorder(const Node* current);
+    static const Node *GetPreviousInorder(const Node* current);
+
     void FreeNode(Node* node);
     void FreeTree(Node* root);
 
+    // Updates augmentations of 'node' and its ancestors
+    void UpdatePath(Node* node);
+    // Updates augmentations of all nodes of the subtree
+    void UpdateSubtree(Node* root);
+    static size_t GetSize(const Node* node) {
+        return node ? node->GetAugmentation().size : 0;
+    }
+    static AggregateValue GetAggregate(const Node* node) {
+        return node ? node->GetAugmentation().aggregate : TAugmentation::Monoid::Identity();
+    }
+
     std::pair<Node*, bool> FindElem(const Elem& elem);
 
     bool IsValid(Node* node, Elem* min_val, Elem* max_val) const;
 
+    TAllocator<Node> allocator_;
     Node* root_;
 };
 
-template<typename Elem>
-BinarySearchTree<Elem>::Node::Node() :
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+BinarySearchTree<Elem, TAllocator, TAugmentation>::Node::Node() :
     left_(nullptr),
     right_(nullptr),
     parent_(nullptr),
+    height_(1),
     data_(Elem()) {}
 
-template<typename Elem>
-BinarySearchTree<Elem>::Node::Node(Elem data) :
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+BinarySearchTree<Elem, TAllocator, TAugmentation>::Node::Node(Elem data) :
     left_(nullptr),
     right_(nullptr),
     parent_(nullptr),
+    height_(1),
     data_(data) {}
 
-template<typename Elem>
-void BinarySearchTree<Elem>::Node::SetLeft(Node *left) {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void BinarySearchTree<Elem, TAllocator, TAugmentation>::Node::SetLeft(Node *left) {
     /*if (left_) {
         left_->SetParent(nullptr);
     }
@@ -152,13 +288,13 @@ void BinarySearchTree<Elem>::Node::SetLeft(Node *left) {
     }
 }
 
-template<typename Elem>
-void BinarySearchTree<Elem>::Node::SetParent(Node *parent) {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void BinarySearchTree<Elem, TAllocator, TAugmentation>::Node::SetParent(Node *parent) {
     parent_ = parent;
 }
 
-template<typename Elem>
-void BinarySearchTree<Elem>::Node::SetRight(Node *right) {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void BinarySearchTree<Elem, TAllocator, TAugmentation>::Node::SetRight(Node *right) {
     /*
     if (right_) {
         right_->SetParent(nullptr);
@@ -179,38 +315,38 @@ void BinarySearchTree<Elem>::Node::SetRight(Node *right) {
     }
 }
 
-template<typename Elem>
-typename BinarySearchTree<Elem>::Node const *BinarySearchTree<Elem>::Node::GetLeft() const {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node const *BinarySearchTree<Elem, TAllocator, TAugmentation>::Node::GetLeft() const {
     return left_;
 }
 
-template<typename Elem>
-typename BinarySearchTree<Elem>::Node const *BinarySearchTree<Elem>::Node::GetRight() const {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node const *BinarySearchTree<Elem, TAllocator, TAugmentation>::Node::GetRight() const {
     return right_;
 }
 
-template<typename Elem>
-typename BinarySearchTree<Elem>::Node const *BinarySearchTree<Elem>::Node::GetParent() const {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node const *BinarySearchTree<Elem, TAllocator, TAugmentation>::Node::GetParent() const {
     return parent_;
 }
 
-template<typename Elem>
-typename BinarySearchTree<Elem>::Node *BinarySearchTree<Elem>::Node::GetLeft() {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node *BinarySearchTree<Elem, TAllocator, TAugmentation>::Node::GetLeft() {
     return left_;
 }
 
-template<typename Elem>
-typename BinarySearchTree<Elem>::Node *BinarySearchTree<Elem>::Node::GetRight() {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node *BinarySearchTree<Elem, TAllocator, TAugmentation>::Node::GetRight() {
     return right_;
 }
 
-template<typename Elem>
-typename BinarySearchTree<Elem>::Node *BinarySearchTree<Elem>::Node::GetParent() {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node *BinarySearchTree<Elem, TAllocator, TAugmentation>::Node::GetParent() {
     return parent_;
 }
 
-template<typename Elem>
-void BinarySearchTree<Elem>::Node::DebugPrint() const {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void BinarySearchTree<Elem, TAllocator, TAugmentation>::Node::DebugPrint() const {
     std::cout << data_;
     if (left_) {
         std::cout << ", L{ ";
@@ -224,40 +360,51 @@ void BinarySearchTree<Elem>::Node::DebugPrint() const {
     }
 }
 
-template<typename Elem>
-const Elem& BinarySearchTree<Elem>::Node::GetData() const {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+const Elem& BinarySearchTree<Elem, TAllocator, TAugmentation>::Node::GetData() const {
     return data_;
 }
 
-template<typename Elem>
-void BinarySearchTree<Elem>::Node::SwapData(Node *other) {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void BinarySearchTree<Elem, TAllocator, TAugmentation>::Node::SwapData(Node *other) {
     using std::swap;
     swap(data_, other->data_);
 }
 
-template<typename Elem>
-BinarySearchTree<Elem>::BinarySearchTree() {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+BinarySearchTree<Elem, TAllocator, TAugmentation>::BinarySearchTree() {
     root_ = nullptr;
 }
 
-template<typename Elem>
-BinarySearchTree<Elem>::~BinarySearchTree() {
-    FreeTree(root_);
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+BinarySearchTree<Elem, TAllocator, TAugmentation>::~BinarySearchTree() {
+    // an allocator which releases its memory at once takes trivially destructible nodes with it
+    if (!TAllocator<Node>::RELEASES_MEMORY || !std::is_trivially_destructible<Node>::value) {
+        FreeTree(root_);
+    }
 }
 
-template<typename Elem>
-void BinarySearchTree<Elem>::FreeTree(Node* root) {
-    if (root) {
-        FreeTree(root->GetLeft());
-        FreeTree(root->GetRight());
-
-        FreeNode(root);
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void BinarySearchTree<Elem, TAllocator, TAugmentation>::FreeTree(Node* root) {
+    // postorder without recursion: a freed leaf is unlinked from its parent,
+    // so the walk goes down to the next leaf and back up by parent pointers
+    Node* current = root;
+    while (current) {
+        if (current->GetLeft()) {
+            current = current->GetLeft();
+        } else if (current->GetRight()) {
+            current = current->GetRight();
+        } else {
+            Node* parent = current == root ? nullptr : current->GetParent();
+            FreeNode(current);
+            current = parent;
+        }
     }
 }
 
 
-template<typename Elem>
-void BinarySearchTree<Elem>::InitPreorder(std::vector<Elem> vec) {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void BinarySearchTree<Elem, TAllocator, TAugmentation>::InitPreorder(std::vector<Elem> vec) {
     auto max_sentinel = TraitsSentinel<Elem>::GetMaxSentinel();
 
     vec.push_back(max_sentinel);
@@ -287,10 +434,11 @@ void BinarySearchTree<Elem>::InitPreorder(std::vector<Elem> vec) {
             current_node = current_node->GetParent();
         }
     }
+    UpdateSubtree(root_);
 }
 
-template<typename Elem>
-void BinarySearchTree<Elem>::OutputPreorder(const Node* current, std::vector<Elem>* output) const {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void BinarySearchTree<Elem, TAllocator, TAugmentation>::OutputPreorder(const Node* current, std::vector<Elem>* output) const {
     output->push_back(current->GetData());
     if (current->GetLeft()) {
         OutputPreorder(current->GetLeft(), output);
@@ -300,15 +448,15 @@ void BinarySearchTree<Elem>::OutputPreorder(const Node* current, std::vector<Ele
     }
 }
 
-template<typename Elem>
-std::vector<Elem> BinarySearchTree<Elem>::OutputPreorder() const {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+std::vector<Elem> BinarySearchTree<Elem, TAllocator, TAugmentation>::OutputPreorder() const {
     std::vector<Elem> output;
     OutputPreorder(root_, &output);
     return output;
 }
 
-template<typename Elem>
-std::vector<Elem> BinarySearchTree<Elem>::OutputPostorder() const {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+std::vector<Elem> BinarySearchTree<Elem, TAllocator, TAugmentation>::OutputPostorder() const {
     std::vector<Elem> output;
     std::stack<NodeTraverse> stack;
     stack.push(NodeTraverse(root_));
@@ -330,37 +478,18 @@ std::vector<Elem> BinarySearchTree<Elem>::OutputPostorder() const {
     return output;
 }
 
-template<typename Elem>
-std::vector<Elem> BinarySearchTree<Elem>::OutputInorder() const {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+std::vector<Elem> BinarySearchTree<Elem, TAllocator, TAugmentation>::OutputInorder() const {
     std::vector<Elem> output;
-    std::stack<NodeTraverse> stack;
-    if (root_) {
-        stack.push(NodeTraverse(root_));
-    }
-
-    while(!stack.empty()) {
-        if (stack.top().node->GetLeft() && !stack.top().visited_left) {
-            stack.top().visited_left = true;
-            stack.push(NodeTraverse(stack.top().node->GetLeft()));
-            continue;
-        }
-        if (!stack.top().visited) {
-            output.push_back(stack.top().node->GetData());
-            stack.top().visited = true;
-        }
-        if (stack.top().node->GetRight() && !stack.top().visited_right) {
-            stack.top().visited_right = true;
-            stack.push(NodeTraverse(stack.top().node->GetRight()));
-            continue;
-        }
-        stack.pop();
+    for (const Elem& elem : *this) {
+        output.push_back(elem);
     }
     return output;
 }
 
 
-template<typename Elem>
-std::pair<typename BinarySearchTree<Elem>::Node*, bool> BinarySearchTree<Elem>::FindElem(const Elem& elem) {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+std::pair<typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node*, bool> BinarySearchTree<Elem, TAllocator, TAugmentation>::FindElem(const Elem& elem) {
     Node* current = root_;
     Node* prev = root_;
 
@@ -384,8 +513,8 @@ std::pair<typename BinarySearchTree<Elem>::Node*, bool> BinarySearchTree<Elem>::
 }
 
 
-template<typename Elem>
-typename BinarySearchTree<Elem>::Node* BinarySearchTree<Elem>::Search(const Elem& elem) {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node* BinarySearchTree<Elem, TAllocator, TAugmentation>::Search(const Elem& elem) {
     auto found = FindElem(elem);
     if (found.second) {
         return found.first;
@@ -395,8 +524,8 @@ typename BinarySearchTree<Elem>::Node* BinarySearchTree<Elem>::Search(const Elem
 }
 
 
-template<typename Elem>
-typename BinarySearchTree<Elem>::Node* BinarySearchTree<Elem>::Insert(const Elem& elem) {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node* BinarySearchTree<Elem, TAllocator, TAugmentation>::Insert(const Elem& elem) {
     auto found = FindElem(elem);
     if (found.second) {
         return found.first;
@@ -408,24 +537,26 @@ typename BinarySearchTree<Elem>::Node* BinarySearchTree<Elem>::Insert(const Elem
         } else if (elem < parent->GetData()) {
             assert(!parent->GetLeft());
             parent->SetLeft(AddNode(elem));
+            UpdatePath(parent);
             return parent->GetLeft();
         } else {
             assert(!parent->GetRight());
             parent->SetRight(AddNode(elem));
+            UpdatePath(parent);
             return parent->GetRight();
         }
     }
 }
 
-template<typename Elem>
-void BinarySearchTree<Elem>::Delete(const Elem& elem) {
-    typename BinarySearchTree<Elem>::Node* node = Search(elem);
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void BinarySearchTree<Elem, TAllocator, TAugmentation>::Delete(const Elem& elem) {
+    typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node* node = Search(elem);
     Delete(node);
 }
 
 
-template<typename Elem>
-void BinarySearchTree<Elem>::Delete(BinarySearchTree<Elem>::Node* to_delete) {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void BinarySearchTree<Elem, TAllocator, TAugmentation>::Delete(BinarySearchTree<Elem, TAllocator, TAugmentation>::Node* to_delete) {
     if (!to_delete) {
         return;
     }
@@ -436,11 +567,14 @@ void BinarySearchTree<Elem>::Delete(BinarySearchTree<Elem>::Node* to_delete) {
         }
 
         if (!child) {
+            Node* parent = to_delete->GetParent();
             FreeNode(to_delete);
+            UpdatePath(parent);
             return;
         } else if (child && !child->GetLeft() && !child->GetRight()) {
             to_delete->SwapData(child);
             FreeNode(child);
+            UpdatePath(to_delete);
             return;
         }
     }
@@ -456,25 +590,133 @@ void BinarySearchTree<Elem>::Delete(BinarySearchTree<Elem>::Node* to_delete) {
 }
 
 
-template<typename Elem>
-typename BinarySearchTree<Elem>::Node* BinarySearchTree<Elem>::AddNode(const Elem &value) {
-    Node* node = new Node(value);
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node* BinarySearchTree<Elem, TAllocator, TAugmentation>::AddNode(const Elem &value) {
+    Node* node = allocator_.Allocate(value);
     // printf("new %llx\n", (unsigned long long) (void*) node);
+    node->UpdateAugmentation();
     return node;
 }
 
-template<typename Elem>
-bool BinarySearchTree<Elem>::IsValid() const {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void BinarySearchTree<Elem, TAllocator, TAugmentation>::UpdatePath(Node* node) {
+    if (!TAugmentation::ENABLED) {
+        return;
+    }
+    while (node) {
+        node->UpdateAugmentation();
+        node = node->GetParent();
+    }
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void BinarySearchTree<Elem, TAllocator, TAugmentation>::UpdateSubtree(Node* root) {
+    if (!TAugmentation::ENABLED || !root) {
+        return;
+    }
+    // postorder by parent pointers: a node is updated when the walk leaves it upwards
+    Node* stop = root->GetParent();
+    Node* previous = stop;
+    Node* current = root;
+    while (current != stop) {
+        Node* next = current->GetParent();
+        if (previous == current->GetParent() && current->GetLeft()) {
+            next = current->GetLeft();
+        } else if (previous != current->GetRight() && current->GetRight()) {
+            next = current->GetRight();
+        } else {
+            current->UpdateAugmentation();
+        }
+        previous = current;
+        current = next;
+    }
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Iterator
+BinarySearchTree<Elem, TAllocator, TAugmentation>::Select(size_t index) const {
+    const Node* current = root_;
+    while (current) {
+        size_t left_size = GetSize(current->GetLeft());
+        if (index < left_size) {
+            current = current->GetLeft();
+        } else if (index == left_size) {
+            break;
+        } else {
+            index -= left_size + 1;
+            current = current->GetRight();
+        }
+    }
+    return Iterator(current, this);
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+size_t BinarySearchTree<Elem, TAllocator, TAugmentation>::Rank(const Elem& elem) const {
+    size_t rank = 0;
+    const Node* current = root_;
+    while (current) {
+        if (current->GetData() < elem) {
+            rank += GetSize(current->GetLeft()) + 1;
+            current = current->GetRight();
+        } else {
+            current = current->GetLeft();
+        }
+    }
+    return rank;
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::AggregateValue
+BinarySearchTree<Elem, TAllocator, TAugmentation>::RangeAggregate(const Elem& low, const Elem& high) const {
+    typedef typename TAugmentation::Monoid Monoid;
+    // the highest node in the range splits it into parts in its left and right subtrees
+    const Node* split = root_;
+    while (split && (split->GetData() < low || !(split->GetData() < high))) {
+        split = split->GetData() < low ? split->GetRight() : split->GetLeft();
+    }
+    if (!split) {
+        return Monoid::Identity();
+    }
+
+    // the left part is gathered from right to left: a node not less than 'low'
+    // comes with its right subtree before everything gathered so far
+    AggregateValue left_part = Monoid::Identity();
+    for (const Node* current = split->GetLeft(); current;) {
+        if (current->GetData() < low) {
+            current = current->GetRight();
+        } else {
+            left_part = Monoid::Combine(Monoid::Combine(Monoid::Make(current->GetData()),
+                                                        GetAggregate(current->GetRight())),
+                                        left_part);
+            current = current->GetLeft();
+        }
+    }
+    AggregateValue right_part = Monoid::Identity();
+    for (const Node* current = split->GetRight(); current;) {
+        if (current->GetData() < high) {
+            right_part = Monoid::Combine(right_part,
+                                         Monoid::Combine(GetAggregate(current->GetLeft()),
+                                                         Monoid::Make(current->GetData())));
+            current = current->GetRight();
+        } else {
+            current = current->GetLeft();
+        }
+    }
+    return Monoid::Combine(Monoid::Combine(left_part, Monoid::Make(split->GetData())), right_part);
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+bool BinarySearchTree<Elem, TAllocator, TAugmentation>::IsValid() const {
     int min_unused, max_unused;
-    bool valid = IsValid(root_, &min_unused, &max_unused);
+    bool valid = (!root_ || !root_->GetParent()) && IsValid(root_, &min_unused, &max_unused);
     if (!valid) {
         DebugPrint();
     }
     return valid;
 }
 
-template<typename Elem>
-bool BinarySearchTree<Elem>::IsValid(Node* node, Elem* min_value, Elem* max_value) const {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+bool BinarySearchTree<Elem, TAllocator, TAugmentation>::IsValid(Node* node, Elem* min_value, Elem* max_value) const {
     if (!node) return true;
 
     // *min_value = root->val;
@@ -512,8 +754,8 @@ bool BinarySearchTree<Elem>::IsValid(Node* node, Elem* min_value, Elem* max_valu
     return true;
 }
 
-template<typename Elem>
-typename BinarySearchTree<Elem>::Node *BinarySearchTree<Elem>::GetPredecessor(Node* node) {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node *BinarySearchTree<Elem, TAllocator, TAugmentation>::GetPredecessor(Node* node) {
     Node* current = node->GetLeft();
     while (current && current->GetRight()) {
         current = current->GetRight();
@@ -521,8 +763,8 @@ typename BinarySearchTree<Elem>::Node *BinarySearchTree<Elem>::GetPredecessor(No
     return current;
 }
 
-template<typename Elem>
-typename BinarySearchTree<Elem>::Node *BinarySearchTree<Elem>::GetSuccessor(Node* node) {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node *BinarySearchTree<Elem, TAllocator, TAugmentation>::GetSuccessor(Node* node) {
     Node* current = node->GetRight();
     while (current && current->GetLeft()) {
         current = current->GetLeft();
@@ -530,13 +772,103 @@ typename BinarySearchTree<Elem>::Node *BinarySearchTree<Elem>::GetSuccessor(Node
     return current;
 }
 
-template<typename Elem>
-void BinarySearchTree<Elem>::FreeNode(Node* node) {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node const *BinarySearchTree<Elem, TAllocator, TAugmentation>::GetMin(const Node* root) {
+    const Node* current = root;
+    while (current && current->GetLeft()) {
+        current = current->GetLeft();
+    }
+    return current;
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node const *BinarySearchTree<Elem, TAllocator, TAugmentation>::GetMax(const Node* root) {
+    const Node* current = root;
+    while (current && current->GetRight()) {
+        current = current->GetRight();
+    }
+    return current;
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node const *
+BinarySearchTree<Elem, TAllocator, TAugmentation>::GetNextInorder(const Node* current) {
+    if (current->GetRight()) {
+        return GetMin(current->GetRight());
+    }
+    // the first ancestor whose left subtree holds 'current'
+    while (current->GetParent() && current->GetParent()->GetRight() == current) {
+        current = current->GetParent();
+    }
+    return current->GetParent();
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node const *
+BinarySearchTree<Elem, TAllocator, TAugmentation>::GetPreviousInorder(const Node* current) {
+    if (current->GetLeft()) {
+        return GetMax(current->GetLeft());
+    }
+    while (current->GetParent() && current->GetParent()->GetLeft() == current) {
+        current = current->GetParent();
+    }
+    return current->GetParent();
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Iterator BinarySearchTree<Elem, TAllocator, TAugmentation>::Begin() const {
+    return Iterator(GetMin(root_), this);
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Iterator
+BinarySearchTree<Elem, TAllocator, TAugmentation>::LowerBound(const Elem& elem) const {
+    const Node* current = root_;
+    const Node* bound = nullptr;
+    while (current) {
+        if (current->GetData() < elem) {
+            current = current->GetRight();
+        } else {
+            bound = current;
+            current = current->GetLeft();
+        }
+    }
+    return Iterator(bound, this);
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Iterator
+BinarySearchTree<Elem, TAllocator, TAugmentation>::UpperBound(const Elem& elem) const {
+    const Node* current = root_;
+    const Node* bound = nullptr;
+    while (current) {
+        if (elem < current->GetData()) {
+            bound = current;
+            current = current->GetLeft();
+        } else {
+            current = current->GetRight();
+        }
+    }
+    return Iterator(bound, this);
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename BinarySearchTree<Elem, TAllocator, TAugmentation>::IteratorRange
+BinarySearchTree<Elem, TAllocator, TAugmentation>::Range(const Elem& low, const Elem& high) const {
+    Iterator begin = LowerBound(low);
+    if (high < low) {
+        return IteratorRange(begin, begin);
+    }
+    return IteratorRange(begin, LowerBound(high));
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void BinarySearchTree<Elem, TAllocator, TAugmentation>::FreeNode(Node* node) {
     if (!node) {
         return;
     }
     if (node == root_) {
-        delete root_;
+        allocator_.Free(root_);
         root_ = nullptr;
         return;
     }
@@ -559,11 +891,11 @@ void BinarySearchTree<Elem>::FreeNode(Node* node) {
     node->SetRight(nullptr);
     node->SetParent(nullptr);
     */
-    delete node;
+    allocator_.Free(node);
 }
 
-template<typename Elem>
-void BinarySearchTree<Elem>::DebugPrint() const {
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void BinarySearchTree<Elem, TAllocator, TAugmentation>::DebugPrint() const {
     if (root_) {
         root_->DebugPrint();
     }
@@ -0,0 +1,624 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace algorithms {
+
+// Ordered map shared by many threads, a skip list without locks.
+// Find and iteration are lock-free and write only a counter of active operations;
+// Insert links a new node level by level, each level with a single CAS, replacement
+// of a value exchanges the value of the node.
+//
+// Erase clears the value of the node, which stays erased for good: a later Insert
+// of the key links a new node. The links of an erased node are marked from the top
+// level down, by the eraser or by any search that meets the node, and a marked node
+// is unlinked at a level by the search which passes it there; so a search never goes
+// past an erased node and nodes of a key are never linked twice at a level.
+// An unlinked node is freed by a later modification once the operations which could
+// have reached it have ended; they are counted in two alternating epochs, as in
+// ConcurrentHashMap. A live iterator counts as such an operation, so it holds back
+// the release of nodes erased while it lives.
+//
+// Keys are compared by operator < and are not modified after insertion.
+// The greatest value of TValue is reserved, Insert throws std::invalid_argument on it
+template<typename TKey, typename TValue>
+class ConcurrentSkipList {
+private:
+    struct Node;
+    class OperationGuard;
+
+public:
+    static_assert(std::is_integral<TValue>::value, "ConcurrentSkipList keeps only integral values");
+
+    class Iterator;
+
+    ConcurrentSkipList();
+    ~ConcurrentSkipList();
+
+    ConcurrentSkipList(const ConcurrentSkipList& other) = delete;
+    ConcurrentSkipList& operator = (const ConcurrentSkipList& other) = delete;
+
+    // Returns false if 'key' is absent
+    bool Find(const TKey& key, TValue* value) const;
+    // Inserts the pair or replaces the value of a present key.
+    // Returns true if the key was absent
+    bool Insert(const TKey& key, TValue value);
+    // Returns false if the key was absent
+    bool Erase(const TKey& key);
+
+    // Iterators are weakly consistent: they see every element present during
+    // the whole pass and never a key twice, elements inserted or erased
+    // during the pass may be seen or not
+    Iterator Begin() const;
+    Iterator End() const { return Iterator(); }
+    // First element not less than 'key'
+    Iterator LowerBound(const TKey& key) const;
+
+    // Exact when no modification runs concurrently
+    size_t GetSize() const {
+        long long size = size_.load();
+        return size > 0 ? static_cast<size_t>(size) : 0;
+    }
+    // Bytes occupied by the map, including erased nodes not released yet
+    size_t GetMemoryUsage() const {
+        return sizeof(*this) + memory_usage_.load();
+    }
+
+    static const int MAX_HEIGHT = 32;
+
+private:
+    // Threads are spread over this many counters of active operations
+    static const size_t OPERATION_COUNTERS_COUNT = 32;
+    static const size_t CACHE_LINE_SIZE = 64;
+
+    struct OperationCounter {
+        std::atomic<long long> count;
+        char padding[CACHE_LINE_SIZE - sizeof(std::atomic<long long>)];
+    };
+
+    // Keeps the nodes reachable at its creation from being freed while it lives.
+    // Copies are counted in the same epoch
+    class OperationGuard {
+    public:
+        OperationGuard() :
+            counter_(nullptr) {}
+        explicit OperationGuard(const ConcurrentSkipList* list);
+        ~OperationGuard() {
+            Reset();
+        }
+
+        OperationGuard(const OperationGuard& other) :
+            counter_(other.counter_) {
+            if (counter_ != nullptr) {
+                counter_->fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        OperationGuard(OperationGuard&& other) :
+            counter_(other.counter_) {
+            other.counter_ = nullptr;
+        }
+        OperationGuard& operator = (OperationGuard other) {
+            std::swap(counter_, other.counter_);
+            return *this;
+        }
+
+        void Reset() {
+            if (counter_ != nullptr) {
+                counter_->fetch_sub(1, std::memory_order_release);
+                counter_ = nullptr;
+            }
+        }
+
+    private:
+        std::atomic<long long>* counter_;
+    };
+
+public:
+    class Iterator {
+    public:
+        Iterator() :
+            node_(nullptr),
+            value_(NULL_VALUE) {}
+
+        const TKey& GetKey() const { return node_->key; }
+        // Value read when the iterator came to the element
+        TValue GetValue() const { return value_; }
+
+        Iterator& operator ++ () {
+            const Node* previous = node_;
+            node_ = GetNode(node_->GetNext()[0].load(std::memory_order_acquire));
+            SkipErased(previous);
+            return *this;
+        }
+
+        bool operator == (const Iterator& other) const { return node_ == other.node_; }
+        bool operator != (const Iterator& other) const { return node_ != other.node_; }
+
+    private:
+        friend class ConcurrentSkipList;
+
+        Iterator(const Node* node, OperationGuard&& guard) :
+            node_(node),
+            value_(NULL_VALUE),
+            guard_(std::move(guard)) {
+            SkipErased(nullptr);
+        }
+
+        // Skips erased nodes and nodes of keys not greater than the key of 'previous':
+        // a key erased and inserted again after the iterator passed it has a newer node further on
+        void SkipErased(const Node* previous) {
+            while (node_) {
+                value_ = node_->value.load(std::memory_order_acquire);
+                if (value_ != NULL_VALUE && (previous == nullptr || previous->key < node_->key)) {
+                    return;
+                }
+                node_ = GetNode(node_->GetNext()[0].load(std::memory_order_acquire));
+            }
+            // an iterator at the end keeps no nodes
+            guard_.Reset();
+        }
+
+        const Node* node_;
+        TValue value_;
+        OperationGuard guard_;
+    };
+
+private:
+    static const TValue NULL_VALUE = std::numeric_limits<TValue>::max();
+
+    // Pointer to the next node; the lowest bit is set once the node holding the link is erased
+    typedef std::atomic<uintptr_t> Link;
+    static const uintptr_t MARK = 1;
+
+    enum NodeState {
+        // the inserter does not link the node any more
+        NODE_LINKED = 1,
+        // the links of the node are marked
+        NODE_ERASED = 2
+    };
+
+    // A node of height h is followed in memory by its tower of h links,
+    // link i leads to the next node of height greater than i
+    struct alignas(Link) Node {
+        Node(const TKey& key, TValue value, int height) :
+            key(key),
+            value(value),
+            state(0),
+            height(height),
+            next_retired(nullptr) {}
+
+        Link* GetNext() { return reinterpret_cast<Link*>(this + 1); }
+        const Link* GetNext() const { return reinterpret_cast<const Link*>(this + 1); }
+
+        const TKey key;
+        std::atomic<TValue> value;
+        // NodeState flags; the thread which sets the second one unlinks the node
+        std::atomic<int> state;
+        const int height;
+        // Next node unlinked and waiting to be freed
+        Node* next_retired;
+    };
+
+    static Node* GetNode(uintptr_t link) { return reinterpret_cast<Node*>(link & ~MARK); }
+    static uintptr_t MakeLink(const Node* node) { return reinterpret_cast<uintptr_t>(node); }
+    static bool IsMarked(uintptr_t link) { return (link & MARK) != 0; }
+
+    static size_t CountNodeMemory(int height) { return sizeof(Node) + height * sizeof(Link); }
+    Node* CreateNode(const TKey& key, TValue value, int height);
+    void DestroyNode(Node* node);
+    // Destroys a chain of unlinked nodes
+    void DestroyRetiredNodes(Node* node);
+    // Height with probability 2^-height, drawn by a generator of the calling thread.
+    // Towers growing with probability 1/4 take less memory but make searches slower:
+    // the number of nodes visited is about the same, fewer of them are visited twice
+    // at neighbouring levels, so more of them miss the cache
+    static int CountRandomHeight();
+
+    // Marks the links of an erased node, so that nothing is linked after it any more
+    static void MarkTower(Node* node);
+    // Fills towers whose link 'level' is the last one before 'key', for levels below 'height',
+    // and the nodes they lead to, unlinking erased nodes on the way.
+    // Returns the node of 'key' if it is present
+    Node* FindPosition(const TKey& key, int height, Link** predecessors, Node** successors);
+    // First node not less than 'key', it may be erased
+    const Node* FindLowerBound(const TKey& key) const;
+    // First node of 'key' which is not erased
+    const Node* FindPresent(const TKey& key) const;
+
+    // Unlinks an erased node which is not linked by its inserter any more
+    // and passes it to ReleaseErasedNodes
+    void Unlink(Node* node);
+    // Frees the unlinked nodes which no running operation can reach;
+    // does nothing if another thread is releasing nodes
+    void ReleaseErasedNodes();
+    static size_t GetCounterIndex();
+    long long CountOperations(size_t epoch) const;
+
+    // Links of the head, which precedes all nodes
+    Link head_[MAX_HEIGHT];
+    // Greatest height of inserted nodes, searches start from it
+    std::atomic<int> height_;
+    // Erasure may be counted before the insertion of the same key, so the counter is signed
+    std::atomic<long long> size_;
+    std::atomic<size_t> memory_usage_;
+
+    // Operations are counted in operation_counters_[epoch_ % 2]
+    std::atomic<size_t> epoch_;
+    mutable OperationCounter operation_counters_[2][OPERATION_COUNTERS_COUNT];
+    // Unlinked nodes, chained through 'next_retired'
+    std::atomic<Node*> retired_;
+    // Unlinked nodes taken from 'retired_' when the epoch was switched, they are freed
+    // when the operations of the previous epoch end. Changed only by the releasing thread
+    std::atomic<Node*> releasing_nodes_;
+    std::atomic<bool> releasing_;
+};
+
+template<typename TKey, typename TValue>
+ConcurrentSkipList<TKey, TValue>::OperationGuard::OperationGuard(const ConcurrentSkipList* list) {
+    size_t counter_index = GetCounterIndex();
+    while (true) {
+        size_t epoch = list->epoch_.load();
+        counter_ = &list->operation_counters_[epoch % 2][counter_index].count;
+        counter_->fetch_add(1);
+        // nodes unlinked before the epoch was switched are not reached from the head any more
+        if (list->epoch_.load() == epoch) {
+            return;
+        }
+        counter_->fetch_sub(1);
+    }
+}
+
+template<typename TKey, typename TValue>
+ConcurrentSkipList<TKey, TValue>::ConcurrentSkipList() :
+    height_(1),
+    size_(0),
+    memory_usage_(0),
+    epoch_(0),
+    retired_(nullptr),
+    releasing_nodes_(nullptr),
+    releasing_(false) {
+    for (int level = 0; level != MAX_HEIGHT; ++level) {
+        head_[level].store(0, std::memory_order_relaxed);
+    }
+    for (size_t epoch = 0; epoch != 2; ++epoch) {
+        for (size_t index = 0; index != OPERATION_COUNTERS_COUNT; ++index) {
+            operation_counters_[epoch][index].count.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+template<typename TKey, typename TValue>
+ConcurrentSkipList<TKey, TValue>::~ConcurrentSkipList() {
+    Node* node = GetNode(head_[0].load());
+    while (node != nullptr) {
+        Node* next = GetNode(node->GetNext()[0].load());
+        DestroyNode(node);
+        node = next;
+    }
+    DestroyRetiredNodes(retired_.load());
+    DestroyRetiredNodes(releasing_nodes_.load());
+}
+
+template<typename TKey, typename TValue>
+typename ConcurrentSkipList<TKey, TValue>::Node* ConcurrentSkipList<TKey, TValue>::CreateNode
+        (const TKey& key, TValue value, int height) {
+    void* memory = ::operator new(CountNodeMemory(height));
+    Node* node = new (memory) Node(key, value, height);
+    for (int level = 0; level != height; ++level) {
+        new (&node->GetNext()[level]) Link(0);
+    }
+    memory_usage_.fetch_add(CountNodeMemory(height), std::memory_order_relaxed);
+    return node;
+}
+
+template<typename TKey, typename TValue>
+void ConcurrentSkipList<TKey, TValue>::DestroyNode(Node* node) {
+    memory_usage_.fetch_sub(CountNodeMemory(node->height), std::memory_order_relaxed);
+    // links are trivially destructible
+    node->~Node();
+    ::operator delete(node);
+}
+
+template<typename TKey, typename TValue>
+void ConcurrentSkipList<TKey, TValue>::DestroyRetiredNodes(Node* node) {
+    while (node != nullptr) {
+        Node* next = node->next_retired;
+        DestroyNode(node);
+        node = next;
+    }
+}
+
+template<typename TKey, typename TValue>
+int ConcurrentSkipList<TKey, TValue>::CountRandomHeight() {
+    static thread_local std::mt19937 generator(
+        static_cast<unsigned>(std::hash<std::thread::id>()(std::this_thread::get_id())));
+    // every random bit continues the tower with probability 1/2
+    uint32_t bits = static_cast<uint32_t>(generator());
+    int height = 1;
+    while (height < MAX_HEIGHT && (bits & 1) == 0) {
+        ++height;
+        bits >>= 1;
+    }
+    return height;
+}
+
+template<typename TKey, typename TValue>
+size_t ConcurrentSkipList<TKey, TValue>::GetCounterIndex() {
+    static thread_local const size_t index =
+        std::hash<std::thread::id>()(std::this_thread::get_id()) % OPERATION_COUNTERS_COUNT;
+    return index;
+}
+
+template<typename TKey, typename TValue>
+long long ConcurrentSkipList<TKey, TValue>::CountOperations(size_t epoch) const {
+    long long count = 0;
+    for (size_t index = 0; index != OPERATION_COUNTERS_COUNT; ++index) {
+        count += operation_counters_[epoch % 2][index].count.load();
+    }
+    return count;
+}
+
+template<typename TKey, typename TValue>
+typename ConcurrentSkipList<TKey, TValue>::Node* ConcurrentSkipList<TKey, TValue>::FindPosition
+        (const TKey& key, int height, Link** predecessors, Node** successors) {
+    int top = height_.load(std::memory_order_relaxed);
+    if (top < height) {
+        top = height;
+    }
+    while (true) {
+        Link* tower = head_;
+        Node* next = nullptr;
+        bool restart = false;
+        for (int level = top - 1; level >= 0 && !restart; --level) {
+            next = GetNode(tower[level].load(std::memory_order_acquire));
+            while (next != nullptr) {
+                uintptr_t after = next->GetNext()[level].load(std::memory_order_acquire);
+                if (!IsMarked(after) && next->value.load(std::memory_order_acquire) == NULL_VALUE) {
+                    MarkTower(next);
+                    after = next->GetNext()[level].load(std::memory_order_acquire);
+                }
+                if (IsMarked(after)) {
+                    // Fails if the tower is marked itself or leads elsewhere by now,
+                    // then the search starts again from the head
+                    uintptr_t expected = MakeLink(next);
+                    if (!tower[level].compare_exchange_strong(expected, after & ~MARK)) {
+                        restart = true;
+                        break;
+                    }
+                    next = GetNode(after);
+                    continue;
+                }
+                if (!(next->key < key)) {
+                    break;
+                }
+                tower = next->GetNext();
+                next = GetNode(after);
+            }
+            if (level < height) {
+                predecessors[level] = tower;
+                successors[level] = next;
+            }
+        }
+        if (restart) {
+            continue;
+        }
+        if (next != nullptr && !(key < next->key)) {
+            return next;
+        }
+        return nullptr;
+    }
+}
+
+template<typename TKey, typename TValue>
+const typename ConcurrentSkipList<TKey, TValue>::Node* ConcurrentSkipList<TKey, TValue>::FindLowerBound
+        (const TKey& key) const {
+    const Link* tower = head_;
+    const Node* next = nullptr;
+    for (int level = height_.load(std::memory_order_relaxed) - 1; level >= 0; --level) {
+        next = GetNode(tower[level].load(std::memory_order_acquire));
+        while (next != nullptr && next->key < key) {
+            tower = next->GetNext();
+            next = GetNode(tower[level].load(std::memory_order_acquire));
+        }
+    }
+    return next;
+}
+
+template<typename TKey, typename TValue>
+const typename ConcurrentSkipList<TKey, TValue>::Node* ConcurrentSkipList<TKey, TValue>::FindPresent
+        (const TKey& key) const {
+    const Node* node = FindLowerBound(key);
+    while (node != nullptr && !(key < node->key)) {
+        if (node->value.load(std::memory_order_acquire) != NULL_VALUE) {
+            return node;
+        }
+        node = GetNode(node->GetNext()[0].load(std::memory_order_acquire));
+    }
+    return nullptr;
+}
+
+template<typename TKey, typename TValue>
+bool ConcurrentSkipList<TKey, TValue>::Find(const TKey& key, TValue* value) const {
+    OperationGuard guard(this);
+    const Node* node = FindPresent(key);
+    if (node == nullptr) {
+        return false;
+    }
+    TValue node_value = node->value.load(std::memory_order_acquire);
+    if (node_value == NULL_VALUE) {
+        return false;
+    }
+    *value = node_value;
+    return true;
+}
+
+template<typename TKey, typename TValue>
+bool ConcurrentSkipList<TKey, TValue>::Insert(const TKey& key, TValue value) {
+    if (value == NULL_VALUE) {
+        throw std::invalid_argument("The greatest value is reserved by ConcurrentSkipList\n");
+    }
+    ReleaseErasedNodes();
+    OperationGuard guard(this);
+
+    Link* predecessors[MAX_HEIGHT];
+    Node* successors[MAX_HEIGHT];
+    Node* node = nullptr;
+    int height = CountRandomHeight();
+    while (true) {
+        Node* found = FindPosition(key, height, predecessors, successors);
+        if (found != nullptr) {
+            // another thread has linked the key since the last search
+            TValue found_value = found->value.load();
+            while (found_value != NULL_VALUE) {
+                if (found->value.compare_exchange_weak(found_value, value)) {
+                    if (node != nullptr) {
+                        DestroyNode(node);
+                    }
+                    return false;
+                }
+            }
+            // erased meanwhile, the next search passes the node
+            continue;
+        }
+        if (node == nullptr) {
+            node = CreateNode(key, value, height);
+        }
+        for (int level = 0; level != height; ++level) {
+            node->GetNext()[level].store(MakeLink(successors[level]), std::memory_order_relaxed);
+        }
+        // the node is in the map once it is linked at the lowest level
+        uintptr_t expected = MakeLink(successors[0]);
+        if (predecessors[0][0].compare_exchange_strong(expected, MakeLink(node))) {
+            break;
+        }
+    }
+    size_.fetch_add(1);
+
+    int max_height = height_.load(std::memory_order_relaxed);
+    while (max_height < height && !height_.compare_exchange_weak(max_height, height)) {}
+
+    // Higher links are only shortcuts; a level which changed since the search is searched again.
+    // Once the node is erased its links are marked and the remaining levels are not linked
+    for (int level = 1; level != height; ++level) {
+        bool linked = false;
+        while (!linked) {
+            uintptr_t next = node->GetNext()[level].load();
+            if (IsMarked(next)) {
+                break;
+            }
+            uintptr_t successor = MakeLink(successors[level]);
+            if (next != successor && !node->GetNext()[level].compare_exchange_strong(next, successor)) {
+                continue;
+            }
+            linked = predecessors[level][level].compare_exchange_strong(successor, MakeLink(node));
+            if (!linked) {
+                FindPosition(key, height, predecessors, successors);
+            }
+        }
+        if (!linked) {
+            break;
+        }
+    }
+    // a level linked after the eraser unlinked the node is unlinked by this thread
+    if (node->state.fetch_or(NODE_LINKED) & NODE_ERASED) {
+        Unlink(node);
+    }
+    return true;
+}
+
+template<typename TKey, typename TValue>
+bool ConcurrentSkipList<TKey, TValue>::Erase(const TKey& key) {
+    ReleaseErasedNodes();
+    OperationGuard guard(this);
+    while (true) {
+        Node* node = const_cast<Node*>(FindPresent(key));
+        if (node == nullptr) {
+            return false;
+        }
+        TValue value = node->value.load();
+        while (value != NULL_VALUE) {
+            if (node->value.compare_exchange_weak(value, NULL_VALUE)) {
+                size_.fetch_sub(1);
+                MarkTower(node);
+                // the node is unlinked here or by its inserter when it stops linking the node
+                if (node->state.fetch_or(NODE_ERASED) & NODE_LINKED) {
+                    Unlink(node);
+                }
+                return true;
+            }
+        }
+        // erased by another thread, the key may have been inserted again
+    }
+}
+
+template<typename TKey, typename TValue>
+void ConcurrentSkipList<TKey, TValue>::MarkTower(Node* node) {
+    for (int level = node->height - 1; level >= 0; --level) {
+        node->GetNext()[level].fetch_or(MARK);
+    }
+}
+
+template<typename TKey, typename TValue>
+void ConcurrentSkipList<TKey, TValue>::Unlink(Node* node) {
+    // At every level the search passes only nodes of smaller keys and stops at a node
+    // of a greater key or at the node inserted after this one was erased, which
+    // is linked after this one, so the search meets this node wherever it is linked
+    Link* predecessors[MAX_HEIGHT];
+    Node* successors[MAX_HEIGHT];
+    FindPosition(node->key, node->height, predecessors, successors);
+
+    Node* retired = retired_.load(std::memory_order_relaxed);
+    do {
+        node->next_retired = retired;
+    } while (!retired_.compare_exchange_weak(retired, node, std::memory_order_release,
+                                             std::memory_order_relaxed));
+}
+
+template<typename TKey, typename TValue>
+void ConcurrentSkipList<TKey, TValue>::ReleaseErasedNodes() {
+    if ((retired_.load(std::memory_order_relaxed) == nullptr &&
+                releasing_nodes_.load(std::memory_order_relaxed) == nullptr) ||
+            releasing_.exchange(true, std::memory_order_acquire)) {
+        return;
+    }
+    if (releasing_nodes_.load(std::memory_order_relaxed) == nullptr) {
+        Node* retired = retired_.exchange(nullptr, std::memory_order_acquire);
+        if (retired != nullptr) {
+            // only operations counted in the current epoch may still hold these nodes
+            releasing_nodes_.store(retired, std::memory_order_relaxed);
+            epoch_.fetch_add(1);
+        }
+    }
+    // The epoch is switched again only after the nodes are freed, so an operation
+    // which saw an older epoch has ended or counts itself in the current one
+    Node* releasing = releasing_nodes_.load(std::memory_order_relaxed);
+    if (releasing != nullptr && CountOperations(epoch_.load() - 1) == 0) {
+        DestroyRetiredNodes(releasing);
+        releasing_nodes_.store(nullptr, std::memory_order_relaxed);
+    }
+    releasing_.store(false, std::memory_order_release);
+}
+
+template<typename TKey, typename TValue>
+typename ConcurrentSkipList<TKey, TValue>::Iterator ConcurrentSkipList<TKey, TValue>::Begin() const {
+    OperationGuard guard(this);
+    return Iterator(GetNode(head_[0].load(std::memory_order_acquire)), std::move(guard));
+}
+
+template<typename TKey, typename TValue>
+typename ConcurrentSkipList<TKey, TValue>::Iterator ConcurrentSkipList<TKey, TValue>::LowerBound(const TKey& key) const {
+    OperationGuard guard(this);
+    return Iterator(FindLowerBound(key), std::move(guard));
+}
+
+} // namespace algorithms
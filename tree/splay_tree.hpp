@@ -1,51 +1,169 @@
 #pragma once
 
+#include <stdexcept>
+#include <vector>
+
 #include "tree/binary_search_tree.hpp"
 
 namespace algorithms {
 
-template<typename Elem>
-class SplayTree : public BinarySearchTree<Elem> {
+template<typename Elem, template<typename> class TAllocator = NodePool, typename TAugmentation = NoAugmentation>
+class SplayTree : public BinarySearchTree<Elem, TAllocator, TAugmentation> {
 public:
-    typedef typename BinarySearchTree<Elem>::Node Node;
-
-    SplayTree() : BinarySearchTree<Elem>() {}
-    SplayTree(Node* node) : BinarySearchTree<Elem>(node) {}
+    typedef typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Node Node;
 
+    SplayTree() : BinarySearchTree<Elem, TAllocator, TAugmentation>() {}
 
+    // Search, Insert and Delete splay top-down: one iterative pass looks for the element
+    // and restructures the tree, so degenerate trees after sorted insertions do not
+    // overflow the stack and accessing all elements in order takes O(n)
     virtual Node* Search(const Elem& elem) {
-        Node* found = BinarySearchTree<Elem>::Search(elem);
-        found = Splay(found);
-        return found;
+        Node* root = SplayTopDown(elem);
+        if (!root || !(root->GetData() == elem)) {
+            return nullptr;
+        }
+        return root;
     }
 
     virtual Node* Insert(const Elem& elem) {
-        Node* inserted = BinarySearchTree<Elem>::Insert(elem);
-        inserted = Splay(inserted);
+        Node* root = SplayTopDown(elem);
+        if (root && root->GetData() == elem) {
+            return root;
+        }
+        Node* inserted = this->AddNode(elem);
+        // the root is the neighbour of 'elem', the new node takes its place
+        if (root) {
+            if (elem < root->GetData()) {
+                Node* left = root->GetLeft();
+                root->SetLeft(nullptr);
+                inserted->SetLeft(left);
+                inserted->SetRight(root);
+            } else {
+                Node* right = root->GetRight();
+                root->SetRight(nullptr);
+                inserted->SetLeft(root);
+                inserted->SetRight(right);
+            }
+            root->UpdateAugmentation();
+            inserted->UpdateAugmentation();
+        }
+        this->root_ = inserted;
         return inserted;
     }
 
+    // Order statistics splay the last node they visit, which keeps them
+    // amortized O(log n) like other accesses
+    typename BinarySearchTree<Elem, TAllocator, TAugmentation>::Iterator Select(size_t index) {
+        if (index >= this->GetSize()) {
+            Splay(this->root_ ? FindMax() : nullptr);
+            return this->End();
+        }
+        auto found = BinarySearchTree<Elem, TAllocator, TAugmentation>::Select(index);
+        Splay(const_cast<Node*>(found.GetNode()));
+        return found;
+    }
+
+    size_t Rank(const Elem& elem) {
+        Node* last = SplayTopDown(elem);
+        if (!last) {
+            return 0;
+        }
+        // the last node of the search is the neighbour of 'elem' from one side
+        return this->GetSize(last->GetLeft()) + (last->GetData() < elem ? 1 : 0);
+    }
+
+    typename BinarySearchTree<Elem, TAllocator, TAugmentation>::AggregateValue
+    RangeAggregate(const Elem& low, const Elem& high) {
+        auto aggregate = BinarySearchTree<Elem, TAllocator, TAugmentation>::RangeAggregate(low, high);
+        SplayTopDown(high);
+        SplayTopDown(low);
+        return aggregate;
+    }
+
     virtual void Delete(const Elem& elem) {
-        Node* to_delete = BinarySearchTree<Elem>::Search(elem);
-        if (!to_delete) {
+        Node* to_delete = SplayTopDown(elem);
+        if (!to_delete || !(to_delete->GetData() == elem)) {
             return;
         }
-        to_delete = Splay(to_delete);
-        SplayTree<Elem> left_tree(to_delete->GetLeft());
-        SplayTree<Elem> right_tree(to_delete->GetRight());
-
-        SplayTree<Elem> new_tree = Merge(std::move(left_tree), std::move(right_tree));
+        Node* left = to_delete->GetLeft();
+        Node* right = to_delete->GetRight();
 
-        BinarySearchTree<Elem>::FreeNode(this->root_);
-        *this = std::move(new_tree);
+        // the subtrees stay in this tree, so their nodes stay with its allocator
+        if (right) {
+            right->SetParent(nullptr);
+        }
+        if (!left) {
+            this->root_ = right;
+        } else {
+            left->SetParent(nullptr);
+            this->root_ = left;
+            // All elements of the left subtree are less than 'elem', so its maximum comes up.
+            // 'elem' may be the data of the deleted node, so it is freed afterwards
+            Node* max = SplayTopDown(elem);
+            assert(!max->GetRight());
+            max->SetRight(right);
+            max->UpdateAugmentation();
+        }
+        // the node is already detached, its old links lead into the new tree
+        this->allocator_.Free(to_delete);
     }
 
 public:
-    // Move x to the root, performing rotations
+    // Move x to the root, performing rotations bottom-up
     Node* Splay(Node* x) {
-        if (!x || x == this->root_) {
+        if (!x) {
             return x;
-        } else if (x->GetParent() == this->root_) { // zig
+        }
+        while (x != this->root_) {
+            SplayStep(x);
+        }
+        return this->root_;
+    }
+
+    // Moves the last node on the way of a search for 'elem' to the root
+    // and returns it, nullptr in an empty tree
+    Node* SplayTopDown(const Elem& elem);
+
+    Node* FindMax() {
+        Node* max = this->root_;
+        while (max->GetRight()) {
+            max = max->GetRight();
+        }
+        return max;
+    }
+
+    // Moves elements not less than 'elem' to 'right', replacing its previous content;
+    // this tree keeps the ones less than 'elem'. The trees share the nodes of the allocator,
+    // so it has to be one whose copies share their nodes, as SharedNodePool or NewDeleteAllocator
+    void Split(const Elem& elem, SplayTree* right);
+    // Appends all elements of 'right', which have to be greater than the ones of this tree,
+    // and takes over the nodes of its allocator.
+    // Throws std::invalid_argument if the elements of the trees overlap
+    void Join(SplayTree&& right);
+    // Removes elements in [low, high): the range is split off and freed,
+    // taking O(log n) amortized and O(1) for every removed element
+    void EraseRange(const Elem& low, const Elem& high);
+
+    // Joins trees whose elements in 'left' are all less than the ones in 'right';
+    // the result takes over the nodes of both allocators
+    static SplayTree Merge(SplayTree&& left, SplayTree&& right) {
+        left.Join(std::move(right));
+        return std::move(left);
+    }
+
+private:
+    // Detaches the elements not less than 'elem' and returns the root of their subtree
+    Node* SplitOff(const Elem& elem);
+    // Hangs a subtree of elements greater than the ones of this tree under its maximum
+    void Append(Node* subtree);
+    // Frees a detached subtree breadth-first with a queue of its nodes. Children are
+    // prefetched when they are queued, so cache misses of a level overlap
+    // instead of following each other
+    void FreeSubtree(Node* root);
+
+    // One zig, zig-zig or zig-zag step lifting x by one or two levels
+    void SplayStep(Node* x) {
+        if (x->GetParent() == this->root_) { // zig
             Node* prev_root = this->root_;
 
             if (this->root_->GetLeft() == x) { // left-hand
@@ -57,8 +175,11 @@ public:
                 prev_root->SetRight(gamma);
 
                 this->root_ = x;
+                this->root_->SetParent(nullptr);
                 this->root_->SetLeft(alpha);
                 this->root_->SetRight(prev_root);
+                prev_root->UpdateAugmentation();
+                x->UpdateAugmentation();
             } else {
                 Node* alpha = this->root_->GetLeft();
                 Node* beta = x->GetLeft();
@@ -68,24 +189,26 @@ public:
                 prev_root->SetRight(beta);
 
                 this->root_ = x;
+                this->root_->SetParent(nullptr);
                 this->root_->SetLeft(prev_root);
                 this->root_->SetRight(gamma);
+                prev_root->UpdateAugmentation();
+                x->UpdateAugmentation();
             }
         } else {
             Node* parent = x->GetParent();
             Node* parent_parent = parent->GetParent();
             Node* prev_root = parent_parent->GetParent();
 
+            // x takes the place of its grandparent under 'prev_root'
             auto move_to_root = [&]() {
                 if (parent_parent == this->root_) {
                     this->root_ = x;
                     this->root_->SetParent(nullptr);
                 } else if (prev_root->GetLeft() == parent_parent) {
                     prev_root->SetLeft(x);
-                    Splay(x);
                 } else if (prev_root->GetRight() == parent_parent) {
                     prev_root->SetRight(x);
-                    Splay(x);
                 }
             };
 
@@ -99,6 +222,9 @@ public:
                 parent->SetRight(parent_parent);
                 parent_parent->SetLeft(gamma);
                 parent_parent->SetRight(delta);
+                parent_parent->UpdateAugmentation();
+                parent->UpdateAugmentation();
+                x->UpdateAugmentation();
 
                 move_to_root();
             } else if (parent_parent->GetRight() == parent && parent->GetRight() == x) { // zig-zig right-hand
@@ -111,6 +237,9 @@ public:
                 parent->SetRight(gamma);
                 x->SetLeft(parent);
                 x->SetRight(delta);
+                parent_parent->UpdateAugmentation();
+                parent->UpdateAugmentation();
+                x->UpdateAugmentation();
 
                 move_to_root();
             } else if (parent_parent->GetLeft() == parent && parent->GetRight() == x) { // zig-zag left-hand
@@ -125,6 +254,9 @@ public:
                 parent_parent->SetRight(delta);
                 x->SetLeft(parent);
                 x->SetRight(parent_parent);
+                parent->UpdateAugmentation();
+                parent_parent->UpdateAugmentation();
+                x->UpdateAugmentation();
 
                 move_to_root();
             } else { // zig-zag right-hand
@@ -135,39 +267,203 @@ public:
                 parent->SetLeft(gamma);
                 x->SetLeft(parent_parent);
                 x->SetRight(parent);
+                parent->UpdateAugmentation();
+                parent_parent->UpdateAugmentation();
+                x->UpdateAugmentation();
 
                 move_to_root();
             }
         }
-        return this->root_;
     }
+};
 
-    Node* FindMax() {
-        Node* max = this->root_;
-        while (max->GetRight()) {
-            max = max->GetRight();
-        }
-        return max;
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename SplayTree<Elem, TAllocator, TAugmentation>::Node* SplayTree<Elem, TAllocator, TAugmentation>::SplayTopDown(const Elem& elem) {
+    Node* current = this->root_;
+    if (!current) {
+        return nullptr;
     }
-
-    SplayTree<Elem> Merge(SplayTree<Elem>&& left, SplayTree<Elem>&& right) {
-        if (!left.GetRoot()) {
-            return std::move(right);
+    // nodes less than 'elem' are gathered into the left tree along its right spine,
+    // greater ones into the right tree along its left spine
+    Node* left_root = nullptr;
+    Node* left_max = nullptr;
+    Node* right_root = nullptr;
+    Node* right_min = nullptr;
+    while (true) {
+        if (elem < current->GetData()) {
+            Node* child = current->GetLeft();
+            if (!child) {
+                break;
+            }
+            if (elem < child->GetData()) { // zig-zig: rotate right
+                current->SetLeft(child->GetRight());
+                child->SetRight(current);
+                current->UpdateAugmentation();
+                current = child;
+                if (!current->GetLeft()) {
+                    break;
+                }
+            }
+            if (right_min) {
+                right_min->SetLeft(current);
+            } else {
+                right_root = current;
+            }
+            right_min = current;
+            current = current->GetLeft();
+        } else if (current->GetData() < elem) {
+            Node* child = current->GetRight();
+            if (!child) {
+                break;
+            }
+            if (child->GetData() < elem) { // zig-zig: rotate left
+                current->SetRight(child->GetLeft());
+                child->SetLeft(current);
+                current->UpdateAugmentation();
+                current = child;
+                if (!current->GetRight()) {
+                    break;
+                }
+            }
+            if (left_max) {
+                left_max->SetRight(current);
+            } else {
+                left_root = current;
+            }
+            left_max = current;
+            current = current->GetRight();
         } else {
-            Node* max = left.FindMax();
-            left.Splay(max);
-            assert(!max->GetRight());
-            Node* right_node = right.GetRoot();
-            max->SetRight(right_node);
+            break;
+        }
+    }
 
-            right.root_ = nullptr;
-            left.root_ = nullptr;
+    // subtrees of the found node go to the ends of the spines, which hang under it
+    if (left_max) {
+        left_max->SetRight(current->GetLeft());
+        current->SetLeft(left_root);
+    }
+    if (right_min) {
+        right_min->SetLeft(current->GetRight());
+        current->SetRight(right_root);
+    }
+    current->SetParent(nullptr);
+    this->root_ = current;
 
-            SplayTree<Elem> result(max);
-            return std::move(result);
+    // spine nodes got their final children only now, they are updated bottom-up
+    if (TAugmentation::ENABLED) {
+        for (Node* node = left_max; node && node != current; node = node->GetParent()) {
+            node->UpdateAugmentation();
+        }
+        for (Node* node = right_min; node && node != current; node = node->GetParent()) {
+            node->UpdateAugmentation();
         }
+        current->UpdateAugmentation();
     }
-};
-
+    return current;
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+typename SplayTree<Elem, TAllocator, TAugmentation>::Node* SplayTree<Elem, TAllocator, TAugmentation>::SplitOff(const Elem& elem) {
+    Node* root = SplayTopDown(elem);
+    if (!root) {
+        return nullptr;
+    }
+    // the root is a neighbour of 'elem', the split goes along one of its sides
+    Node* upper;
+    if (root->GetData() < elem) {
+        upper = root->GetRight();
+        root->SetRight(nullptr);
+    } else {
+        upper = root;
+        this->root_ = root->GetLeft();
+        root->SetLeft(nullptr);
+        if (this->root_) {
+            this->root_->SetParent(nullptr);
+        }
+    }
+    root->UpdateAugmentation();
+    if (upper) {
+        upper->SetParent(nullptr);
+    }
+    return upper;
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void SplayTree<Elem, TAllocator, TAugmentation>::Append(Node* subtree) {
+    if (!this->root_) {
+        this->root_ = subtree;
+        return;
+    }
+    Node* max = Splay(FindMax());
+    assert(!max->GetRight());
+    max->SetRight(subtree);
+    max->UpdateAugmentation();
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void SplayTree<Elem, TAllocator, TAugmentation>::FreeSubtree(Node* root) {
+    if (!root) {
+        return;
+    }
+    std::vector<Node*> queue(1, root);
+    for (size_t index = 0; index != queue.size(); ++index) {
+        Node* node = queue[index];
+        for (Node* child : {node->GetLeft(), node->GetRight()}) {
+            if (child) {
+#if defined(__GNUC__)
+                __builtin_prefetch(child);
+#endif
+                queue.push_back(child);
+            }
+        }
+        this->allocator_.Free(node);
+    }
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void SplayTree<Elem, TAllocator, TAugmentation>::Split(const Elem& elem, SplayTree* right) {
+    static_assert(std::is_copy_assignable<TAllocator<Node> >::value,
+                  "Split trees share nodes, copies of the allocator have to share them too");
+    if (right == this) {
+        return;
+    }
+    if (right->root_) {
+        right->FreeTree(right->root_);
+    }
+    right->allocator_ = this->allocator_;
+    right->root_ = SplitOff(elem);
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void SplayTree<Elem, TAllocator, TAugmentation>::Join(SplayTree&& right) {
+    if (&right == this || !right.root_) {
+        return;
+    }
+    if (this->root_) {
+        const Node* max = Splay(FindMax());
+        const Node* min = right.Splay(const_cast<Node*>(this->GetMin(right.root_)));
+        if (!(max->GetData() < min->GetData())) {
+            throw std::invalid_argument("Joined splay trees overlap\n");
+        }
+    }
+    Append(right.root_);
+    right.root_ = nullptr;
+    this->allocator_.Splice(&right.allocator_);
+}
+
+template<typename Elem, template<typename> class TAllocator, typename TAugmentation>
+void SplayTree<Elem, TAllocator, TAugmentation>::EraseRange(const Elem& low, const Elem& high) {
+    if (!(low < high)) {
+        return;
+    }
+    Node* upper = SplitOff(low);
+    Node* lower = this->root_;
+    this->root_ = upper;
+    Node* rest = SplitOff(high);
+    Node* range = this->root_;
+    this->root_ = lower;
+    Append(rest);
+    FreeSubtree(range);
+}
 
 } // namespace algorithms
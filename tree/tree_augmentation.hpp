@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+
+namespace algorithms {
+
+// Augmentations are policies of BinarySearchTree and its subclasses: every node
+// inherits Data<Elem> of the policy, which the tree recomputes by Update
+// from the element and the data of the children whenever the subtree changes
+
+// Monoids for OrderStatistics: Value, Identity(), Make(elem) turning an element
+// into a value and an associative Combine(left, right)
+struct EmptyMonoid {
+    struct Value {};
+
+    static Value Identity() { return Value(); }
+    template<typename Elem>
+    static Value Make(const Elem&) { return Value(); }
+    static Value Combine(const Value&, const Value&) { return Value(); }
+};
+
+template<typename T>
+struct SumMonoid {
+    typedef T Value;
+
+    static Value Identity() { return T(); }
+    static Value Make(const T& elem) { return elem; }
+    static Value Combine(const Value& left, const Value& right) { return left + right; }
+};
+
+template<typename T>
+struct MinMonoid {
+    typedef T Value;
+
+    static Value Identity() { return std::numeric_limits<T>::max(); }
+    static Value Make(const T& elem) { return elem; }
+    static Value Combine(const Value& left, const Value& right) { return right < left ? right : left; }
+};
+
+template<typename T>
+struct MaxMonoid {
+    typedef T Value;
+
+    static Value Identity() { return std::numeric_limits<T>::lowest(); }
+    static Value Make(const T& elem) { return elem; }
+    static Value Combine(const Value& left, const Value& right) { return left < right ? right : left; }
+};
+
+// Keeps nothing; nodes do not grow and trees skip the updates
+struct NoAugmentation {
+    static const bool ENABLED = false;
+
+    typedef EmptyMonoid Monoid;
+
+    template<typename Elem>
+    struct Data {
+        void Update(const Elem&, const Data*, const Data*) {}
+    };
+};
+
+// Keeps the number of nodes of the subtree, which gives Select and Rank,
+// and the aggregate of its elements in order by TMonoid, which gives RangeAggregate
+template<typename TMonoid = EmptyMonoid>
+struct OrderStatistics {
+    static const bool ENABLED = true;
+
+    typedef TMonoid Monoid;
+
+    template<typename Elem>
+    struct Data {
+        size_t size;
+        typename TMonoid::Value aggregate;
+
+        void Update(const Elem& elem, const Data* left, const Data* right) {
+            size = 1;
+            aggregate = TMonoid::Make(elem);
+            if (left) {
+                size += left->size;
+                aggregate = TMonoid::Combine(left->aggregate, aggregate);
+            }
+            if (right) {
+                size += right->size;
+                aggregate = TMonoid::Combine(aggregate, right->aggregate);
+            }
+        }
+    };
+};
+
+} // namespace algorithms
@@ -1,8 +1,19 @@
 #include <gtest/gtest.h>
+#include <unordered_map>
 #include <unordered_set>
 #include <fstream>
+#include <limits>
+#include <thread>
 
+#include "hash/bloom_filter.hpp"
+#include "hash/concurrent_hash_map.hpp"
+#include "hash/cuckoo_filter.hpp"
+#include "hash/fixed_map.hpp"
+#include "hash/flat_hash_table.hpp"
+#include "hash/frequency_sketch.hpp"
 #include "hash/hash_set.hpp"
+#include "hash/hyperloglog.hpp"
+#include "hash/minimal_perfect_hash.hpp"
 
 using namespace algorithms;
 
@@ -15,7 +26,7 @@ TEST(hash_table, universal_hash_function) {
 }
 
 TEST(hash_set, initialization) {
-    FixedSet f;
+    FixedSet<int> f;
 
     std::vector<int> keys {1, 2, 4, 5, 7, 11, 28};
     f.Init(keys);
@@ -34,7 +45,7 @@ TEST(hash_set, initialization) {
 }
 
 TEST(hash_set, initialization_big) {
-    FixedSet f;
+    FixedSet<int> f;
 
     static std::default_random_engine g_random_engine;
     std::unordered_set<int> set;
@@ -51,3 +62,795 @@ TEST(hash_set, initialization_big) {
     }
 }
 
+TEST(hash_set, empty_and_duplicates) {
+    FixedSet<int> f;
+    f.Init({});
+    ASSERT_FALSE(f.Contains(0));
+
+    f.Init({5, 5, 5, -7, 5});
+    ASSERT_TRUE(f.Contains(5));
+    ASSERT_TRUE(f.Contains(-7));
+    ASSERT_FALSE(f.Contains(0));
+    ASSERT_FALSE(f.Contains(-1000000000));
+
+    // copies of one key would exceed the bound on the table size with any function
+    f.Init(std::vector<int>(10, 5));
+    ASSERT_TRUE(f.Contains(5));
+    ASSERT_EQ(1, f.GetSlotsCount());
+
+    std::vector<int> repeated(200000, 42);
+    for (int i = 0; i < 1000; ++i) {
+        repeated.push_back(i * 7);
+    }
+    f.Init(repeated, 4);
+    for (int i = 0; i < 7000; ++i) {
+        ASSERT_EQ(i % 7 == 0 || i == 42, f.Contains(i));
+    }
+    ASSERT_LE(f.GetSlotsCount(), 4 * repeated.size());
+}
+
+TEST(hash_set, memory_bound) {
+    FixedSet<int> f;
+
+    static std::default_random_engine g_random_engine;
+    std::vector<int> keys;
+    for (int i = 0; i < 100000; ++i) {
+        keys.push_back(std::uniform_int_distribution<int>(-1000000000, 1000000000) (g_random_engine));
+    }
+    f.Init(keys);
+
+    // one header of six ints per key and at most four slots per key
+    ASSERT_LE(f.GetMemoryUsage(), sizeof(f) + keys.size() * 10 * sizeof(int));
+    for (int key : keys) {
+        ASSERT_TRUE(f.Contains(key));
+    }
+}
+
+TEST(hash_set, extreme_int_keys) {
+    FixedSet<int> f;
+
+    const int max = std::numeric_limits<int>::max();
+    const int min = std::numeric_limits<int>::min();
+    std::vector<int> keys {max, max - 1, min, min + 1, 0, -1, 1147483647, -852516353};
+    f.Init(keys);
+    for (int key : keys) {
+        ASSERT_TRUE(f.Contains(key));
+    }
+    ASSERT_FALSE(f.Contains(max - 2));
+    ASSERT_FALSE(f.Contains(min + 2));
+    ASSERT_FALSE(f.Contains(1));
+    ASSERT_FALSE(f.Contains(2));
+}
+
+TEST(hash_set, long_keys) {
+    FixedSet<unsigned long long> f;
+
+    static std::default_random_engine g_random_engine;
+    std::unordered_set<unsigned long long> set;
+    for (int i = 0; i < 10000; ++i) {
+        set.insert(std::uniform_int_distribution<unsigned long long>() (g_random_engine));
+    }
+    // keys which differ only in high bits
+    for (unsigned long long shift = 32; shift < 64; ++shift) {
+        set.insert(1ULL << shift);
+    }
+
+    f.Init(std::vector<unsigned long long>(set.begin(), set.end()));
+    for (unsigned long long key : set) {
+        ASSERT_TRUE(f.Contains(key));
+        ASSERT_EQ(set.count(key + 1) != 0, f.Contains(key + 1));
+    }
+    ASSERT_FALSE(f.Contains(1));
+}
+
+TEST(hash_set, string_keys) {
+    FixedSet<std::string> f;
+
+    std::vector<std::string> keys {"", "a", std::string("a\0", 2), "ab", "abcdefgh", "abcdefghi",
+                                   "http://example.com/index.html", "http://example.com/index.htm"};
+    for (int i = 0; i < 1000; ++i) {
+        keys.push_back("http://example.com/user/" + std::to_string(i));
+    }
+    f.Init(keys);
+
+    for (const std::string &key : keys) {
+        ASSERT_TRUE(f.Contains(key));
+    }
+    ASSERT_FALSE(f.Contains("b"));
+    ASSERT_FALSE(f.Contains(std::string("\0", 1)));
+    ASSERT_FALSE(f.Contains("abcdefg"));
+    ASSERT_FALSE(f.Contains("http://example.com/user/1000"));
+}
+
+template<typename TSet>
+void TestSetLikeUnorderedSet() {
+    TSet f;
+
+    static std::default_random_engine g_random_engine;
+    std::unordered_set<int> set;
+    for (int i = 0; i < 10000; ++i) {
+        set.insert(std::uniform_int_distribution<int>(-100000, 100000) (g_random_engine));
+    }
+    f.Init(std::vector<int>(set.begin(), set.end()));
+
+    for (int i = -100000; i <= 100000; ++i) {
+        ASSERT_EQ(set.find(i) != set.end(), f.Contains(i));
+    }
+}
+
+TEST(hash_set, range_reductions) {
+    TestSetLikeUnorderedSet<FixedSet<int, MultiplyAddShiftHash32, ModuloRange> >();
+    TestSetLikeUnorderedSet<FixedSet<int, MultiplyAddShiftHash32, FastRange> >();
+    TestSetLikeUnorderedSet<FixedSet<int, MultiplyShiftHash, FastRange> >();
+}
+
+TEST(hash_set, contains_batch) {
+    FixedSet<int> f;
+    std::vector<uint8_t> out(3);
+    f.ContainsBatch(nullptr, 0, out.data());
+    int probe = 5;
+    f.ContainsBatch(&probe, 1, out.data());
+    ASSERT_EQ(0, out[0]);
+
+    static std::default_random_engine g_random_engine;
+    std::vector<int> keys, probes;
+    for (int i = 0; i < 10000; ++i) {
+        keys.push_back(std::uniform_int_distribution<int>(-100000, 100000) (g_random_engine));
+    }
+    for (int i = 0; i < 12345; ++i) {
+        probes.push_back(std::uniform_int_distribution<int>(-100000, 100000) (g_random_engine));
+    }
+    f.Init(keys);
+
+    out.assign(probes.size(), 2);
+    f.ContainsBatch(probes.data(), probes.size(), out.data());
+    for (size_t i = 0; i < probes.size(); ++i) {
+        ASSERT_EQ(f.Contains(probes[i]), out[i] == 1);
+    }
+
+    FixedSet<std::string> strings;
+    strings.Init({"a", "b", "c"});
+    std::vector<std::string> string_probes {"a", "d", "c"};
+    strings.ContainsBatch(string_probes.data(), string_probes.size(), out.data());
+    ASSERT_EQ(1, out[0]);
+    ASSERT_EQ(0, out[1]);
+    ASSERT_EQ(1, out[2]);
+}
+
+TEST(hash_set, parallel_init) {
+    static std::default_random_engine g_random_engine;
+    std::vector<int> keys;
+    for (int i = 0; i < 300000; ++i) {
+        keys.push_back(std::uniform_int_distribution<int>() (g_random_engine));
+    }
+
+    FixedSet<int> serial(42);
+    serial.Init(keys, 1);
+    FixedSet<int> parallel(42);
+    parallel.Init(keys, 4);
+    ASSERT_EQ(serial.GetMemoryUsage(), parallel.GetMemoryUsage());
+
+    for (int key : keys) {
+        ASSERT_TRUE(parallel.Contains(key));
+    }
+    std::unordered_set<int> key_set(keys.begin(), keys.end());
+    for (int i = 0; i < 300000; ++i) {
+        int probe = std::uniform_int_distribution<int>() (g_random_engine);
+        ASSERT_EQ(key_set.count(probe) == 1, parallel.Contains(probe));
+        ASSERT_EQ(serial.Contains(probe), parallel.Contains(probe));
+    }
+}
+
+TEST(hash_set, save_and_map_file) {
+    static std::default_random_engine g_random_engine;
+    std::vector<int> keys;
+    for (int i = 0; i < 20000; ++i) {
+        keys.push_back(std::uniform_int_distribution<int>() (g_random_engine));
+    }
+    FixedSet<int> built;
+    built.Init(keys);
+
+    std::string path = "fixed_set_ut.bin";
+    built.SaveToFile(path);
+    FixedSet<int> mapped;
+    mapped.MapFile(path);
+    // the mapping outlives the file name
+    std::remove(path.c_str());
+
+    FixedSet<int> copy(mapped);
+    FixedSet<int> moved(std::move(copy));
+    ASSERT_FALSE(copy.Contains(keys[0]));
+    for (int key : keys) {
+        ASSERT_TRUE(mapped.Contains(key));
+        ASSERT_TRUE(moved.Contains(key));
+    }
+    for (int i = 0; i < 20000; ++i) {
+        int probe = std::uniform_int_distribution<int>() (g_random_engine);
+        ASSERT_EQ(built.Contains(probe), mapped.Contains(probe));
+    }
+
+    FixedSet<int> empty;
+    empty.Init({});
+    empty.SaveToFile(path);
+    mapped.MapFile(path);
+    ASSERT_FALSE(mapped.Contains(keys[0]));
+
+    // keys of another size
+    FixedSet<long long> wrong_type;
+    ASSERT_THROW(wrong_type.MapFile(path), std::runtime_error);
+    // keys of the same size but of another signedness
+    FixedSet<unsigned> wrong_signedness;
+    ASSERT_THROW(wrong_signedness.MapFile(path), std::runtime_error);
+    // another range reduction
+    FixedSet<int, MultiplyAddShiftHash32, ModuloRange> wrong_range;
+    ASSERT_THROW(wrong_range.MapFile(path), std::runtime_error);
+    // another hash family
+    FixedSet<int, MultiplyShiftHash, FastRange> wrong_hash;
+    ASSERT_THROW(wrong_hash.MapFile(path), std::runtime_error);
+    FixedSet<int, MultiplyAddShiftHash32, FastRange> same_type;
+    same_type.MapFile(path);
+    std::ofstream(path.c_str()) << "not a set";
+    ASSERT_THROW(mapped.MapFile(path), std::runtime_error);
+    std::remove(path.c_str());
+    ASSERT_THROW(mapped.MapFile(path), std::runtime_error);
+    // a failed mapping leaves the set unchanged
+    ASSERT_FALSE(mapped.Contains(keys[0]));
+}
+
+TEST(fixed_map, find) {
+    FixedMap<int, std::string> empty;
+    empty.Init({});
+    ASSERT_EQ(nullptr, empty.Find(1));
+
+    static std::default_random_engine g_random_engine;
+    std::unordered_map<int, std::string> expected;
+    std::vector<std::pair<int, std::string> > elements;
+    for (int i = 0; i < 20000; ++i) {
+        int key = std::uniform_int_distribution<int>(-100000, 100000) (g_random_engine);
+        elements.push_back(std::make_pair(key, std::to_string(i)));
+        // the last value of a repeated key wins
+        expected[key] = std::to_string(i);
+    }
+    FixedMap<int, std::string> f;
+    f.Init(elements);
+
+    for (int key = -100000; key <= 100000; ++key) {
+        auto iterator = expected.find(key);
+        const std::string *value = f.Find(key);
+        if (iterator == expected.end()) {
+            ASSERT_EQ(nullptr, value);
+            ASSERT_FALSE(f.Contains(key));
+        } else {
+            ASSERT_NE(nullptr, value);
+            ASSERT_EQ(iterator->second, *value);
+        }
+    }
+
+    FixedMap<int, int> repeated;
+    repeated.Init(std::vector<std::pair<int, int> >(1000, std::make_pair(3, 4)));
+    ASSERT_EQ(4, *repeated.Find(3));
+    ASSERT_EQ(nullptr, repeated.Find(4));
+
+    FixedMap<std::string, int> strings;
+    strings.Init({{"one", 1}, {"two", 2}, {"three", 3}});
+    ASSERT_EQ(2, *strings.Find("two"));
+    ASSERT_EQ(nullptr, strings.Find("four"));
+}
+
+template<typename TKey>
+void TestIsMinimalPerfect(const MinimalPerfectHash<TKey> &function, const std::vector<TKey> &keys) {
+    ASSERT_EQ(keys.size(), function.GetSize());
+    std::vector<bool> taken(keys.size(), false);
+    for (const TKey &key : keys) {
+        uint64_t index = function.GetIndex(key);
+        ASSERT_LT(index, keys.size());
+        ASSERT_FALSE(taken[index]);
+        taken[index] = true;
+    }
+}
+
+TEST(minimal_perfect_hash, indices) {
+    MinimalPerfectHash<int> empty;
+    empty.Init({});
+    ASSERT_EQ(0u, empty.GetSize());
+
+    static std::default_random_engine g_random_engine;
+    std::unordered_set<long long> key_set;
+    while (key_set.size() < 200000) {
+        key_set.insert(std::uniform_int_distribution<long long>() (g_random_engine));
+    }
+    std::vector<long long> keys(key_set.begin(), key_set.end());
+
+    MinimalPerfectHash<long long> serial;
+    serial.Init(keys, 1);
+    TestIsMinimalPerfect(serial, keys);
+    // about 3.5 bits per key with the default gamma
+    ASSERT_LT(serial.GetMemoryUsage() * 8, keys.size() * 4);
+
+    MinimalPerfectHash<long long> parallel;
+    parallel.Init(keys, 4);
+    for (long long key : keys) {
+        ASSERT_EQ(serial.GetIndex(key), parallel.GetIndex(key));
+    }
+
+    MinimalPerfectHash<long long> sparse(3.0);
+    sparse.Init(keys);
+    TestIsMinimalPerfect(sparse, keys);
+
+    std::vector<std::string> words;
+    for (int i = 0; i < 1000; ++i) {
+        words.push_back("word" + std::to_string(i));
+    }
+    MinimalPerfectHash<std::string> strings;
+    strings.Init(words);
+    TestIsMinimalPerfect(strings, words);
+
+    MinimalPerfectHash<int> repeated;
+    ASSERT_THROW(repeated.Init({1, 2, 3, 2}), std::invalid_argument);
+}
+
+TEST(flat_hash_set, random_operations) {
+    static std::default_random_engine g_random_engine;
+    FlatHashSet<int> set;
+    std::unordered_set<int> expected;
+    ASSERT_FALSE(set.Contains(0));
+    ASSERT_FALSE(set.Erase(0));
+
+    // small key range makes erasures and reinsertions frequent
+    for (int i = 0; i < 300000; ++i) {
+        int key = std::uniform_int_distribution<int>(0, 5000) (g_random_engine);
+        switch (std::uniform_int_distribution<int>(0, 2) (g_random_engine)) {
+            case 0:
+                ASSERT_EQ(expected.insert(key).second, set.Insert(key));
+                break;
+            case 1:
+                ASSERT_EQ(expected.erase(key) == 1, set.Erase(key));
+                break;
+            default:
+                ASSERT_EQ(expected.count(key) == 1, set.Contains(key));
+        }
+        ASSERT_EQ(expected.size(), set.GetSize());
+    }
+    for (int key = 0; key <= 5000; ++key) {
+        ASSERT_EQ(expected.count(key) == 1, set.Contains(key));
+    }
+
+    FlatHashSet<int> moved(std::move(set));
+    ASSERT_EQ(expected.size(), moved.GetSize());
+    moved.Clear();
+    ASSERT_EQ(0u, moved.GetSize());
+    ASSERT_FALSE(moved.Contains(*expected.begin()));
+}
+
+TEST(flat_hash_set, grow_and_reserve) {
+    FlatHashSet<long long> set;
+    set.Reserve(100000);
+    size_t reserved_memory = set.GetMemoryUsage();
+    for (long long key = 0; key < 100000; ++key) {
+        ASSERT_TRUE(set.Insert(key << 32));
+    }
+    ASSERT_EQ(reserved_memory, set.GetMemoryUsage());
+    for (long long key = 0; key < 100000; ++key) {
+        ASSERT_TRUE(set.Contains(key << 32));
+        ASSERT_FALSE(set.Contains((key << 32) + 1));
+    }
+    // erasing and inserting other keys reuses deleted slots instead of growing
+    for (long long key = 0; key < 100000; ++key) {
+        ASSERT_TRUE(set.Erase(key << 32));
+        ASSERT_TRUE(set.Insert((key << 32) + 1));
+    }
+    ASSERT_EQ(reserved_memory, set.GetMemoryUsage());
+}
+
+TEST(flat_hash_map, insert_find_erase) {
+    FlatHashMap<std::string, std::string> map;
+    std::unordered_map<std::string, std::string> expected;
+    static std::default_random_engine g_random_engine;
+    for (int i = 0; i < 100000; ++i) {
+        std::string key = std::to_string(std::uniform_int_distribution<int>(0, 3000) (g_random_engine));
+        if (std::uniform_int_distribution<int>(0, 3) (g_random_engine) == 0) {
+            ASSERT_EQ(expected.erase(key) == 1, map.Erase(key));
+        } else {
+            std::string value = std::to_string(i);
+            ASSERT_EQ(expected.count(key) == 0, map.Insert(key, value));
+            expected[key] = value;
+        }
+    }
+    ASSERT_EQ(expected.size(), map.GetSize());
+    for (int i = 0; i <= 3000; ++i) {
+        std::string key = std::to_string(i);
+        auto iterator = expected.find(key);
+        const std::string *value = map.Find(key);
+        if (iterator == expected.end()) {
+            ASSERT_EQ(nullptr, value);
+        } else {
+            ASSERT_NE(nullptr, value);
+            ASSERT_EQ(iterator->second, *value);
+        }
+    }
+    *map.Find(expected.begin()->first) = "changed";
+    ASSERT_EQ("changed", *map.Find(expected.begin()->first));
+}
+
+TEST(concurrent_hash_map, single_thread) {
+    static std::default_random_engine g_random_engine;
+    ConcurrentHashMap<int, int> map;
+    std::unordered_map<int, int> expected;
+    int value;
+    ASSERT_FALSE(map.Find(1, &value));
+    ASSERT_FALSE(map.Erase(1));
+
+    for (int i = 0; i < 300000; ++i) {
+        int key = std::uniform_int_distribution<int>(-20000, 20000) (g_random_engine);
+        switch (std::uniform_int_distribution<int>(0, 2) (g_random_engine)) {
+            case 0:
+                ASSERT_EQ(expected.count(key) == 0, map.Insert(key, i));
+                expected[key] = i;
+                break;
+            case 1:
+                ASSERT_EQ(expected.erase(key) == 1, map.Erase(key));
+                break;
+            default:
+                ASSERT_EQ(expected.count(key) == 1, map.Find(key, &value));
+                if (expected.count(key) == 1) {
+                    ASSERT_EQ(expected[key], value);
+                }
+        }
+    }
+    ASSERT_EQ(expected.size(), map.GetSize());
+}
+
+TEST(concurrent_hash_map, reserved_values) {
+    const int MAX = std::numeric_limits<int>::max();
+    ConcurrentHashMap<int, int> map;
+    // the greatest key marks empty slots, the two greatest values erased and migrated ones
+    ASSERT_THROW(map.Insert(MAX, 1), std::invalid_argument);
+    ASSERT_THROW(map.Insert(1, MAX), std::invalid_argument);
+    ASSERT_THROW(map.Insert(1, MAX - 1), std::invalid_argument);
+    int value;
+    ASSERT_FALSE(map.Find(1, &value));
+    ASSERT_FALSE(map.Erase(MAX));
+    ASSERT_EQ(0, map.GetSize());
+
+    ASSERT_TRUE(map.Insert(1, MAX - 2));
+    ASSERT_TRUE(map.Insert(MAX - 1, 2));
+    ASSERT_THROW(map.Insert(1, MAX), std::invalid_argument);
+    ASSERT_TRUE(map.Find(1, &value));
+    ASSERT_EQ(MAX - 2, value);
+    ASSERT_TRUE(map.Find(MAX - 1, &value));
+    ASSERT_EQ(2, value);
+    ASSERT_EQ(2, map.GetSize());
+}
+
+TEST(concurrent_hash_map, concurrent_updates) {
+    const int THREADS_COUNT = 4;
+    const int KEYS_PER_THREAD = 50000;
+    ConcurrentHashMap<long long, long long> map;
+    std::atomic<bool> failed(false);
+
+    // every thread owns its keys, so it knows their values while other threads resize the map
+    std::vector<std::thread> threads;
+    for (int thread_index = 0; thread_index < THREADS_COUNT; ++thread_index) {
+        threads.push_back(std::thread([&map, &failed, thread_index] () {
+            long long value;
+            for (long long key = thread_index; key < KEYS_PER_THREAD * THREADS_COUNT; key += THREADS_COUNT) {
+                if (!map.Insert(key, key * 2)) {
+                    failed = true;
+                }
+                if (!map.Find(key, &value) || value != key * 2) {
+                    failed = true;
+                }
+                if (key % 3 == 0 && !map.Erase(key)) {
+                    failed = true;
+                }
+            }
+            for (long long key = thread_index; key < KEYS_PER_THREAD * THREADS_COUNT; key += THREADS_COUNT) {
+                if (map.Find(key, &value) != (key % 3 != 0)) {
+                    failed = true;
+                }
+            }
+        }));
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    ASSERT_FALSE(failed);
+
+    size_t expected_size = 0;
+    long long value;
+    for (long long key = 0; key < KEYS_PER_THREAD * THREADS_COUNT; ++key) {
+        ASSERT_EQ(key % 3 != 0, map.Find(key, &value));
+        expected_size += (key % 3 != 0);
+    }
+    ASSERT_EQ(expected_size, map.GetSize());
+}
+
+TEST(concurrent_hash_map, releases_old_tables) {
+    // a window of present keys slides over many distinct keys, every key
+    // takes a slot for good, so the tables are migrated again and again
+    const long long WINDOW_SIZE = 100;
+    const long long KEYS_COUNT = 1000000;
+    ConcurrentHashMap<long long, long long> map;
+    size_t initial_memory = map.GetMemoryUsage();
+    long long value;
+    for (long long key = 0; key < KEYS_COUNT; ++key) {
+        ASSERT_TRUE(map.Insert(key, key));
+        if (key >= WINDOW_SIZE) {
+            ASSERT_TRUE(map.Erase(key - WINDOW_SIZE));
+        }
+        ASSERT_LE(map.GetMemoryUsage(), 4 * initial_memory);
+    }
+    ASSERT_EQ(WINDOW_SIZE, map.GetSize());
+    ASSERT_TRUE(map.Find(KEYS_COUNT - 1, &value));
+    ASSERT_FALSE(map.Find(KEYS_COUNT - WINDOW_SIZE - 1, &value));
+
+    // readers run through the tables while writers migrate and release them
+    const int THREADS_COUNT = 4;
+    ConcurrentHashMap<long long, long long> shared;
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> threads;
+    for (int thread_index = 0; thread_index < THREADS_COUNT; ++thread_index) {
+        threads.push_back(std::thread([&shared, &failed, thread_index] () {
+            long long value;
+            for (long long key = thread_index; key < KEYS_COUNT / 10; key += THREADS_COUNT) {
+                shared.Insert(key, key);
+                if (!shared.Find(key, &value) || value != key) {
+                    failed = true;
+                }
+                if (key >= WINDOW_SIZE && !shared.Erase(key - WINDOW_SIZE)) {
+                    failed = true;
+                }
+            }
+        }));
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    ASSERT_FALSE(failed);
+    ASSERT_LE(shared.GetMemoryUsage(), 4 * initial_memory);
+}
+
+TEST(blocked_bloom_filter, false_positive_rate) {
+    ASSERT_THROW(BlockedBloomFilter<int>(10, 0.0), std::invalid_argument);
+    ASSERT_THROW(BlockedBloomFilter<int>(10, 1.0), std::invalid_argument);
+
+    const long long KEYS_COUNT = 100000;
+    const long long PROBES_COUNT = 1000000;
+    BlockedBloomFilter<long long> filter(KEYS_COUNT, 0.01);
+    ASSERT_FALSE(filter.Contains(1));
+
+    std::vector<long long> keys;
+    for (long long key = 0; key < KEYS_COUNT; ++key) {
+        keys.push_back(key * 7);
+    }
+    filter.InsertBatch(keys.data(), keys.size() / 2);
+    for (size_t i = keys.size() / 2; i < keys.size(); ++i) {
+        filter.Insert(keys[i]);
+    }
+
+    std::vector<uint8_t> out(keys.size());
+    filter.ContainsBatch(keys.data(), keys.size(), out.data());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        ASSERT_TRUE(filter.Contains(keys[i]));
+        ASSERT_EQ(1, out[i]);
+    }
+
+    long long false_positives = 0;
+    for (long long probe = 0; probe < PROBES_COUNT; ++probe) {
+        false_positives += filter.Contains(KEYS_COUNT * 7 + probe);
+    }
+    ASSERT_LT(false_positives, PROBES_COUNT * 0.012);
+    // the blocked layout costs a bit over the 9.6 bits per key of a classic filter
+    ASSERT_LT(filter.GetMemoryUsage() * 8, KEYS_COUNT * 12);
+}
+
+TEST(cuckoo_filter, insert_contains_erase) {
+    ASSERT_THROW(CuckooFilter<int>(10, 1.5), std::invalid_argument);
+
+    const long long KEYS_COUNT = 100000;
+    const long long PROBES_COUNT = 1000000;
+    CuckooFilter<long long> filter(KEYS_COUNT, 0.01);
+    ASSERT_EQ(10, filter.GetFingerprintBits());
+    ASSERT_FALSE(filter.Contains(1));
+    ASSERT_FALSE(filter.Erase(1));
+
+    std::vector<long long> keys;
+    for (long long key = 0; key < KEYS_COUNT; ++key) {
+        keys.push_back(key * 7);
+    }
+    ASSERT_EQ(keys.size() / 2, filter.InsertBatch(keys.data(), keys.size() / 2));
+    for (size_t i = keys.size() / 2; i < keys.size(); ++i) {
+        ASSERT_TRUE(filter.Insert(keys[i]));
+    }
+    ASSERT_EQ(keys.size(), filter.GetSize());
+
+    std::vector<uint8_t> out(keys.size());
+    filter.ContainsBatch(keys.data(), keys.size(), out.data());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        ASSERT_EQ(1, out[i]);
+    }
+
+    long long false_positives = 0;
+    for (long long probe = 0; probe < PROBES_COUNT; ++probe) {
+        false_positives += filter.Contains(KEYS_COUNT * 7 + probe);
+    }
+    ASSERT_LT(false_positives, PROBES_COUNT * 0.01);
+
+    for (size_t i = 0; i < keys.size(); i += 2) {
+        ASSERT_TRUE(filter.Erase(keys[i]));
+    }
+    ASSERT_EQ(keys.size() / 2, filter.GetSize());
+    for (size_t i = 1; i < keys.size(); i += 2) {
+        ASSERT_TRUE(filter.Contains(keys[i]));
+    }
+    false_positives = 0;
+    for (size_t i = 0; i < keys.size(); i += 2) {
+        false_positives += filter.Contains(keys[i]);
+    }
+    ASSERT_LT(false_positives, KEYS_COUNT / 2 * 0.01);
+}
+
+TEST(cuckoo_filter, overflow) {
+    CuckooFilter<int> filter(1000, 0.001);
+    int inserted_count = 0;
+    while (filter.Insert(inserted_count)) {
+        ++inserted_count;
+    }
+    // a failed insertion leaves the filter as it was
+    ASSERT_EQ(static_cast<size_t>(inserted_count), filter.GetSize());
+    for (int key = 0; key < inserted_count; ++key) {
+        ASSERT_TRUE(filter.Contains(key));
+    }
+    for (int key = 0; key < inserted_count; ++key) {
+        ASSERT_TRUE(filter.Erase(key));
+    }
+    ASSERT_EQ(0u, filter.GetSize());
+    ASSERT_TRUE(filter.Insert(0));
+}
+
+TEST(hyperloglog, estimate_and_merge) {
+    ASSERT_THROW(HyperLogLog<int>(3), std::invalid_argument);
+    ASSERT_THROW(HyperLogLog<int>(19), std::invalid_argument);
+
+    HyperLogLog<long long> sketch(12);
+    ASSERT_EQ(0.0, sketch.Estimate());
+    // relative standard error is 1.04 / 64, estimates are checked within four of them
+    const double MAX_ERROR = 4 * 1.04 / 64;
+    long long added_count = 0;
+    for (long long count : {10, 100, 1000, 10000, 100000, 1000000}) {
+        for (; added_count < count; ++added_count) {
+            sketch.Add(added_count * 3);
+            sketch.Add(added_count * 3);
+        }
+        ASSERT_NEAR(1.0, sketch.Estimate() / count, MAX_ERROR);
+        if (count <= 100) {
+            ASSERT_TRUE(sketch.IsSparse());
+        }
+    }
+    ASSERT_FALSE(sketch.IsSparse());
+
+    // sketches of parts of a stream, sparse and dense, merge into the sketch of the whole stream
+    const int PARTS_COUNT = 4;
+    std::vector<HyperLogLog<long long> > parts(PARTS_COUNT, HyperLogLog<long long>(12));
+    std::vector<std::thread> threads;
+    for (int part = 0; part < PARTS_COUNT; ++part) {
+        threads.push_back(std::thread([&parts, part] () {
+            long long count = part == 0 ? 50 : 200000;
+            for (long long key = 0; key < count; ++key) {
+                parts[part].Add(key * PARTS_COUNT + part);
+            }
+        }));
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    HyperLogLog<long long> merged(12);
+    merged.Merge(parts[0]);
+    ASSERT_TRUE(merged.IsSparse());
+    for (int part = 1; part < PARTS_COUNT; ++part) {
+        merged.Merge(parts[part]);
+    }
+    HyperLogLog<long long> whole(12);
+    for (int part = 0; part < PARTS_COUNT; ++part) {
+        long long count = part == 0 ? 50 : 200000;
+        for (long long key = 0; key < count; ++key) {
+            whole.Add(key * PARTS_COUNT + part);
+        }
+    }
+    ASSERT_EQ(whole.Estimate(), merged.Estimate());
+    ASSERT_NEAR(1.0, merged.Estimate() / 600050, MAX_ERROR);
+    ASSERT_THROW(merged.Merge(HyperLogLog<long long>(12, 1)), std::invalid_argument);
+
+    HyperLogLog<std::string> words;
+    for (int i = 0; i < 5000; ++i) {
+        words.Add("word" + std::to_string(i % 1000));
+    }
+    ASSERT_NEAR(1.0, words.Estimate() / 1000, 0.02);
+}
+
+TEST(count_min_sketch, estimates) {
+    ASSERT_THROW(CountMinSketch<int>(0, 4), std::invalid_argument);
+
+    // key i occurs 100000 / (i + 1) times
+    const int KEYS_COUNT = 10000;
+    CountMinSketch<int> sketch(2000, 5);
+    CountMinSketch<int> first_half(2000, 5);
+    CountMinSketch<int> second_half(2000, 5);
+    for (int key = 0; key < KEYS_COUNT; ++key) {
+        sketch.Add(key, 100000 / (key + 1));
+        (key % 2 == 0 ? first_half : second_half).Add(key, 100000 / (key + 1));
+    }
+    first_half.Merge(second_half);
+    ASSERT_EQ(sketch.GetTotal(), first_half.GetTotal());
+
+    // epsilon = e / width
+    double max_error = 2.72 / 2000 * sketch.GetTotal();
+    int large_errors_count = 0;
+    for (int key = 0; key < KEYS_COUNT; ++key) {
+        uint64_t count = 100000 / (key + 1);
+        ASSERT_LE(count, sketch.Estimate(key));
+        ASSERT_EQ(sketch.Estimate(key), first_half.Estimate(key));
+        large_errors_count += sketch.Estimate(key) > count + max_error;
+    }
+    // delta = e^-depth
+    ASSERT_LT(large_errors_count, KEYS_COUNT / 100);
+    ASSERT_THROW(sketch.Merge(CountMinSketch<int>(2000, 4)), std::invalid_argument);
+}
+
+TEST(count_sketch, estimates) {
+    ASSERT_THROW(CountSketch<int>(10, 33), std::invalid_argument);
+
+    CountSketch<int> sketch(1000, 5);
+    for (int key = 0; key < 10000; ++key) {
+        sketch.Add(key, 100000 / (key + 1));
+    }
+    for (int key = 0; key < 10; ++key) {
+        double count = 100000 / (key + 1);
+        ASSERT_NEAR(count, sketch.Estimate(key), count * 0.05);
+    }
+    // counts may decrease
+    sketch.Add(0, -50000);
+    ASSERT_NEAR(50000, sketch.Estimate(0), 2500);
+}
+
+TEST(heavy_hitters, top_keys) {
+    // key i occurs 100000 / (i + 1) times, in random order, spread among threads
+    const int THREADS_COUNT = 4;
+    static std::default_random_engine g_random_engine;
+    std::vector<int> stream;
+    for (int key = 0; key < 10000; ++key) {
+        stream.insert(stream.end(), 100000 / (key + 1), key);
+    }
+    std::shuffle(stream.begin(), stream.end(), g_random_engine);
+
+    std::vector<HeavyHitters<int> > trackers(THREADS_COUNT, HeavyHitters<int>(10, CountMinSketch<int>(2000, 5)));
+    std::vector<std::thread> threads;
+    for (int thread_index = 0; thread_index < THREADS_COUNT; ++thread_index) {
+        threads.push_back(std::thread([&trackers, &stream, thread_index] () {
+            for (size_t i = thread_index; i < stream.size(); i += THREADS_COUNT) {
+                trackers[thread_index].Add(stream[i]);
+            }
+        }));
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    for (int thread_index = 1; thread_index < THREADS_COUNT; ++thread_index) {
+        trackers[0].Merge(trackers[thread_index]);
+    }
+
+    auto top = trackers[0].GetTop();
+    ASSERT_EQ(10u, top.size());
+    for (int key = 0; key < 10; ++key) {
+        ASSERT_EQ(key, top[key].first);
+        ASSERT_LE(static_cast<uint64_t>(100000 / (key + 1)), top[key].second);
+    }
+
+    HeavyHitters<int, CountSketch<int> > signed_tracker(3, CountSketch<int>(1000, 5));
+    for (int i = 0; i < 100000; ++i) {
+        signed_tracker.Add(stream[i]);
+    }
+    auto signed_top = signed_tracker.GetTop();
+    ASSERT_EQ(3u, signed_top.size());
+    ASSERT_EQ(0, signed_top[0].first);
+}
@@ -1,9 +1,17 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <thread>
 #include <unordered_set>
 
 #include "heap/binary_heap.hpp"
+#include "heap/implicit_treap.hpp"
+#include "heap/pairing_heap.hpp"
+#include "heap/persistent_treap.hpp"
 #include "heap/treap.hpp"
+#include "test_helper.hpp"
 
 
 TEST(binary_heap_test, insert_extract_max) {
@@ -212,3 +220,385 @@ TEST(treap, find_this_or_next) {
     }
     ASSERT_FALSE(test.FindThisOrNext(10, &result));
 }
+
+// Pairing heap
+TEST(pairing_heap, insert_pop) {
+    algorithms::PairingHeap<int> heap;
+    for (int element : {20, 15, 11, 6, 9, 1, 3, 5, 17, 7, 8}) {
+        heap.Insert(element);
+    }
+
+    ASSERT_EQ(11, heap.GetSize());
+    for (int expected : {20, 17, 15, 11, 9, 8, 7, 6, 5, 3, 1}) {
+        ASSERT_EQ(expected, heap.GetTop());
+        heap.Pop();
+    }
+    ASSERT_EQ(0, heap.GetSize());
+}
+
+TEST(pairing_heap, decrease_key_remove) {
+    typedef algorithms::PairingHeap<int, std::greater<int> > MinHeap;
+    MinHeap heap;
+
+    std::vector<MinHeap::Handle> handles;
+    for (int i = 0; i < 10; ++i) {
+        handles.push_back(heap.Insert(100 + i));
+    }
+    ASSERT_EQ(100, heap.GetTop());
+
+    heap.DecreaseKey(handles[7], 50);
+    ASSERT_EQ(50, heap.GetTop());
+    ASSERT_EQ(50, MinHeap::GetElement(handles[7]));
+
+    heap.Remove(handles[7]);
+    heap.Remove(handles[3]);
+    ASSERT_EQ(8, heap.GetSize());
+
+    for (int expected : {100, 101, 102, 104, 105, 106, 108, 109}) {
+        ASSERT_EQ(expected, heap.GetTop());
+        heap.Pop();
+    }
+}
+
+TEST(pairing_heap, meld_stress) {
+    typedef algorithms::PairingHeap<int> TestHeap;
+    typedef algorithms::BinaryHeap<int> ReferenceHeap;
+
+    static std::default_random_engine g_random_engine;
+    const int heaps_count = 8;
+    std::vector<TestHeap> heaps(heaps_count);
+    std::vector<ReferenceHeap> references(heaps_count);
+
+    for (int step = 0; step < 20000; ++step) {
+        int index = std::uniform_int_distribution<int>(0, heaps_count - 1) (g_random_engine);
+        int action = std::uniform_int_distribution<int>(0, 9) (g_random_engine);
+
+        if (action < 6) {
+            int element = std::uniform_int_distribution<int>(0, 1000000) (g_random_engine);
+            heaps[index].Insert(element);
+            references[index].Insert(element);
+        } else if (action < 9) {
+            if (heaps[index].GetSize() != 0) {
+                ASSERT_EQ(references[index].GetTop(), heaps[index].GetTop());
+                heaps[index].Pop();
+                references[index].Pop();
+            }
+        } else {
+            int other = (index + 1) % heaps_count;
+            heaps[index].Meld(std::move(heaps[other]));
+            while (references[other].GetSize() != 0) {
+                references[index].Insert(references[other].GetTop());
+                references[other].Pop();
+            }
+        }
+        ASSERT_EQ(references[index].GetSize(), heaps[index].GetSize());
+    }
+
+    for (int index = 0; index < heaps_count; ++index) {
+        while (heaps[index].GetSize() != 0) {
+            ASSERT_EQ(references[index].GetTop(), heaps[index].GetTop());
+            heaps[index].Pop();
+            references[index].Pop();
+        }
+    }
+}
+
+TEST(treap, order_statistics) {
+    TestTreap test;
+    std::set<int> set;
+
+    static std::default_random_engine g_random_engine;
+    for (int i = 0; i < 1000; ++i) {
+        int element = std::uniform_int_distribution<int>(0, 5000) (g_random_engine);
+        ASSERT_EQ(set.insert(element).second, test.Insert(element));
+        if (i % 3 == 0) {
+            int to_erase = std::uniform_int_distribution<int>(0, 5000) (g_random_engine);
+            ASSERT_EQ(set.erase(to_erase) != 0, test.Erase(to_erase));
+        }
+    }
+    ASSERT_TRUE(CheckTreap(test));
+    ASSERT_EQ(set.size(), test.GetSize());
+
+    size_t position = 0;
+    for (int element : set) {
+        int result = -1;
+        ASSERT_TRUE(test.KthElement(position, &result));
+        ASSERT_EQ(element, result);
+        ASSERT_EQ(position, test.Rank(element));
+        ++position;
+    }
+    int result = -1;
+    ASSERT_FALSE(test.KthElement(set.size(), &result));
+
+    for (int begin = -10; begin < 5100; begin += 97) {
+        int end = begin + 350;
+        size_t expected = std::distance(set.lower_bound(begin), set.lower_bound(end));
+        ASSERT_EQ(expected, test.CountRange(begin, end));
+    }
+    ASSERT_EQ(0, test.CountRange(100, 100));
+}
+
+// Implicit treap
+typedef algorithms::ImplicitTreap<int> TestRope;
+
+TEST(implicit_treap, insert_erase_at) {
+    TestRope rope;
+    std::vector<int> expected;
+
+    static std::default_random_engine g_random_engine;
+    for (int i = 0; i < 2000; ++i) {
+        size_t position = std::uniform_int_distribution<size_t>(0, expected.size()) (g_random_engine);
+        rope.InsertAt(position, i);
+        expected.insert(expected.begin() + position, i);
+
+        if (i % 4 == 0) {
+            size_t to_erase = std::uniform_int_distribution<size_t>(0, expected.size() - 1)
+                (g_random_engine);
+            rope.EraseAt(to_erase);
+            expected.erase(expected.begin() + to_erase);
+        }
+    }
+
+    ASSERT_EQ(expected.size(), rope.GetSize());
+    algorithms::TestVector(expected, rope.OutputInorder());
+    for (size_t position = 0; position < expected.size(); position += 37) {
+        ASSERT_EQ(expected[position], rope.At(position));
+    }
+    ASSERT_THROW(rope.At(expected.size()), std::out_of_range);
+}
+
+TEST(implicit_treap, split_concatenate_reverse) {
+    TestRope rope;
+    std::vector<int> expected;
+    for (int i = 0; i < 1000; ++i) {
+        rope.PushBack(i);
+        expected.push_back(i);
+    }
+
+    static std::default_random_engine g_random_engine;
+    for (int step = 0; step < 300; ++step) {
+        size_t begin = std::uniform_int_distribution<size_t>(0, expected.size()) (g_random_engine);
+        size_t end = std::uniform_int_distribution<size_t>(begin, expected.size()) (g_random_engine);
+
+        rope.Reverse(begin, end);
+        std::reverse(expected.begin() + begin, expected.begin() + end);
+
+        // move the suffix starting at 'end' to the front
+        TestRope suffix;
+        rope.Split(end, &suffix);
+        suffix.Concatenate(std::move(rope));
+        rope = std::move(suffix);
+        std::rotate(expected.begin(), expected.begin() + end, expected.end());
+
+        ASSERT_EQ(expected[begin / 2], rope.At(begin / 2));
+    }
+    algorithms::TestVector(expected, rope.OutputInorder());
+
+    TestRope other;
+    for (int i = 0; i < 10; ++i) {
+        other.PushBack(-i);
+        expected.push_back(-i);
+    }
+    // the moved-into treap is the only user of its pool, which is spliced
+    TestRope moved(std::move(other));
+    rope.Concatenate(std::move(moved));
+    ASSERT_EQ(0, moved.GetSize());
+    algorithms::TestVector(expected, rope.OutputInorder());
+
+    // a moved-from treap can be filled again
+    ASSERT_EQ(0, other.GetSize());
+    other.PushBack(1);
+    other.Concatenate(std::move(moved));
+    rope.Concatenate(std::move(other));
+    expected.push_back(1);
+    algorithms::TestVector(expected, rope.OutputInorder());
+}
+
+TEST(treap, init_sorted) {
+    std::vector<int> keys;
+    for (int i = 0; i < 10000; ++i) {
+        keys.push_back(3 * i);
+        if (i % 10 == 0) {
+            keys.push_back(3 * i);
+        }
+    }
+
+    TestTreap test;
+    test.Insert(1);
+    test.InitSorted(keys.begin(), keys.end());
+    ASSERT_TRUE(CheckTreap(test));
+    ASSERT_EQ(10000, test.GetSize());
+    ASSERT_FALSE(test.Find(1));
+    for (int i = 0; i < 10000; ++i) {
+        ASSERT_TRUE(test.Find(3 * i));
+        ASSERT_FALSE(test.Find(3 * i + 1));
+    }
+}
+
+void TestSetOperation(size_t first_size, size_t second_size,
+        void (TestTreap::*operation)(TestTreap &&),
+        std::function<bool(bool, bool)> predicate) {
+    static std::default_random_engine g_random_engine;
+    std::set<int> first_set, second_set;
+    for (size_t i = 0; i < first_size; ++i) {
+        first_set.insert(std::uniform_int_distribution<int>(0, 4 * first_size) (g_random_engine));
+    }
+    for (size_t i = 0; i < second_size; ++i) {
+        second_set.insert(std::uniform_int_distribution<int>(0, 4 * first_size) (g_random_engine));
+    }
+
+    TestTreap first, second;
+    first.InitSorted(first_set.begin(), first_set.end());
+    second.InitSorted(second_set.begin(), second_set.end());
+
+    (first.*operation)(std::move(second));
+    ASSERT_TRUE(CheckTreap(first));
+    ASSERT_EQ(0, second.GetSize());
+
+    size_t expected_size = 0;
+    for (int key = 0; key <= static_cast<int>(4 * first_size); ++key) {
+        bool expected = predicate(first_set.count(key) != 0, second_set.count(key) != 0);
+        expected_size += expected;
+        ASSERT_EQ(expected, first.Find(key));
+    }
+    ASSERT_EQ(expected_size, first.GetSize());
+}
+
+TEST(treap, set_operations) {
+    auto union_predicate = [](bool first, bool second) { return first || second; };
+    auto intersection_predicate = [](bool first, bool second) { return first && second; };
+    auto difference_predicate = [](bool first, bool second) { return first && !second; };
+
+    for (size_t second_size : {0, 10, 1000, 100000}) {
+        TestSetOperation(100000, second_size, &TestTreap::Union, union_predicate);
+        TestSetOperation(100000, second_size, &TestTreap::Intersection, intersection_predicate);
+        TestSetOperation(100000, second_size, &TestTreap::Difference, difference_predicate);
+    }
+}
+
+// Persistent treap
+typedef algorithms::PersistentTreap<int> TestPersistentTreap;
+
+bool CheckPersistentTreap(const TestPersistentTreap &treap) {
+    try {
+        treap.CheckStructure();
+
+    } catch (const std::runtime_error &exception) {
+        std::cout << exception.what();
+        return false;
+
+    }
+    return true;
+}
+
+TEST(persistent_treap, versions) {
+    static std::default_random_engine g_random_engine;
+
+    std::vector<TestPersistentTreap> versions(1);
+    std::vector<std::set<int> > sets(1);
+    for (int i = 0; i < 2000; ++i) {
+        int key = std::uniform_int_distribution<int>(0, 1000) (g_random_engine);
+        std::set<int> set = sets.back();
+        if (i % 3 == 0) {
+            versions.push_back(versions.back().Erase(key));
+            set.erase(key);
+        } else {
+            versions.push_back(versions.back().Insert(key));
+            set.insert(key);
+        }
+        sets.push_back(set);
+    }
+
+    for (size_t version = 0; version < versions.size(); version += 50) {
+        ASSERT_TRUE(CheckPersistentTreap(versions[version]));
+        ASSERT_EQ(sets[version].size(), versions[version].GetSize());
+        for (int key = 0; key <= 1000; ++key) {
+            ASSERT_EQ(sets[version].count(key) != 0, versions[version].Find(key));
+        }
+    }
+
+    int result = 0;
+    ASSERT_TRUE(versions.back().FindThisOrNext(-1, &result));
+    ASSERT_EQ(*sets.back().begin(), result);
+}
+
+TEST(persistent_treap, structural_sharing) {
+    TestPersistentTreap base;
+    const int size = 1 << 14;
+    for (int i = 0; i < size; ++i) {
+        base = base.Insert(2 * i);
+    }
+    ASSERT_EQ(size, TestPersistentTreap::CountDistinctNodes({base}));
+
+    std::vector<TestPersistentTreap> versions(1, base);
+    for (int i = 0; i < 1000; ++i) {
+        versions.push_back(base.Insert(4 * i + 1).Erase(8 * i));
+    }
+    size_t extra_nodes = TestPersistentTreap::CountDistinctNodes(versions) - size;
+
+    // every version copies two search paths of expected length about 2 ln(size) each
+    ASSERT_LT(extra_nodes / 1000, 4 * 14);
+    ASSERT_EQ(size, base.GetSize());
+    ASSERT_TRUE(base.Find(0));
+    ASSERT_FALSE(base.Find(1));
+}
+
+TEST(persistent_treap, concurrent_readers) {
+    const int READERS_COUNT = 3;
+    const int KEYS_COUNT = 20000;
+    const int WINDOW_SIZE = 64;
+    TestPersistentTreap shared;
+    std::atomic<bool> failed(false);
+    std::atomic<bool> finished(false);
+
+    // every published version holds a window of consecutive keys, which only moves forward;
+    // readers check that each snapshot is such a window, not older than the previous one
+    std::vector<std::thread> threads;
+    for (int reader = 0; reader < READERS_COUNT; ++reader) {
+        threads.push_back(std::thread([&shared, &failed, &finished] () {
+            int previous_last = -1;
+            while (!finished.load()) {
+                TestPersistentTreap snapshot = shared.AtomicLoad();
+                int size = static_cast<int>(snapshot.GetSize());
+                int first = 0;
+                if (size == 0) {
+                    if (previous_last != -1) {
+                        failed = true;
+                    }
+                    continue;
+                }
+                snapshot.FindThisOrNext(-1, &first);
+                int last = first + size - 1;
+                if (last < previous_last || (last >= WINDOW_SIZE && size != WINDOW_SIZE)) {
+                    failed = true;
+                }
+                for (int key = first - 1; key <= last + 1; ++key) {
+                    if (snapshot.Find(key) != (key >= first && key <= last)) {
+                        failed = true;
+                    }
+                }
+                try {
+                    snapshot.CheckStructure();
+                } catch (const std::exception &) {
+                    failed = true;
+                }
+                previous_last = last;
+            }
+        }));
+    }
+
+    TestPersistentTreap version;
+    for (int key = 0; key < KEYS_COUNT; ++key) {
+        version = version.Insert(key);
+        if (key >= WINDOW_SIZE) {
+            version = version.Erase(key - WINDOW_SIZE);
+        }
+        shared.AtomicStore(version);
+    }
+    finished = true;
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    ASSERT_FALSE(failed);
+    ASSERT_EQ(WINDOW_SIZE, shared.AtomicLoad().GetSize());
+}
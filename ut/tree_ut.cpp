@@ -1,10 +1,20 @@
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <numeric>
 #include <set>
+#include <string>
 #include <random>
+#include <thread>
 #include <gtest/gtest.h>
 
 #include "tree/binary_search_tree.hpp"
 #include "tree/splay_tree.hpp"
+#include "tree/avl_tree.hpp"
+#include "tree/b_plus_tree.hpp"
+#include "tree/concurrent_skip_list.hpp"
 #include "test_helper.hpp"
 
 using namespace algorithms;
@@ -18,7 +28,8 @@ struct TraitsSentinel<int> {
 typedef BinarySearchTree<int> BSTree;
 typedef SplayTree<int> STree;
 
-void TestTreeLikeSet(BSTree& tree, int test_size = 10000) {
+template<typename TTree>
+void TestTreeLikeSet(TTree& tree, int test_size = 10000) {
     std::minstd_rand0 generator(std::time(nullptr));
     std::vector<int> data = InitRandomVector(&generator, -1000, 1000, test_size);
 
@@ -407,3 +418,705 @@ TEST(splay_tree, set) {
     TestTreeLikeSet(tree);
 }
 
+TEST(splay_tree, new_delete_allocator) {
+    SplayTree<int, NewDeleteAllocator> tree;
+    TestTreeLikeSet(tree, 2000);
+}
+
+TEST(splay_tree, node_pool_reuse) {
+    STree tree;
+    for (int i = 0; i < 1000; ++i) {
+        tree.Insert(i * 7 % 1000);
+    }
+    size_t capacity = tree.GetAllocator().GetCapacity();
+    ASSERT_EQ(1000, tree.GetAllocator().GetAllocatedCount());
+
+    for (int i = 0; i < 1000; i += 2) {
+        tree.Delete(i);
+    }
+    ASSERT_EQ(500, tree.GetAllocator().GetAllocatedCount());
+    ASSERT_TRUE(tree.IsValid());
+
+    for (int i = 1000; i < 1500; ++i) {
+        tree.Insert(i);
+    }
+    ASSERT_EQ(1000, tree.GetAllocator().GetAllocatedCount());
+    ASSERT_EQ(capacity, tree.GetAllocator().GetCapacity());
+}
+
+TEST(splay_tree, merge) {
+    STree left;
+    STree right;
+    for (int i = 0; i < 100; ++i) {
+        left.Insert(i);
+        right.Insert(100 + i);
+    }
+    STree merged = STree::Merge(std::move(left), std::move(right));
+    ASSERT_TRUE(merged.IsValid());
+    ASSERT_EQ(200, merged.GetAllocator().GetAllocatedCount());
+    ASSERT_EQ(0, right.GetAllocator().GetAllocatedCount());
+
+    std::vector<int> expected;
+    for (int i = 0; i < 200; ++i) {
+        expected.push_back(i);
+    }
+    TestVector(expected, merged.OutputInorder());
+
+    for (int i = 0; i < 200; i += 3) {
+        merged.Delete(i);
+    }
+    ASSERT_TRUE(merged.IsValid());
+    ASSERT_EQ(133, merged.GetAllocator().GetAllocatedCount());
+}
+
+TEST(binary_search_tree, destroy_nontrivial) {
+    // elements with destructors are freed one by one, a degenerate tree without recursion
+    BinarySearchTree<std::string> tree;
+    for (int i = 0; i < 5000; ++i) {
+        tree.Insert(std::string(20, 'a') + std::to_string(10000 + i));
+    }
+    for (int i = 0; i < 5000; i += 2) {
+        tree.Delete(std::string(20, 'a') + std::to_string(10000 + i));
+    }
+    ASSERT_EQ(2500, tree.GetAllocator().GetAllocatedCount());
+}
+
+TEST(avl_tree, set) {
+    AvlTree<int> tree;
+    TestTreeLikeSet(tree);
+}
+
+TEST(avl_tree, sorted_insert) {
+    AvlTree<int> tree;
+    const int size = 100000;
+    for (int i = 0; i < size; ++i) {
+        tree.Insert(i);
+    }
+    ASSERT_TRUE(tree.IsBalanced());
+    ASSERT_LE(tree.GetRoot()->GetHeight(), 1.45 * std::log2(size + 2));
+
+    for (int i = 0; i < size; i += 3) {
+        tree.Delete(i);
+    }
+    ASSERT_TRUE(tree.IsBalanced());
+    ASSERT_TRUE(tree.IsValid());
+    ASSERT_EQ(nullptr, tree.Search(0));
+    ASSERT_EQ(1, tree.Search(1)->GetData());
+
+    for (int i = size - 1; i >= 0; --i) {
+        tree.Delete(i);
+        ASSERT_LE(tree.GetRoot() ? tree.GetRoot()->GetHeight() : 0, 1.45 * std::log2(i + 2));
+    }
+    ASSERT_EQ(nullptr, tree.GetRoot());
+}
+
+TEST(avl_tree, random) {
+    std::minstd_rand0 generator(237);
+    AvlTree<int> tree;
+    std::set<int> set;
+    for (int i = 0; i < 20000; ++i) {
+        int key = generator() % 5000;
+        if (generator() % 3 == 0) {
+            tree.Delete(key);
+            set.erase(key);
+        } else {
+            tree.Insert(key);
+            set.insert(key);
+        }
+    }
+    ASSERT_TRUE(tree.IsBalanced());
+    TestVector(std::vector<int>(set.begin(), set.end()), tree.OutputInorder());
+}
+
+template<typename TTree>
+void TestTreeIterators(TTree& tree) {
+    std::minstd_rand0 generator(237);
+    std::set<int> set;
+    for (int i = 0; i < 3000; ++i) {
+        int key = generator() % 2000;
+        tree.Insert(key);
+        set.insert(key);
+    }
+    TestVector(std::vector<int>(set.begin(), set.end()), std::vector<int>(tree.begin(), tree.end()));
+    TestVector(std::vector<int>(set.rbegin(), set.rend()),
+               std::vector<int>(std::reverse_iterator<typename TTree::Iterator>(tree.End()),
+                                std::reverse_iterator<typename TTree::Iterator>(tree.Begin())));
+
+    for (int key = -1; key <= 2001; key += 7) {
+        auto lower = set.lower_bound(key);
+        auto upper = set.upper_bound(key);
+        if (lower == set.end()) {
+            ASSERT_TRUE(tree.LowerBound(key) == tree.End());
+        } else {
+            ASSERT_EQ(*lower, *tree.LowerBound(key));
+        }
+        if (upper == set.end()) {
+            ASSERT_TRUE(tree.UpperBound(key) == tree.End());
+        } else {
+            ASSERT_EQ(*upper, *tree.UpperBound(key));
+        }
+
+        std::vector<int> range;
+        for (int elem : tree.Range(key, key + 50)) {
+            range.push_back(elem);
+        }
+        TestVector(std::vector<int>(lower, set.lower_bound(key + 50)), range);
+    }
+    auto empty = tree.Range(100, 50);
+    ASSERT_TRUE(empty.begin() == empty.end());
+}
+
+TEST(binary_search_tree, iterators) {
+    BSTree tree;
+    ASSERT_TRUE(tree.Begin() == tree.End());
+    TestTreeIterators(tree);
+}
+
+TEST(splay_tree, iterators) {
+    STree tree;
+    TestTreeIterators(tree);
+    // splaying keeps iterators valid
+    auto iterator = tree.LowerBound(1000);
+    int elem = *iterator;
+    tree.Search(3);
+    tree.Search(1999);
+    ASSERT_EQ(elem, *iterator);
+    ++iterator;
+    ASSERT_TRUE(elem < *iterator);
+}
+
+TEST(avl_tree, iterators) {
+    AvlTree<int> tree;
+    TestTreeIterators(tree);
+}
+
+// Polynomial hash of a sequence: a monoid which is not commutative
+struct SequenceHashMonoid {
+    typedef std::pair<uint64_t, uint64_t> Value;
+
+    static Value Identity() { return Value(0, 1); }
+    static Value Make(int elem) { return Value(static_cast<uint64_t>(elem), 1000003); }
+    static Value Combine(const Value& left, const Value& right) {
+        return Value(left.first * right.second + right.first, left.second * right.second);
+    }
+};
+
+template<typename TTree>
+void TestOrderStatistics(TTree& tree) {
+    std::minstd_rand0 generator(237);
+    std::set<int> set;
+    for (int i = 0; i < 4000; ++i) {
+        int key = generator() % 1000;
+        if (generator() % 3 == 0) {
+            tree.Delete(key);
+            set.erase(key);
+        } else {
+            tree.Insert(key);
+            set.insert(key);
+        }
+        ASSERT_EQ(set.size(), tree.GetSize());
+
+        if (i % 10 == 0) {
+            std::vector<int> elems(set.begin(), set.end());
+            if (!elems.empty()) {
+                size_t index = generator() % elems.size();
+                ASSERT_EQ(elems[index], *tree.Select(index));
+            }
+            ASSERT_TRUE(tree.Select(elems.size()) == tree.End());
+
+            int elem = generator() % 1100 - 50;
+            size_t rank = std::lower_bound(elems.begin(), elems.end(), elem) - elems.begin();
+            ASSERT_EQ(rank, tree.Rank(elem));
+
+            int low = generator() % 1100 - 50;
+            int high = low + generator() % 300;
+            SequenceHashMonoid::Value expected = SequenceHashMonoid::Identity();
+            for (auto it = set.lower_bound(low); it != set.end() && *it < high; ++it) {
+                expected = SequenceHashMonoid::Combine(expected, SequenceHashMonoid::Make(*it));
+            }
+            ASSERT_EQ(expected, tree.RangeAggregate(low, high));
+        }
+    }
+    ASSERT_TRUE(tree.IsValid());
+}
+
+TEST(binary_search_tree, order_statistics) {
+    BinarySearchTree<int, NodePool, OrderStatistics<SequenceHashMonoid> > tree;
+    TestOrderStatistics(tree);
+
+    BinarySearchTree<int, NodePool, OrderStatistics<> > preorder_tree;
+    preorder_tree.InitPreorder({6, 5, 1, 4, 3, 2, 10, 7, 9, 8, 11});
+    ASSERT_EQ(11, preorder_tree.GetSize());
+    ASSERT_EQ(7, *preorder_tree.Select(6));
+    ASSERT_EQ(4, preorder_tree.Rank(5));
+}
+
+TEST(splay_tree, order_statistics) {
+    SplayTree<int, NodePool, OrderStatistics<SequenceHashMonoid> > tree;
+    TestOrderStatistics(tree);
+
+    SplayTree<int, NodePool, OrderStatistics<SumMonoid<long long> > > sum_tree;
+    for (int i = 0; i < 1000; ++i) {
+        sum_tree.Insert(i);
+    }
+    ASSERT_EQ(4950, sum_tree.RangeAggregate(0, 100));
+    ASSERT_EQ(500, *sum_tree.Select(500));
+    ASSERT_EQ(500, sum_tree.GetRoot()->GetData());
+    ASSERT_TRUE(sum_tree.IsValid());
+}
+
+TEST(splay_tree, top_down) {
+    // sorted insertions leave a path, which every access has to restructure
+    SplayTree<int, NodePool, OrderStatistics<SumMonoid<long long> > > tree;
+    const int test_size = 100000;
+    for (int i = 0; i < test_size; ++i) {
+        tree.Insert(2 * i);
+    }
+    for (int i = 0; i < test_size; ++i) {
+        ASSERT_EQ(2 * i, tree.Search(2 * i)->GetData());
+        ASSERT_EQ(tree.GetRoot(), tree.Search(2 * i));
+    }
+    // a failed search brings a neighbour up
+    ASSERT_EQ(nullptr, tree.Search(1001));
+    int root = tree.GetRoot()->GetData();
+    ASSERT_TRUE(root == 1000 || root == 1002);
+
+    for (int i = 0; i < test_size; i += 2) {
+        tree.Delete(2 * i);
+    }
+    ASSERT_EQ(test_size / 2, tree.GetSize());
+    ASSERT_EQ(6, *tree.Select(1));
+    ASSERT_EQ(10 + 14 + 18, tree.RangeAggregate(10, 20));
+    ASSERT_TRUE(tree.IsValid());
+    ASSERT_EQ(test_size / 2, tree.OutputInorder().size());
+}
+
+TEST(splay_tree, delete_by_reference_into_tree) {
+    // long strings keep their characters on the heap, so a freed element is noticed
+    SplayTree<std::string> tree;
+    std::set<std::string> expected;
+    for (int i = 0; i < 100; ++i) {
+        std::string elem = "element of a splay tree number " + std::to_string(i);
+        tree.Insert(elem);
+        expected.insert(elem);
+    }
+    for (int i = 0; i < 50; ++i) {
+        ASSERT_EQ(1, expected.erase(tree.GetRoot()->GetData()));
+        tree.Delete(tree.GetRoot()->GetData());
+    }
+    while (!expected.empty()) {
+        ASSERT_EQ(*expected.begin(), *tree.Begin());
+        expected.erase(expected.begin());
+        tree.Delete(*tree.Begin());
+    }
+    ASSERT_EQ(nullptr, tree.GetRoot());
+}
+
+TEST(splay_tree, split_join) {
+    typedef SplayTree<int, SharedNodePool, OrderStatistics<SumMonoid<long long> > > SharedTree;
+    SharedTree tree;
+    for (int i = 0; i < 1000; ++i) {
+        tree.Insert(i);
+    }
+    SharedTree right;
+    right.Insert(5000);
+    tree.Split(600, &right);
+    ASSERT_TRUE(tree.IsValid());
+    ASSERT_TRUE(right.IsValid());
+    ASSERT_EQ(600, tree.GetSize());
+    ASSERT_EQ(400, right.GetSize());
+    ASSERT_EQ(599, *--tree.End());
+    ASSERT_EQ(600, *right.Begin());
+    ASSERT_EQ(599LL * 600 / 2, tree.RangeAggregate(0, 1000));
+    ASSERT_TRUE(tree.GetAllocator().SharesPool(right.GetAllocator()));
+    ASSERT_EQ(1000, tree.GetAllocator().GetAllocatedCount());
+
+    // split points out of the range of elements leave one part empty
+    SharedTree empty;
+    right.Split(2000, &empty);
+    ASSERT_EQ(nullptr, empty.GetRoot());
+    ASSERT_EQ(400, right.GetSize());
+    ASSERT_THROW(right.Join(std::move(tree)), std::invalid_argument);
+    ASSERT_EQ(600, tree.GetSize());
+
+    tree.Join(std::move(right));
+    ASSERT_TRUE(tree.IsValid());
+    ASSERT_EQ(nullptr, right.GetRoot());
+    ASSERT_EQ(1000, tree.GetSize());
+    ASSERT_EQ(999LL * 1000 / 2, tree.RangeAggregate(0, 1000));
+
+    // trees from different pools are joined by merging the pools, the parts split
+    // from the joined tree before keep their nodes
+    SharedTree other;
+    SharedTree other_right;
+    for (int i = 1000; i < 2000; ++i) {
+        other.Insert(i);
+    }
+    other.Split(1500, &other_right);
+    tree.Join(std::move(other));
+    ASSERT_TRUE(tree.GetAllocator().SharesPool(other_right.GetAllocator()));
+    ASSERT_EQ(2000, tree.GetAllocator().GetAllocatedCount());
+    tree = SharedTree();
+    ASSERT_EQ(500, other_right.GetAllocator().GetAllocatedCount());
+    TestVector(other_right.OutputInorder(), std::vector<int>(other_right.begin(), other_right.end()));
+    ASSERT_EQ(1500, *other_right.Begin());
+
+    SplayTree<int, NewDeleteAllocator> new_delete_tree;
+    SplayTree<int, NewDeleteAllocator> new_delete_right;
+    for (int i = 0; i < 100; ++i) {
+        new_delete_tree.Insert(i);
+    }
+    new_delete_tree.Split(50, &new_delete_right);
+    ASSERT_EQ(50, new_delete_right.OutputInorder().size());
+    ASSERT_EQ(50, new_delete_tree.OutputInorder().size());
+}
+
+TEST(splay_tree, erase_range) {
+    std::minstd_rand0 generator(237);
+    SplayTree<int, NodePool, OrderStatistics<SumMonoid<long long> > > tree;
+    std::set<int> set;
+    for (int i = 0; i < 2000; ++i) {
+        int key = generator() % 10000;
+        if (i % 20 == 0) {
+            int low = generator() % 10000;
+            int high = low + generator() % 1000;
+            tree.EraseRange(low, high);
+            set.erase(set.lower_bound(low), set.lower_bound(high));
+            ASSERT_TRUE(tree.IsValid());
+            ASSERT_EQ(set.size(), tree.GetSize());
+            ASSERT_EQ(std::accumulate(set.begin(), set.end(), 0LL), tree.RangeAggregate(0, 10000));
+        } else {
+            tree.Insert(key);
+            set.insert(key);
+        }
+    }
+    TestVector(std::vector<int>(set.begin(), set.end()), tree.OutputInorder());
+    ASSERT_EQ(set.size(), tree.GetAllocator().GetAllocatedCount());
+
+    // eviction of everything below a watermark
+    tree.EraseRange(-1, 5000);
+    ASSERT_EQ(*set.lower_bound(5000), *tree.Begin());
+    tree.EraseRange(0, 20000);
+    ASSERT_EQ(nullptr, tree.GetRoot());
+    ASSERT_EQ(0, tree.GetAllocator().GetAllocatedCount());
+}
+
+TEST(avl_tree, order_statistics) {
+    AvlTree<int, NodePool, OrderStatistics<SequenceHashMonoid> > tree;
+    TestOrderStatistics(tree);
+    ASSERT_TRUE(tree.IsBalanced());
+
+    AvlTree<int, NodePool, OrderStatistics<MinMonoid<int> > > min_tree;
+    for (int i = 0; i < 1000; ++i) {
+        min_tree.Insert((i * 37) % 1000);
+    }
+    ASSERT_EQ(100, min_tree.RangeAggregate(100, 200));
+    ASSERT_EQ(std::numeric_limits<int>::max(), min_tree.RangeAggregate(2000, 3000));
+}
+
+template<typename TTree>
+void TestBPlusTreeLikeMap(TTree& tree, int test_size) {
+    std::minstd_rand0 generator(237);
+    std::map<int, int> map;
+    for (int i = 0; i < test_size; ++i) {
+        int key = generator() % (test_size / 2);
+        if (generator() % 3 == 0) {
+            ASSERT_EQ(map.erase(key) == 1, tree.Erase(key));
+        } else {
+            ASSERT_EQ(map.insert(std::make_pair(key, i)).second, tree.Insert(key, i));
+        }
+        if (i % 100 == 0) {
+            ASSERT_TRUE(tree.IsValid());
+        }
+    }
+    ASSERT_TRUE(tree.IsValid());
+    ASSERT_EQ(map.size(), tree.GetSize());
+    for (int key = -1; key <= test_size / 2; ++key) {
+        auto found = map.find(key);
+        if (found == map.end()) {
+            ASSERT_EQ(nullptr, tree.Find(key));
+        } else {
+            ASSERT_EQ(found->second, *tree.Find(key));
+        }
+    }
+
+    auto iterator = tree.Begin();
+    for (const auto& entry : map) {
+        ASSERT_TRUE(iterator != tree.End());
+        ASSERT_EQ(entry.first, iterator.GetKey());
+        ASSERT_EQ(entry.second, iterator.GetValue());
+        ++iterator;
+    }
+    ASSERT_TRUE(iterator == tree.End());
+
+    for (const auto& entry : map) {
+        ASSERT_TRUE(tree.Erase(entry.first));
+    }
+    ASSERT_TRUE(tree.IsValid());
+    ASSERT_EQ(0, tree.GetSize());
+    ASSERT_TRUE(tree.Begin() == tree.End());
+}
+
+TEST(b_plus_tree, map) {
+    BPlusTree<int, int, 64> small_nodes;
+    TestBPlusTreeLikeMap(small_nodes, 20000);
+    BPlusTree<int, int> tree;
+    TestBPlusTreeLikeMap(tree, 20000);
+}
+
+TEST(b_plus_tree, sorted_insert) {
+    BPlusTree<int, int> tree;
+    const int size = 100000;
+    for (int i = 0; i < size; ++i) {
+        tree.Insert(i, -i);
+    }
+    ASSERT_TRUE(tree.IsValid());
+    ASSERT_LE(tree.GetHeight(), 5);
+    for (int i = size - 1; i >= 0; i -= 2) {
+        ASSERT_TRUE(tree.Erase(i));
+    }
+    ASSERT_TRUE(tree.IsValid());
+    ASSERT_EQ(size / 2, tree.GetSize());
+    ASSERT_EQ(-10, *tree.Find(10));
+    ASSERT_EQ(nullptr, tree.Find(11));
+}
+
+TEST(b_plus_tree, bulk_load_and_range) {
+    for (int size : {0, 1, 5, 6, 7, 100, 1000, 12345}) {
+        std::vector<std::pair<int, int> > entries;
+        for (int i = 0; i < size; ++i) {
+            entries.push_back(std::make_pair(i * 2, i));
+        }
+        BPlusTree<int, int, 64> tree;
+        tree.Insert(-5, 0);
+        tree.BulkLoad(entries.begin(), entries.end());
+        ASSERT_TRUE(tree.IsValid());
+        ASSERT_EQ(size, tree.GetSize());
+        ASSERT_EQ(nullptr, tree.Find(-5));
+
+        // entries with keys in [size / 2 + 1, size)
+        int count = 0;
+        for (auto iterator = tree.LowerBound(size / 2 + 1);
+             iterator != tree.End() && iterator.GetKey() < size; ++iterator) {
+            ASSERT_EQ(iterator.GetKey() / 2, iterator.GetValue());
+            ++count;
+        }
+        int expected_count = 0;
+        for (const auto& entry : entries) {
+            expected_count += entry.first >= size / 2 + 1 && entry.first < size;
+        }
+        ASSERT_EQ(expected_count, count);
+
+        // the loaded tree accepts further changes
+        for (int i = 0; i < size; ++i) {
+            ASSERT_TRUE(tree.Insert(i * 2 + 1, i));
+        }
+        for (int i = 0; i < size; i += 3) {
+            ASSERT_TRUE(tree.Erase(i * 2));
+        }
+        ASSERT_TRUE(tree.IsValid());
+    }
+
+    std::vector<std::pair<int, int> > unsorted{{1, 1}, {3, 3}, {2, 2}};
+    BPlusTree<int, int> tree;
+    tree.Insert(7, 7);
+    ASSERT_THROW(tree.BulkLoad(unsorted.begin(), unsorted.end()), std::invalid_argument);
+    ASSERT_EQ(7, *tree.Find(7));
+}
+
+TEST(b_plus_tree, string_keys) {
+    BPlusTree<std::string, std::string, 128> tree;
+    for (int i = 0; i < 2000; ++i) {
+        std::string key = std::to_string(i * 7919 % 2000);
+        ASSERT_TRUE(tree.Insert(key, key + key));
+    }
+    for (int i = 0; i < 2000; i += 2) {
+        ASSERT_TRUE(tree.Erase(std::to_string(i)));
+    }
+    ASSERT_TRUE(tree.IsValid());
+    ASSERT_EQ("11", *tree.Find("1"));
+    BPlusTree<std::string, std::string, 128> moved(std::move(tree));
+    ASSERT_EQ(1000, moved.GetSize());
+    ASSERT_EQ(0, tree.GetSize());
+    ASSERT_EQ("1999", moved.LowerBound("1998").GetKey());
+}
+
+TEST(concurrent_skip_list, single_thread) {
+    std::minstd_rand0 generator(237);
+    ConcurrentSkipList<int, int> map;
+    std::map<int, int> expected;
+    int value;
+    ASSERT_FALSE(map.Find(1, &value));
+    ASSERT_FALSE(map.Erase(1));
+    ASSERT_TRUE(map.Begin() == map.End());
+    // the greatest value marks erased keys
+    ASSERT_THROW(map.Insert(1, std::numeric_limits<int>::max()), std::invalid_argument);
+    ASSERT_FALSE(map.Find(1, &value));
+    ASSERT_EQ(0, map.GetSize());
+
+    for (int i = 0; i < 100000; ++i) {
+        int key = static_cast<int>(generator() % 20001) - 10000;
+        switch (generator() % 3) {
+            case 0:
+                ASSERT_EQ(expected.count(key) == 0, map.Insert(key, i));
+                expected[key] = i;
+                break;
+            case 1:
+                ASSERT_EQ(expected.erase(key) == 1, map.Erase(key));
+                break;
+            default:
+                ASSERT_EQ(expected.count(key) == 1, map.Find(key, &value));
+                if (expected.count(key) == 1) {
+                    ASSERT_EQ(expected[key], value);
+                }
+        }
+    }
+    ASSERT_EQ(expected.size(), map.GetSize());
+
+    std::vector<std::pair<int, int> > elements;
+    for (auto it = map.Begin(); it != map.End(); ++it) {
+        elements.push_back(std::make_pair(it.GetKey(), it.GetValue()));
+    }
+    std::vector<std::pair<int, int> > expected_elements(expected.begin(), expected.end());
+    ASSERT_TRUE(expected_elements == elements);
+
+    auto bound = map.LowerBound(-5000);
+    ASSERT_EQ(expected.lower_bound(-5000)->first, bound.GetKey());
+    ASSERT_TRUE(map.LowerBound(20000) == map.End());
+
+    ConcurrentSkipList<std::string, long long> string_map;
+    string_map.Insert("b", 2);
+    string_map.Insert("a", 1);
+    string_map.Insert("c", 3);
+    ASSERT_EQ("b", string_map.LowerBound("aa").GetKey());
+}
+
+TEST(concurrent_skip_list, releases_erased_nodes) {
+    // a window of present keys slides over many distinct keys
+    const long long WINDOW_SIZE = 100;
+    const long long KEYS_COUNT = 1000000;
+    // far less than the nodes of all keys would take
+    const size_t MAX_NODES_MEMORY = 1000 * WINDOW_SIZE;
+    ConcurrentSkipList<long long, long long> map;
+    size_t initial_memory = map.GetMemoryUsage();
+    long long value;
+    for (long long key = 0; key < KEYS_COUNT; ++key) {
+        ASSERT_TRUE(map.Insert(key, key));
+        if (key >= WINDOW_SIZE) {
+            ASSERT_TRUE(map.Erase(key - WINDOW_SIZE));
+        }
+        ASSERT_LE(map.GetMemoryUsage(), initial_memory + MAX_NODES_MEMORY);
+    }
+    ASSERT_EQ(WINDOW_SIZE, map.GetSize());
+    ASSERT_FALSE(map.Find(KEYS_COUNT - WINDOW_SIZE - 1, &value));
+    ASSERT_EQ(KEYS_COUNT - WINDOW_SIZE, map.Begin().GetKey());
+
+    // an iterator keeps its erased node and passes the node of the key inserted again
+    auto it = map.LowerBound(KEYS_COUNT - 2);
+    ASSERT_TRUE(map.Erase(KEYS_COUNT - 2));
+    ASSERT_TRUE(map.Insert(KEYS_COUNT - 2, 0));
+    ASSERT_TRUE(map.Insert(KEYS_COUNT, 0));
+    ASSERT_EQ(KEYS_COUNT - 2, it.GetKey());
+    ASSERT_EQ(KEYS_COUNT - 1, (++it).GetKey());
+    ASSERT_EQ(KEYS_COUNT, (++it).GetKey());
+    ASSERT_TRUE(++it == map.End());
+
+    // writers erase keys while a reader passes over the map
+    const int THREADS_COUNT = 4;
+    ConcurrentSkipList<long long, long long> shared;
+    std::atomic<bool> failed(false);
+    std::atomic<int> finished_count(0);
+    std::vector<std::thread> threads;
+    for (int thread_index = 0; thread_index < THREADS_COUNT; ++thread_index) {
+        threads.push_back(std::thread([&shared, &failed, &finished_count, thread_index] () {
+            long long value;
+            for (long long key = thread_index; key < KEYS_COUNT / 10; key += THREADS_COUNT) {
+                shared.Insert(key, key);
+                if (!shared.Find(key, &value) || value != key) {
+                    failed = true;
+                }
+                if (key >= WINDOW_SIZE && !shared.Erase(key - WINDOW_SIZE)) {
+                    failed = true;
+                }
+            }
+            ++finished_count;
+        }));
+    }
+    threads.push_back(std::thread([&shared, &failed, &finished_count] () {
+        while (finished_count.load() != THREADS_COUNT) {
+            long long previous = -1;
+            for (auto it = shared.Begin(); it != shared.End(); ++it) {
+                if (it.GetKey() <= previous || it.GetValue() != it.GetKey()) {
+                    failed = true;
+                }
+                previous = it.GetKey();
+            }
+        }
+    }));
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    ASSERT_FALSE(failed);
+    ASSERT_EQ(WINDOW_SIZE, shared.GetSize());
+    // the nodes erased last are released by later modifications
+    ASSERT_TRUE(shared.Insert(-1, 1));
+    ASSERT_TRUE(shared.Erase(-1));
+    ASSERT_LE(shared.GetMemoryUsage(), initial_memory + MAX_NODES_MEMORY);
+}
+
+TEST(concurrent_skip_list, concurrent_updates) {
+    const int THREADS_COUNT = 4;
+    const int KEYS_PER_THREAD = 20000;
+    ConcurrentSkipList<long long, long long> map;
+    std::atomic<bool> failed(false);
+    std::atomic<int> finished_count(0);
+
+    // every thread owns its keys, so it knows their values while other threads insert theirs;
+    // a reader checks that passes over the map stay ordered
+    std::vector<std::thread> threads;
+    for (int thread_index = 0; thread_index < THREADS_COUNT; ++thread_index) {
+        threads.push_back(std::thread([&map, &failed, &finished_count, thread_index] () {
+            long long value;
+            for (long long key = thread_index; key < KEYS_PER_THREAD * THREADS_COUNT; key += THREADS_COUNT) {
+                if (!map.Insert(key, key * 2)) {
+                    failed = true;
+                }
+                if (!map.Find(key, &value) || value != key * 2) {
+                    failed = true;
+                }
+                if (key % 3 == 0 && !map.Erase(key)) {
+                    failed = true;
+                }
+            }
+            for (long long key = thread_index; key < KEYS_PER_THREAD * THREADS_COUNT; key += THREADS_COUNT) {
+                if (map.Find(key, &value) != (key % 3 != 0)) {
+                    failed = true;
+                }
+            }
+            ++finished_count;
+        }));
+    }
+    threads.push_back(std::thread([&map, &failed, &finished_count] () {
+        while (finished_count.load() != THREADS_COUNT) {
+            long long previous = -1;
+            for (auto it = map.Begin(); it != map.End(); ++it) {
+                if (it.GetKey() <= previous || it.GetValue() != it.GetKey() * 2) {
+                    failed = true;
+                }
+                previous = it.GetKey();
+            }
+        }
+    }));
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    ASSERT_FALSE(failed);
+
+    size_t expected_size = 0;
+    long long value;
+    for (long long key = 0; key < KEYS_PER_THREAD * THREADS_COUNT; ++key) {
+        ASSERT_EQ(key % 3 != 0, map.Find(key, &value));
+        expected_size += (key % 3 != 0);
+    }
+    ASSERT_EQ(expected_size, map.GetSize());
+}